@@ -22,7 +22,12 @@
  *
  * @ingroup Public API
  *
- * @note This API is not thread-safe.
+ * @note Each function tells whether it is safe to call from any thread: the
+ *   *_listener() ones and most others, e.g. the quads, fonts, parameters,
+ *   frame allocations and captures. #ssegui_upload() is for the render thread
+ *   only. The rest - #ssegui_enable_input(), #ssegui_control_key(),
+ *   #ssegui_clip_cursor() and #ssegui_execute() - are not thread-safe, call
+ *   them from one thread at a time. The last error is kept per thread.
  * @note Unless mentioned, all strings are null-terminated and in UTF-8.
  *
  * @details
@@ -36,6 +41,7 @@
 #ifndef SSEGUI_SSEGUI_H
 #define SSEGUI_SSEGUI_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <sse-gui/platform.h>
 
@@ -88,6 +94,8 @@ typedef void (SSEGUI_CCONV* ssegui_version_t) (int*, int*, int*, const char**);
 /**
  * Report the last message in more human-readable form.
  *
+ * As #GetLastError(), the message is of the last failed call on this thread.
+ *
  * @param[in,out] size in bytes of @param message, on exit how many bytes were
  * actually written (excluding the terminating null) or how many bytes are
  * needed in order to get the full message. Can be zero, if there is no error.
@@ -166,7 +174,10 @@ typedef void (SSEGUI_CCONV* ssegui_control_callback)
  * control key (#ssegui_control_key()), zeroes the data received from them.
  * This means they are effectively disabled and the game cannot see them.
  *
+ * It is safe to call from any thread, including from within a listener.
+ *
  * @see #ssegui_control_key()
+ *
  * @param[in] callback to call or @param remove
  * @param[in] remove if positive, append if zero.
  */
@@ -193,6 +204,8 @@ typedef void (SSEGUI_CCONV* ssegui_render_callback)
  * elements above or something. Note that, less and faster is better, or the
  * FPS can suffer.
  *
+ * It is safe to call from any thread, including from within a listener.
+ *
  * @param[in] callback to call or @param remove
  * @param[in] remove if positive, append if zero.
  */
@@ -207,6 +220,153 @@ typedef void (SSEGUI_CCONV* ssegui_render_listener_t)
 
 /******************************************************************************/
 
+/**
+ * Phase of #ssegui_present_listener(), before the actual presentation - the
+ * same as #ssegui_render_listener(). What is drawn on the back buffer shows in
+ * this frame, so this is the place for all drawing, on the immediate context
+ * or through the #SSEGUI_RENDER_* flags. Time spent here delays the frame.
+ */
+#define SSEGUI_PRESENT_BEFORE (0)
+
+/**
+ * Phase of #ssegui_present_listener(), right after the original Present
+ * returned, while the GPU works on the frame just presented. Work done here
+ * overlaps with it instead of delaying the flip: UI layout, data aggregation,
+ * preparing the next frame. The immediate context is still usable, but:
+ *
+ * * the back buffer belongs to the next frame and is about to be drawn over
+ *   by the game - drawing on it, or reading it, shows or gets nothing useful;
+ *   "BackBufferRTV" of #ssegui_parameter() is meant for the other phase
+ * * creating resources, UpdateSubresource and Map with WRITE_DISCARD or
+ *   NO_OVERWRITE of own resources are fine, as are #ssegui_upload() and
+ *   #ssegui_quads() - these are for the next frame. Memory of
+ *   #ssegui_frame_alloc() lasts until the next Present listeners return.
+ * * anything waiting on the GPU, like Map for reading without DO_NOT_WAIT,
+ *   GetData without DONOTFLUSH or Flush, stalls right where the CPU could run
+ *   ahead - as much as on the other phase
+ * * the swap chain must not be resized nor switched to fullscreen from here
+ *
+ * Listeners of this phase are not subject to budgets nor flags, but are
+ * profiled under "post present" of #ssegui_execute() "stats".
+ */
+#define SSEGUI_PRESENT_AFTER (1)
+
+/**
+ * Add or remove a function to call on each Present, in a given phase.
+ *
+ * Same as #ssegui_render_listener() for #SSEGUI_PRESENT_BEFORE. The phases
+ * have separate lists, each called in the order of registration. It is safe
+ * to call from any thread, including from within a listener.
+ *
+ * @param[in] callback to call or @param remove
+ * @param[in] phase one of SSEGUI_PRESENT_*
+ * @param[in] remove if positive, append if zero.
+ * @returns non-zero on success, otherwise see #ssegui_last_error ()
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_present_listener (ssegui_render_callback callback, int phase, int remove);
+
+/** @see #ssegui_present_listener() */
+
+typedef int (SSEGUI_CCONV* ssegui_present_listener_t)
+    (ssegui_render_callback, int, int);
+
+/******************************************************************************/
+
+/**
+ * Call the render listener on a worker thread, recording into its own deferred
+ * context. SSEGUI executes the recorded command list on the next Present, in
+ * the order of the listeners registration. The deferred context is available
+ * through #ssegui_parameter() "ID3D11DeviceContext" from within the callback.
+ */
+#define SSEGUI_RENDER_DEFERRED (1)
+
+/**
+ * The listener relies on SSEGUI to save the immediate context state before the
+ * first render listener and to restore it after the last one, instead of doing
+ * that itself. The state seen by the listener is whatever the game, or the
+ * previous listeners, left. Covers the input assembler, all shader stages
+ * without compute, the vertex and pixel shader constant buffers, the pixel
+ * shader resources and samplers, the rasterizer and the output merger - all
+ * the D3D11 slots of each, e.g. the 32 vertex buffers and 128 resources.
+ */
+#define SSEGUI_RENDER_SHARED_STATE (2)
+
+/**
+ * Change how a render listener is called.
+ *
+ * By default render listeners are called on each Present, before the actual
+ * presentation, on the game render thread and can work on the immediate
+ * context. The flags are a combination of the SSEGUI_RENDER_* constants, which
+ * change some of these.
+ *
+ * With #SSEGUI_RENDER_DEFERRED the CPU cost of the listener overlaps with the
+ * game frame, but its output is presented one frame later. Such listeners
+ * must not use the immediate context and are not subject of the frame budget.
+ *
+ * Once any listener sets #SSEGUI_RENDER_SHARED_STATE, the context state is
+ * captured and restored once per frame, no matter the count of listeners.
+ *
+ * It is safe to call from any thread.
+ *
+ * @param[in] callback an already registered render listener
+ * @param[in,out] flags to set, if not negative. On exit it will contain the
+ *  previous, or the current (if not changed) flags.
+ * @returns non-zero on success, zero if @param callback is not registered
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_render_flags (ssegui_render_callback callback, int* flags);
+
+/** @see #ssegui_render_flags() */
+
+typedef int (SSEGUI_CCONV* ssegui_render_flags_t) (ssegui_render_callback, int*);
+
+/******************************************************************************/
+
+/** CPU time limits and scheduling state of a render listener. */
+
+struct ssegui_budget
+{
+    /** Milliseconds of CPU time per frame, zero (default) for unlimited. */
+    float budget;
+    /** Calls per second to keep regardless of the budget, zero for none. */
+    float min_rate;
+    /** Smoothed milliseconds spent per call (output only). */
+    float cost;
+    /** Ratio of the skipped to all frames since the budget was set (output only). */
+    float skip_ratio;
+};
+
+/**
+ * Limit the CPU time a render listener can take per frame.
+ *
+ * A listener which takes longer than its budget is not called on each frame,
+ * but every N-th, so its average cost per frame stays within the budget. It is
+ * still called on frames where the other limited listeners left enough unused
+ * time, and when the @ref ssegui_budget.min_rate requires so. Listeners without
+ * budget are always called.
+ *
+ * It is safe to call from any thread.
+ *
+ * @param[in] callback an already registered render listener
+ * @param[in] set (optional) new budget and minimum rate, statistics restart
+ * @param[out] get (optional) the current state, after @param set is applied
+ * @returns non-zero on success, zero if @param callback is not registered
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_render_budget (ssegui_render_callback callback,
+        struct ssegui_budget const* set, struct ssegui_budget* get);
+
+/** @see #ssegui_render_budget() */
+
+typedef int (SSEGUI_CCONV* ssegui_render_budget_t)
+    (ssegui_render_callback, struct ssegui_budget const*, struct ssegui_budget*);
+
+/******************************************************************************/
+
 /** @see https://msdn.microsoft.com/en-us/library/windows/desktop/ms633573(v=vs.85).aspx */
 
 typedef intptr_t (SSEGUI_CCONV* ssegui_message_callback)
@@ -215,11 +375,14 @@ typedef intptr_t (SSEGUI_CCONV* ssegui_message_callback)
 /**
  * Register or remove a windows message listener
  *
- * The callback is called on each received window message, before forwarding to
- * the rest of the subclass chain. It is somehow easy to install such hook
+ * The callback is called on each received window message, or only on some with
+ * #ssegui_message_filter(), before forwarding to the rest of the subclass
+ * chain. It is somehow easy to install such hook
  * through ::FindWindow() and ::SetWindowLongPtr(), but this is exposed as
  * complement to the rendering.
  *
+ * It is safe to call from any thread, including from within a listener.
+ *
  * @param[in] callback to call or @param remove
  * @param[in] remove if positive, append if zero.
  */
@@ -232,6 +395,553 @@ ssegui_message_listener (ssegui_message_callback callback, int remove);
 typedef void (SSEGUI_CCONV* ssegui_message_listener_t)
     (ssegui_message_callback, int);
 
+/** WM_KEYDOWN to WM_UNICHAR, i.e. key presses and characters. */
+#define SSEGUI_MESSAGE_KEYBOARD (1)
+/** WM_MOUSEMOVE, WM_MOUSEHOVER and WM_MOUSELEAVE. */
+#define SSEGUI_MESSAGE_MOUSE_MOVE (2)
+/** WM_LBUTTONDOWN to WM_MOUSEHWHEEL, i.e. the buttons and the wheels. */
+#define SSEGUI_MESSAGE_MOUSE_BUTTON (4)
+/** WM_INPUT and WM_INPUT_DEVICE_CHANGE. */
+#define SSEGUI_MESSAGE_RAW_INPUT (8)
+/** WM_ACTIVATE, WM_SETFOCUS, WM_KILLFOCUS and WM_ACTIVATEAPP. */
+#define SSEGUI_MESSAGE_FOCUS (16)
+/** Moves, sizes, display changes, closing and destroying the window. */
+#define SSEGUI_MESSAGE_WINDOW (32)
+/** WM_IME_STARTCOMPOSITION to WM_IME_COMPOSITION and WM_IME_SETCONTEXT to
+ * WM_IME_KEYUP. */
+#define SSEGUI_MESSAGE_IME (64)
+/** Anything else, e.g. WM_NCHITTEST, WM_SETCURSOR, WM_PAINT or WM_USER+N. */
+#define SSEGUI_MESSAGE_OTHER (128)
+/** All of the above, the default of each message listener. */
+#define SSEGUI_MESSAGE_ALL (255)
+
+/**
+ * Choose which window messages a message listener receives.
+ *
+ * A listener receives only the messages of the given classes, plus the ones
+ * listed explicitly. Messages nobody subscribed to cost no listener call at
+ * all, which matters for floods like WM_MOUSEMOVE, WM_NCHITTEST and
+ * WM_SETCURSOR. By default a listener receives all messages.
+ *
+ * It is safe to call from any thread, including from within a listener. The
+ * change applies from the next message on.
+ *
+ * @param[in] callback an already registered message listener
+ * @param[in] classes combination of the SSEGUI_MESSAGE_* constants, can be 0
+ * @param[in] messages (optional) identifiers to receive as well, e.g. WM_CHAR
+ * @param[in] count of @param messages
+ * @returns non-zero on success, zero if @param callback is not registered or
+ *  the arguments are invalid, see #ssegui_last_error ()
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_message_filter (ssegui_message_callback callback,
+        int classes, unsigned const* messages, int count);
+
+/** @see #ssegui_message_filter() */
+
+typedef int (SSEGUI_CCONV* ssegui_message_filter_t)
+    (ssegui_message_callback, int, unsigned const*, int);
+
+/** Consuming listener result: go on with the next listener. */
+#define SSEGUI_MESSAGE_PASS (0)
+/** Consuming listener result: no further listeners, still forward to the game. */
+#define SSEGUI_MESSAGE_STOP (1)
+/** Consuming listener result: no further listeners, the game does not get the
+ * message either and its window procedure result is zero. */
+#define SSEGUI_MESSAGE_CONSUME (2)
+
+/**
+ * Set the call order of a message listener and whether it can consume messages.
+ *
+ * Listeners are called by descending priority, those of equal priority in the
+ * order of their registration. A priority set for the listener module in the
+ * settings.json "window" "message priorities" overrides @param priority.
+ *
+ * The result of a consuming listener is one of the SSEGUI_MESSAGE_* results
+ * above, anything else counts as #SSEGUI_MESSAGE_PASS. A focused UI can so
+ * take the input for itself. The result of the other listeners is ignored, as
+ * before. A message blocked by the settings never reaches the game anyway.
+ *
+ * It is safe to call from any thread, including from within a listener.
+ *
+ * @param[in] callback an already registered message listener
+ * @param[in] priority zero by default, can be negative
+ * @param[in] consumes non-zero if the callback result is one of the above
+ * @returns non-zero on success, zero if @param callback is not registered
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_message_priority (ssegui_message_callback callback, int priority, int consumes);
+
+/** @see #ssegui_message_priority() */
+
+typedef int (SSEGUI_CCONV* ssegui_message_priority_t)
+    (ssegui_message_callback, int, int);
+
+/******************************************************************************/
+
+/** One or more coalesced input messages, @see #ssegui_input_batch_listener() */
+
+struct ssegui_input_event
+{
+    /** The window message, e.g. WM_KEYDOWN, WM_MOUSEMOVE or WM_INPUT. */
+    unsigned msg;
+    /** Of messages coalesced into this event, at least one. */
+    unsigned count;
+    /** Of the last message. For WM_INPUT from a mouse the button flags, from
+     * a keyboard the virtual key. */
+    uintptr_t wParam;
+    /** Of the last message. For WM_INPUT from a mouse the button data (e.g.
+     * the wheel delta), from a keyboard the RI_KEY_* flags. */
+    intptr_t lParam;
+    /** Sum of the relative motion of WM_INPUT from a mouse, or of the wheel
+     * deltas, vertical in dy and horizontal in dx. Zero otherwise. */
+    int dx, dy;
+    /** When the last message was received, in nanoseconds of a monotonic clock. */
+    uint64_t time;
+};
+
+/** @see #ssegui_input_batch_listener() */
+
+typedef void (SSEGUI_CCONV* ssegui_input_batch_callback)
+    (struct ssegui_input_event const* events, int count);
+
+/**
+ * Register or remove a listener of the input received during a frame.
+ *
+ * Instead of a call per window message, the keyboard, mouse and raw input
+ * messages are gathered and handed over once per frame, on Present before the
+ * render listeners, on the game render thread. The mouse moves, wheel turns
+ * and relative WM_INPUT motions between two other events are coalesced into
+ * one event per message. Key and button presses and releases, and characters,
+ * are kept one by one and in order. Nothing is called on frames without input.
+ *
+ * A batch listener gets all input the window receives, whether a message
+ * listener consumed it or not. The batch is valid only during the call. At
+ * most 4096 events are kept per frame, the rest is dropped and counted in
+ * the "input batch" statistics of #ssegui_execute ("stats").
+ *
+ * It is safe to call from any thread, including from within a listener.
+ *
+ * @param[in] callback to call or @param remove
+ * @param[in] remove if positive, append if zero.
+ */
+
+SSEGUI_API void SSEGUI_CCONV
+ssegui_input_batch_listener (ssegui_input_batch_callback callback, int remove);
+
+/** @see #ssegui_input_batch_listener() */
+
+typedef void (SSEGUI_CCONV* ssegui_input_batch_listener_t)
+    (ssegui_input_batch_callback, int);
+
+/******************************************************************************/
+
+/** Pixel rectangle, the right and bottom edges are exclusive. */
+
+struct ssegui_rect
+{
+    int left, top, right, bottom;
+};
+
+/**
+ * Paints the content of a layer.
+ *
+ * The render target is the layer own texture, with the size of the back
+ * buffer, in premultiplied alpha. It is already bound on the context, with
+ * scissor rectangle set to @param dirty and that rectangle cleared to
+ * transparent. Anything painted outside of it is kept, but may not be shown.
+ *
+ * @param pContext is ID3D11DeviceContext*
+ * @param pRenderTarget is ID3D11RenderTargetView*
+ */
+
+typedef void (SSEGUI_CCONV* ssegui_layer_callback)
+    (void* pContext, void* pRenderTarget, const struct ssegui_rect* dirty);
+
+/**
+ * Register or remove a retained overlay layer
+ *
+ * Unlike the render listeners, a layer is painted only when it has been marked
+ * dirty by #ssegui_layer_invalidate() and its content is cached in between.
+ * On each Present, after the render listeners, all visible layers are
+ * composited onto the back buffer in their z-order, in one pass and only
+ * within the painted areas. So an idle layer costs close to nothing.
+ *
+ * A new layer is visible, fully opaque, at zero z-order and entirely dirty.
+ * The paint callback is called on the game render thread.
+ *
+ * It is safe to call from any thread, including from within a listener.
+ *
+ * @param[in] callback to paint the layer and to identify it by
+ * @param[in] remove if positive, append if zero.
+ */
+
+SSEGUI_API void SSEGUI_CCONV
+ssegui_layer_listener (ssegui_layer_callback callback, int remove);
+
+/** @see #ssegui_layer_listener() */
+
+typedef void (SSEGUI_CCONV* ssegui_layer_listener_t)
+    (ssegui_layer_callback, int);
+
+/** How a layer is composited. */
+
+struct ssegui_layer
+{
+    /** Higher is above, the equal ones are in their registration order. */
+    int z;
+    /** Multiplies the layer content, from zero to one. */
+    float opacity;
+    /** Non-zero to composite the layer. */
+    int visible;
+};
+
+/**
+ * Change or obtain the composition of a layer.
+ *
+ * It is safe to call from any thread.
+ *
+ * @param[in] callback an already registered layer
+ * @param[in] set (optional) new values
+ * @param[out] get (optional) the values, before any change
+ * @returns non-zero on success, zero if @param callback is not registered
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_layer_state (ssegui_layer_callback callback,
+        const struct ssegui_layer* set, struct ssegui_layer* get);
+
+/** @see #ssegui_layer_state() */
+
+typedef int (SSEGUI_CCONV* ssegui_layer_state_t)
+    (ssegui_layer_callback, const struct ssegui_layer*, struct ssegui_layer*);
+
+/**
+ * Mark a layer, or part of it, for repainting on the next Present.
+ *
+ * Multiple calls before the repainting are merged in their bounding rectangle.
+ * It is safe to call from any thread, including from within the layer paint.
+ *
+ * @param[in] callback an already registered layer
+ * @param[in] rect (optional) to repaint, the whole layer if nullptr
+ * @returns non-zero on success, zero if @param callback is not registered
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_layer_invalidate (ssegui_layer_callback callback, const struct ssegui_rect* rect);
+
+/** @see #ssegui_layer_invalidate() */
+
+typedef int (SSEGUI_CCONV* ssegui_layer_invalidate_t)
+    (ssegui_layer_callback, const struct ssegui_rect*);
+
+/******************************************************************************/
+
+/** Swap chain calls reported to the resize listeners. */
+
+#define SSEGUI_RESIZE_BUFFERS (1)
+#define SSEGUI_RESIZE_TARGET (2)
+#define SSEGUI_FULLSCREEN_STATE (3)
+
+/**
+ * The game swap chain and device got replaced. Everything made with the old
+ * device must be released before, and made anew after with the device from
+ * #ssegui_parameter(). Reported on the render thread.
+ */
+
+#define SSEGUI_DEVICE_CHANGE (4)
+
+/** Details of a swap chain size or mode change. */
+
+struct ssegui_resize_event
+{
+    /** One of the SSEGUI_RESIZE_* constants, the IDXGISwapChain method, or
+     *  #SSEGUI_DEVICE_CHANGE. */
+    int call;
+    /** Zero before the call, when size dependent resources must be released. */
+    int after;
+    /** The HRESULT of the call, when @param after. */
+    long result;
+    /** Requested (zero for the window size) before, and actual after the call. */
+    unsigned width, height;
+    /** Requested before, and actual after the call. */
+    int fullscreen;
+};
+
+typedef void (SSEGUI_CCONV* ssegui_resize_callback)
+    (const struct ssegui_resize_event* event);
+
+/**
+ * Register or remove a swap chain resize listener
+ *
+ * Called twice for each IDXGISwapChain::ResizeBuffers, ResizeTarget and
+ * SetFullscreenState on the game swap chain - before and after the call, on
+ * the thread making it - and when the game replaces the swap chain. There is
+ * no need to poll for size or mode changes on each frame. The cursor clipping
+ * (#ssegui_clip_cursor()) is re-evaluated on each change, after all listeners
+ * were called.
+ *
+ * Any reference to the back buffer, including views of it, must be released
+ * in the event before #SSEGUI_RESIZE_BUFFERS, or the call fails.
+ *
+ * It is safe to call from any thread, including from within a listener.
+ *
+ * @param[in] callback to call or @param remove
+ * @param[in] remove if positive, append if zero.
+ */
+
+SSEGUI_API void SSEGUI_CCONV
+ssegui_resize_listener (ssegui_resize_callback callback, int remove);
+
+/** @see #ssegui_resize_listener() */
+
+typedef void (SSEGUI_CCONV* ssegui_resize_listener_t)
+    (ssegui_resize_callback, int);
+
+/******************************************************************************/
+
+/**
+ * Load a font into the shared glyph atlas, or find an already loaded one.
+ *
+ * The glyphs are rasterized on background threads, on first request, and kept
+ * as signed distance fields in one texture for all plugins - #ssegui_parameter()
+ * "FontAtlas". It holds one channel, where 0.5 is the glyph edge and bigger is
+ * inside. The distance changes by 0.5 over #SSEGUI_FONT_SPREAD ems. A sharp
+ * edge at any size is e.g. smoothstep (0.5 - w, 0.5 + w, value), with w from
+ * fwidth (value). The least recently used glyphs are evicted when it is full.
+ *
+ * It is safe to call from any thread.
+ *
+ * @param[in] face name of the font, in UTF-8 (e.g. "Segoe UI")
+ * @param[in] weight from 100 (thin) to 900 (black), 400 is normal
+ * @param[out] font identifier to use with the other font functions
+ * @returns non-zero on success, otherwise see #ssegui_last_error ()
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_font (const char* face, int weight, int* font);
+
+/** @see #ssegui_font() */
+
+typedef int (SSEGUI_CCONV* ssegui_font_t) (const char*, int, int*);
+
+/** Ems of distance covered by the half range of the font atlas values. */
+#define SSEGUI_FONT_SPREAD (0.125f)
+
+/** Quad to draw a glyph with, from the font atlas. */
+
+struct ssegui_glyph
+{
+    /** Font atlas texture coordinates, from zero to one. */
+    float u0, v0, u1, v1;
+    /** Quad corners relative to the pen on the baseline, in ems, y down. */
+    float x0, y0, x1, y1;
+    /** Horizontal move of the pen after this glyph, in ems. */
+    float advance;
+    /** Zero while still rasterizing, all above is zero then. Ask again later. */
+    int ready;
+};
+
+/**
+ * Obtain the quads of UTF-8 text, one per code point.
+ *
+ * Missing glyphs are queued for rasterization and reported as not ready, so
+ * the text is usually complete on one of the next frames. Malformed UTF-8
+ * gives U+FFFD. The quads of text used in the current and the previous frame
+ * stay valid, they are never evicted.
+ *
+ * Only the Basic Multilingual Plane is rasterized: code points above U+FFFF,
+ * e.g. emoji, come back ready but empty, with zero advance.
+ *
+ * It is safe to call from any thread.
+ *
+ * @param[in] font as obtained from #ssegui_font()
+ * @param[in] text in UTF-8
+ * @param[in] size of @param text in bytes
+ * @param[in,out] count of @param glyphs, on exit how many were filled in or
+ *  needed, if @param glyphs is nullptr
+ * @param[out] glyphs (optional) to fill in
+ * @returns non-zero on success, otherwise see #ssegui_last_error ()
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_font_glyphs (int font, const char* text, size_t size,
+        size_t* count, struct ssegui_glyph* glyphs);
+
+/** @see #ssegui_font_glyphs() */
+
+typedef int (SSEGUI_CCONV* ssegui_font_glyphs_t)
+    (int, const char*, size_t, size_t*, struct ssegui_glyph*);
+
+/******************************************************************************/
+
+/** The texture of a #ssegui_quad is a signed distance field, like "FontAtlas" */
+#define SSEGUI_QUAD_SDF (1)
+
+/** Screen aligned rectangle, drawn by #ssegui_quads(). */
+
+struct ssegui_quad
+{
+    /** Top left and bottom right corners, in back buffer pixels. */
+    float x0, y0, x1, y1;
+    /** Texture coordinates of the same corners, ignored without texture. */
+    float u0, v0, u1, v1;
+    /** Premultiplied alpha color 0xAABBGGRR, multiplied by the texture. */
+    unsigned color;
+    /** Lower layers are drawn first. */
+    int layer;
+    /** ID3D11ShaderResourceView* with premultiplied alpha, or nullptr. */
+    void* texture;
+    /** Zero or #SSEGUI_QUAD_SDF. */
+    int flags;
+};
+
+/**
+ * Queue quads for drawing onto the back buffer.
+ *
+ * Instead of many small draw calls from each plugin, the quads of all plugins
+ * are sorted by layer, texture and flags, uploaded at once and drawn with one
+ * call per such combination, after the render listeners and the layers. Within
+ * a layer, quads of the same texture and flags keep their order, but quads of
+ * different textures may be reordered - overlapping ones should go into
+ * different layers.
+ *
+ * Quads queued from a render listener are drawn at the same Present, from
+ * other threads - at the next one. The textures must stay alive until then.
+ *
+ * It is safe to call from any thread.
+ *
+ * @param[in] quads to draw, copied
+ * @param[in] count of @param quads
+ * @returns non-zero on success, otherwise see #ssegui_last_error ()
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_quads (const struct ssegui_quad* quads, size_t count);
+
+/** @see #ssegui_quads() */
+
+typedef int (SSEGUI_CCONV* ssegui_quads_t) (const struct ssegui_quad*, size_t);
+
+/******************************************************************************/
+
+/**
+ * Allocate transient memory, freed automatically two frames later.
+ *
+ * Meant for the strings, vertices and other scratch data listeners otherwise
+ * allocate and free each frame. Each thread allocates from its own arena, so
+ * there is no locking and no contention with the heap of the game. There is
+ * no free function: the memory stays valid until the render listeners of the
+ * next Present return, i.e. it can be handed over from one frame to the next.
+ * The frames go on even with rendering disabled: allocating keeps Present
+ * hooked, until a couple of frames after the last allocation.
+ *
+ * It is safe to call from any thread, but the memory should be used within
+ * the frame timeline above, and threads which stop allocating keep their
+ * arenas until they exit.
+ *
+ * @param[in] size in bytes
+ * @param[in] alignment power of two up to 4096, or zero for 16
+ * @returns the memory, or nullptr on failure, see #ssegui_last_error ()
+ */
+
+SSEGUI_API void* SSEGUI_CCONV
+ssegui_frame_alloc (size_t size, size_t alignment);
+
+/** @see #ssegui_frame_alloc() */
+
+typedef void* (SSEGUI_CCONV* ssegui_frame_alloc_t) (size_t, size_t);
+
+/******************************************************************************/
+
+/** Vertex and index data, for #ssegui_upload(). */
+#define SSEGUI_UPLOAD_VERTEX (0)
+
+/** Shader constants, for #ssegui_upload(). */
+#define SSEGUI_UPLOAD_CONSTANT (1)
+
+/** Where #ssegui_upload() placed the data. */
+
+struct ssegui_upload_range
+{
+    /** ID3D11Buffer*, owned by SSEGUI (no reference added). */
+    void* buffer;
+    /** In bytes, from the start of the buffer. */
+    size_t offset;
+};
+
+/**
+ * Copy per-frame data into a buffer shared by all plugins.
+ *
+ * Instead of each plugin mapping its own small dynamic buffers with discard,
+ * SSEGUI appends all uploads into one large buffer per kind, reusing its space
+ * only after the GPU is done with the frame that used it. The data should be
+ * used for drawing within the same frame.
+ *
+ * Vertex uploads go into a vertex and index buffer, bind it with the offset
+ * of @param out as IASetVertexBuffers or IASetIndexBuffer offset. Constant
+ * uploads are at multiples of 256 bytes, bind them with the D3D11.1 calls,
+ * e.g. VSSetConstantBuffers1 with first constant offset / 16 and number of
+ * constants rounded up to 16. They fail on drivers without that support.
+ *
+ * Call only from the render thread, i.e. render listeners without the
+ * #SSEGUI_RENDER_DEFERRED flag. When the GPU lags too much behind, there may
+ * be no room left: the call fails and the plugin should skip drawing or use
+ * its own buffer for the frame.
+ *
+ * @param[in] kind #SSEGUI_UPLOAD_VERTEX or #SSEGUI_UPLOAD_CONSTANT
+ * @param[in] data to copy
+ * @param[in] size of @param data in bytes
+ * @param[in] alignment of the offset, power of two up to 4096, zero for any
+ * @param[out] out where the data went
+ * @returns non-zero on success, otherwise see #ssegui_last_error ()
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_upload (int kind, const void* data, size_t size, size_t alignment,
+        struct ssegui_upload_range* out);
+
+/** @see #ssegui_upload() */
+
+typedef int (SSEGUI_CCONV* ssegui_upload_t)
+    (int, const void*, size_t, size_t, struct ssegui_upload_range*);
+
+/******************************************************************************/
+
+/** Format of #ssegui_capture(), lossless and compressed, slower to write */
+#define SSEGUI_CAPTURE_PNG (1)
+
+/** Format of #ssegui_capture(), lossless, bigger but faster to write */
+#define SSEGUI_CAPTURE_QOI (2)
+
+/**
+ * Capture the next presented frames into image files.
+ *
+ * What is captured is the back buffer with all listeners, layers and quads
+ * drawn. Nothing stalls the game: each frame is copied on the GPU and read
+ * back a few Presents later, then encoded and written by a worker thread.
+ * If the GPU or the writer fall behind, frames are skipped rather than
+ * waited for, see #ssegui_execute() "stats" under "capture".
+ *
+ * Only 8 bit RGBA and BGRA back buffers are supported, alpha is not saved.
+ *
+ * @param[in] path of the file, UTF-8. When capturing more than one frame,
+ *   each gets its index before the extension, e.g. "shot-0003.png".
+ *   Existing files are overwritten.
+ * @param[in] format one of SSEGUI_CAPTURE_*
+ * @param[in] frames to capture, Presents in a row, 1 for a screenshot
+ * @returns non-zero if queued, otherwise see #ssegui_last_error ()
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_capture (const char* path, int format, int frames);
+
+/** @see #ssegui_capture() */
+
+typedef int (SSEGUI_CCONV* ssegui_capture_t) (const char*, int, int);
+
 /******************************************************************************/
 
 /**
@@ -242,9 +952,20 @@ typedef void (SSEGUI_CCONV* ssegui_message_listener_t)
  *
  * Current supported parameters (@param name, @param value type):
  * * "ID3D11Device", ID3D11Device**
- * * "ID3D11DeviceContext", ID3D11Device**
+ * * "ID3D11DeviceContext", ID3D11Device** - the deferred one, when called
+ *   from within a #SSEGUI_RENDER_DEFERRED listener
  * * "IDXGISwapChain", ID3D11Device**
  * * "window", HWND*
+ * * "BackBufferRTV", ID3D11RenderTargetView** - of the current back buffer,
+ *   owned by SSEGUI (no reference added) and valid until the swap chain
+ *   buffers are resized. Available from the first Present.
+ * * "BackBufferSize", UINT[2] - width and height of the above
+ * * "FontAtlas", ID3D11ShaderResourceView** - of the shared glyphs, owned
+ *   by SSEGUI (no reference added), once any font was used
+ * * any plugin defined one, see #ssegui_parameter_handle(), of its type
+ *
+ * Each call looks the name up, so prefer #ssegui_parameter_get() for values
+ * read every frame.
  *
  * @param[in] name of the parameter to obtain value for
  * @param[out] value to store in
@@ -260,6 +981,83 @@ typedef int (SSEGUI_CCONV* ssegui_parameter_t) (const char*, void*);
 
 /******************************************************************************/
 
+/** Type of a parameter, read and written as void* */
+#define SSEGUI_PARAMETER_POINTER (1)
+
+/** Type of a parameter, read and written as long long */
+#define SSEGUI_PARAMETER_INTEGER (2)
+
+/** Type of a parameter, read and written as double */
+#define SSEGUI_PARAMETER_REAL (3)
+
+/**
+ * Handle of a named parameter, for #ssegui_parameter_get() and set.
+ *
+ * Names are interned once and for all, so handles can be kept for the life of
+ * the process. The names of #ssegui_parameter() are already there: the
+ * pointers of SSEGUI, plus "BackBufferWidth" and "BackBufferHeight" as
+ * integers - these are read-only. Other names are shared among plugins, so
+ * one can publish values to others, e.g. "MyPlugin.Texture". Up to 256
+ * names in total.
+ *
+ * Call it once, at init, as it locks.
+ *
+ * @param[in] name of the parameter
+ * @param[in] type one of SSEGUI_PARAMETER_*, of a new one, or zero to only
+ *   find an existing one, whatever its type
+ * @returns non-zero handle, or zero if not found, of another type, or out of
+ *   handles - see #ssegui_last_error ()
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_parameter_handle (const char* name, int type);
+
+/** @see #ssegui_parameter_handle() */
+
+typedef int (SSEGUI_CCONV* ssegui_parameter_handle_t) (const char*, int);
+
+/**
+ * Read the value of a parameter, from any thread, without locking.
+ *
+ * The SSEGUI values change only on the render thread, before and after the
+ * render listeners are called (e.g. "BackBufferRTV" on resize), hence within
+ * a listener they hold still. "ID3D11DeviceContext" here is always the
+ * immediate one, see #ssegui_parameter() for the deferred one.
+ *
+ * @param[in] handle from #ssegui_parameter_handle()
+ * @param[out] value to store in, void*, long long or double per the type
+ * @returns non-zero if there is a value, zero if none (yet) or bad handle,
+ *   without touching #ssegui_last_error ()
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_parameter_get (int handle, void* value);
+
+/** @see #ssegui_parameter_get() */
+
+typedef int (SSEGUI_CCONV* ssegui_parameter_get_t) (int, void*);
+
+/**
+ * Write the value of a plugin parameter, from any thread.
+ *
+ * Readers see either the old or the new value, never a mix of both. Pointed
+ * objects are not owned, keeping them alive is up to the writer.
+ *
+ * @param[in] handle from #ssegui_parameter_handle(), not of a SSEGUI value
+ * @param[in] value to read from, void*, long long or double per the type,
+ *   or nullptr to make it unavailable
+ * @returns non-zero on success, otherwise see #ssegui_last_error ()
+ */
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_parameter_set (int handle, const void* value);
+
+/** @see #ssegui_parameter_set() */
+
+typedef int (SSEGUI_CCONV* ssegui_parameter_set_t) (int, const void*);
+
+/******************************************************************************/
+
 /**
  * Confine the cursor within the fullscreen window.
  *
@@ -286,6 +1084,29 @@ typedef int (SSEGUI_CCONV* ssegui_clip_cursor_t) (int);
  * This is highly implementation specific and may change any moment. It is like
  * patch hole for development use.
  *
+ * Current supported commands (@param command, @param arg type):
+ * * "profile", int* - enable (positive), disable (zero) or only report
+ *   (negative) the timing of each listener call. On exit it contains the old
+ *   value (positive/zero) or the current (negative) one. Off by default.
+ * * "stats", const char** - receives JSON text with the call count, mean, p50,
+ *   p99 and max CPU time (in nanoseconds) of each render, post-Present,
+ *   message, input batch, resize, layer and control listener, and the
+ *   #ssegui_frame_alloc(), #ssegui_upload() and #ssegui_capture() totals.
+ *   Each render listener has also its GPU time under "gpu", measured with
+ *   timestamp queries while profiling and available a few frames later.
+ *   Under "present" are the frame time quantiles (p50 to p999),
+ *   the stutters (frames over twice the recent average) and the time blocked in
+ *   the original Present, gathered while Present is hooked - with no render or
+ *   layer listener nor queued quads, it is not, unless profiling. Under
+ *   "limiter" are the interval and the waits of the frame limiter, if set in
+ *   settings.json, and how far past the deadline it woke up. Under "trace"
+ *   are the records pushed, dropped and written by the input trace. The text
+ *   is valid until the next "stats" call on the same thread.
+ * * "trace", const char* - start recording all window messages and
+ *   DirectInput states, with their time, into the binary file at this UTF-8
+ *   path, or stop with an empty string. A record is dropped, and counted in
+ *   the trace, rather than slowing down the game.
+ *
  * @param[in] command identifier
  * @param[in,out] arg to pass in or out data
  * @returns non-zero on success, otherwise see #ssegui_last_error ()
@@ -304,7 +1125,8 @@ typedef int (SSEGUI_CCONV* ssegui_execute_t) (const char*, void*);
  * Set of function pointers as found in this file.
  *
  * Compatible changes are function pointers appened to the end of this
- * structure.
+ * structure. Version 1.2 ends with control_listener, version 1.3 appended all
+ * the rest at once - i.e. a 1.3.0 or later #ssegui_version() has them all.
  */
 
 struct ssegui_api_v1
@@ -329,6 +1151,44 @@ struct ssegui_api_v1
     ssegui_clip_cursor_t clip_cursor;
     /** @see #ssegui_control_listener() */
     ssegui_control_listener_t control_listener;
+    /** @see #ssegui_render_budget() */
+    ssegui_render_budget_t render_budget;
+    /** @see #ssegui_render_flags() */
+    ssegui_render_flags_t render_flags;
+    /** @see #ssegui_resize_listener() */
+    ssegui_resize_listener_t resize_listener;
+    /** @see #ssegui_layer_listener() */
+    ssegui_layer_listener_t layer_listener;
+    /** @see #ssegui_layer_state() */
+    ssegui_layer_state_t layer_state;
+    /** @see #ssegui_layer_invalidate() */
+    ssegui_layer_invalidate_t layer_invalidate;
+    /** @see #ssegui_font() */
+    ssegui_font_t font;
+    /** @see #ssegui_font_glyphs() */
+    ssegui_font_glyphs_t font_glyphs;
+    /** @see #ssegui_quads() */
+    ssegui_quads_t quads;
+    /** @see #ssegui_frame_alloc() */
+    ssegui_frame_alloc_t frame_alloc;
+    /** @see #ssegui_upload() */
+    ssegui_upload_t upload;
+    /** @see #ssegui_parameter_handle() */
+    ssegui_parameter_handle_t parameter_handle;
+    /** @see #ssegui_parameter_get() */
+    ssegui_parameter_get_t parameter_get;
+    /** @see #ssegui_parameter_set() */
+    ssegui_parameter_set_t parameter_set;
+    /** @see #ssegui_capture() */
+    ssegui_capture_t capture;
+    /** @see #ssegui_present_listener() */
+    ssegui_present_listener_t present_listener;
+    /** @see #ssegui_message_filter() */
+    ssegui_message_filter_t message_filter;
+    /** @see #ssegui_message_priority() */
+    ssegui_message_priority_t message_priority;
+    /** @see #ssegui_input_batch_listener() */
+    ssegui_input_batch_listener_t input_batch_listener;
 };
 
 /** Points to the current API version in use. */
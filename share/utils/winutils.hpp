@@ -149,6 +149,9 @@ std::string format_utf8message (DWORD error_code);
 /// Report as text the given windows message (e.g. WM_*) identifier
 const char* window_message_text (unsigned msg);
 
+/// File name of the module (DLL or EXE) containing the given address, empty if unknown
+std::string module_name (void const* address);
+
 //--------------------------------------------------------------------------------------------------
 
 /// Including file permissions and etc. errors
@@ -0,0 +1,355 @@
+/**
+ * @file bench_capture.cpp
+ * @brief Checks and throughput of the capture encoders and of the staging ring scheduling
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * A synthetic game frame (noisy gradients under flat UI panels) is encoded to QOI and PNG, and
+ * decoded back here to check it is lossless - the PNG through a small inflate of fixed Huffman
+ * blocks, the only kind written. Then the ring runs against a mock GPU finishing each copy some
+ * Presents later, checking no map is attempted too early and frames are dropped, not waited for,
+ * once the GPU lags more than the ring holds.
+ * Usage: bench_capture [width] [height] [frames]
+ */
+
+#include "capture_ring.hpp"
+#include "deferred.hpp"
+#include "profiler.hpp"
+
+#include <random>
+#include <cstdlib>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+static std::uint32_t
+get32 (std::uint8_t const* p)
+{
+    return std::uint32_t (p[0]) << 24 | std::uint32_t (p[1]) << 16 | p[2] << 8 | p[3];
+}
+
+/// RGB of @param in, false if malformed
+static bool
+decode_qoi (std::vector<std::uint8_t> const& in, std::vector<std::uint8_t>& rgb)
+{
+    if (in.size () < 22 || std::memcmp (in.data (), "qoif", 4) || in[12] != 3)
+        return false;
+    auto pixels = std::size_t (get32 (&in[4])) * get32 (&in[8]);
+    rgb.clear ();
+    std::uint8_t index[64][3] = {}, px[3] = { 0, 0, 0 };
+    std::size_t p = 14, end = in.size () - 8;
+    while (rgb.size () < pixels * 3 && p < end)
+    {
+        unsigned b = in[p++], run = 1;
+        if (b == 0xfe)
+        {
+            std::memcpy (px, &in[p], 3);
+            p += 3;
+        }
+        else if ((b & 0xc0) == 0x00)
+            std::memcpy (px, index[b], 3);
+        else if ((b & 0xc0) == 0x40)
+        {
+            px[0] += ((b >> 4) & 3) - 2;
+            px[1] += ((b >> 2) & 3) - 2;
+            px[2] += (b & 3) - 2;
+        }
+        else if ((b & 0xc0) == 0x80)
+        {
+            int dg = int (b & 0x3f) - 32, n = in[p++];
+            px[0] += dg + (n >> 4) - 8;
+            px[1] += dg;
+            px[2] += dg + (n & 15) - 8;
+        }
+        else if (b != 0xff)
+            run = (b & 0x3f) + 1;
+        else
+            return false; // Never written, alpha is dropped
+        std::memcpy (index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + 255 * 11) % 64], px, 3);
+        while (run--)
+            rgb.insert (rgb.end (), px, px + 3);
+    }
+    return rgb.size () == pixels * 3;
+}
+
+/// MSB first Huffman codes within LSB first bits
+class bit_reader
+{
+    std::uint8_t const* p_;
+    std::size_t n_, bit_ = 0;
+
+public:
+    bit_reader (std::uint8_t const* p, std::size_t n) : p_ (p), n_ (n) {}
+    bool ok () const { return bit_ <= n_ * 8; }
+    std::size_t bytes () const { return (bit_ + 7) / 8; }
+
+    unsigned
+    get (unsigned n)
+    {
+        unsigned v = 0;
+        for (unsigned i = 0; i < n; ++i, ++bit_)
+            if (bit_ < n_ * 8)
+                v |= ((p_[bit_ / 8] >> (bit_ % 8)) & 1u) << i;
+        return v;
+    }
+
+    unsigned
+    code (unsigned n, unsigned v = 0)
+    {
+        while (n--)
+            v = (v << 1) | get (1);
+        return v;
+    }
+};
+
+/// Of the single fixed Huffman block of a zlib stream
+static bool
+inflate_fixed (std::uint8_t const* in, std::size_t size, std::vector<std::uint8_t>& out)
+{
+    static const unsigned len_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+        31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const unsigned dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+        193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    auto extra_len = [] (unsigned l) { return l < 8 || l == 28 ? 0u : (l - 4) / 4; };
+    auto extra_dist = [] (unsigned d) { return d < 4 ? 0u : (d - 2) / 2; };
+
+    if (size < 6 || in[0] != 0x78)
+        return false;
+    bit_reader r (in + 2, size - 6);
+    if (r.get (1) != 1 || r.get (2) != 1)
+        return false;
+    out.clear ();
+    for (;;)
+    {
+        unsigned sym = r.code (7);
+        if (sym <= 0x17)
+            sym += 256;
+        else
+        {
+            sym = r.code (1, sym);
+            if (sym >= 0x30 && sym <= 0xbf)
+                sym -= 0x30;
+            else if (sym >= 0xc0 && sym <= 0xc7)
+                sym = sym - 0xc0 + 280;
+            else
+                sym = r.code (1, sym) - 0x190 + 144;
+        }
+        if (!r.ok ())
+            return false;
+        if (sym < 256)
+            out.push_back (std::uint8_t (sym));
+        else if (sym == 256)
+            break;
+        else
+        {
+            unsigned l = sym - 257;
+            unsigned length = len_base[l] + r.get (extra_len (l));
+            unsigned d = r.code (5);
+            unsigned distance = dist_base[d] + r.get (extra_dist (d));
+            if (d > 29 || distance > out.size ())
+                return false;
+            for (auto from = out.size () - distance; length--; )
+                out.push_back (out[from++]);
+        }
+    }
+    return r.bytes () + 2 + 4 == size && image_codec::adler32 (out.data (), out.size ())
+        == get32 (in + size - 4);
+}
+
+/// RGB of @param in, false if malformed
+static bool
+decode_png (std::vector<std::uint8_t> const& in, std::vector<std::uint8_t>& rgb)
+{
+    unsigned width = 0, height = 0;
+    std::vector<std::uint8_t> filtered;
+    for (std::size_t p = 8; p + 12 <= in.size (); )
+    {
+        auto length = get32 (&in[p]);
+        auto type = &in[p + 4];
+        if (p + 12 + length > in.size ()
+                || image_codec::crc32 (type, length + 4) != get32 (type + 4 + length))
+            return false;
+        if (!std::memcmp (type, "IHDR", 4))
+        {
+            width = get32 (type + 4);
+            height = get32 (type + 8);
+        }
+        else if (!std::memcmp (type, "IDAT", 4) && !inflate_fixed (type + 4, length, filtered))
+            return false;
+        p += 12 + length;
+    }
+    std::size_t row = 1 + std::size_t (width) * 3;
+    if (!width || filtered.size () != row * height)
+        return false;
+    rgb.clear ();
+    for (unsigned y = 0; y < height; ++y)
+    {
+        auto f = &filtered[y * row];
+        if (*f++ != 1)
+            return false;
+        std::uint8_t prev[3] = { 0, 0, 0 };
+        for (unsigned x = 0; x < width; ++x)
+            for (int c = 0; c < 3; ++c)
+                rgb.push_back (prev[c] = std::uint8_t (prev[c] + *f++));
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Copies done on a Present are finished by the GPU @ref lag Presents later
+struct mock_gpu
+{
+    std::uint64_t* now;
+    unsigned lag;
+    capture_image const* frame;
+    std::uint64_t* early;                       ///< Maps tried on the Present of the copy
+    std::array<std::uint64_t, 3> copied = {};
+
+    bool
+    copy (unsigned slot)
+    {
+        copied[slot] = *now;
+        return true;
+    }
+
+    bool
+    map (unsigned slot, capture_image& out)
+    {
+        *early += *now == copied[slot];
+        if (*now < copied[slot] + lag)
+            return false;
+        out = *frame;
+        return true;
+    }
+
+    void release () {}
+};
+
+struct ring_result
+{
+    std::uint64_t mapped, dropped, polls, lost, early;
+    std::vector<std::string> paths;
+};
+
+static ring_result
+run_ring (unsigned lag, unsigned frames, capture_image const& image)
+{
+    std::uint64_t now = 0;
+    ring_result r = {};
+    capture_ring<mock_gpu> ring (mock_gpu { &now, lag, &image, &r.early });
+    ring.request_frames ("shots/clip.qoi", 2, frames);
+    for (; now < frames + 200 && ring.busy (); ++now)
+        ring.frame (now, [&r] (capture_job&& job) { r.paths.push_back (job.path); });
+    r.mapped = ring.mapped;
+    r.dropped = ring.dropped;
+    r.polls = ring.polls;
+    r.lost = ring.lost;
+    return r;
+}
+
+int
+main (int argc, char* argv[])
+{
+    unsigned width = argc > 1 ? std::atoi (argv[1]) : 1920;
+    unsigned height = argc > 2 ? std::atoi (argv[2]) : 1080;
+    unsigned frames = argc > 3 ? std::atoi (argv[3]) : 20;
+
+    capture_image image;
+    image.width = width;
+    image.height = height;
+    image.bgra = true;
+    image.pixels.resize (std::size_t (width) * height * 4);
+    std::mt19937 rng (7);
+    std::uniform_int_distribution<int> noise (-6, 6);
+    for (unsigned y = 0; y < height; ++y)
+        for (unsigned x = 0; x < width; ++x)
+        {
+            auto p = &image.pixels[(std::size_t (y) * width + x) * 4];
+            bool panel = (x / 64) % 5 == 0 && y > height / 2;
+            p[0] = std::uint8_t (panel ? 40 : x * 255 / width + noise (rng));
+            p[1] = std::uint8_t (panel ? 40 : y * 255 / height + noise (rng));
+            p[2] = std::uint8_t (panel ? 48 : 128 + noise (rng));
+            p[3] = 0; // Garbage alpha, as back buffers often have
+        }
+    std::vector<std::uint8_t> rgb;
+    for (std::size_t i = 0; i < std::size_t (width) * height; ++i)
+    {
+        auto p = &image.pixels[i * 4];
+        rgb.insert (rgb.end (), { p[2], p[1], p[0] });
+    }
+
+    // Encoders, lossless and their speed
+    std::vector<std::uint8_t> qoi, png, decoded;
+    auto t0 = profiler_now ();
+    for (unsigned i = 0; i < frames; ++i)
+        encode_qoi (image.view (), qoi);
+    auto qoi_ms = double (profiler_now () - t0) / frames * 1e-6;
+    bool bad = !decode_qoi (qoi, decoded) || decoded != rgb;
+
+    t0 = profiler_now ();
+    for (unsigned i = 0; i < frames; ++i)
+        encode_png (image.view (), png);
+    auto png_ms = double (profiler_now () - t0) / frames * 1e-6;
+    bad = bad || !decode_png (png, decoded) || decoded != rgb;
+
+    // As the writer thread gets them, while the "render thread" goes on
+    worker_pool writer (1);
+    std::atomic<std::size_t> written (0);
+    t0 = profiler_now ();
+    for (unsigned i = 0; i < frames; ++i)
+        writer.submit ([&image, &written] {
+            std::vector<std::uint8_t> out;
+            encode_qoi (image.view (), out);
+            written += out.size ();
+        });
+    auto submit_us = double (profiler_now () - t0) / frames * 1e-3;
+    writer.wait ();
+    auto writer_fps = frames / (double (profiler_now () - t0) * 1e-9);
+
+    // Ring: the GPU within the ring depth, then far behind it
+    auto fast = run_ring (1, frames, image);
+    auto slow = run_ring (5, frames, image);
+    char last[32];
+    std::snprintf (last, sizeof (last), "shots/clip-%04u.qoi", frames - 1);
+    bad = bad || fast.mapped != frames || fast.dropped || fast.lost || fast.early
+            || fast.paths.front () != "shots/clip-0000.qoi" || fast.paths.back () != last;
+    bad = bad || slow.mapped + slow.dropped != frames || !slow.dropped || slow.lost
+            || slow.early || !slow.polls;
+    auto single = run_ring (2, 1, image);
+    bad = bad || single.paths.size () != 1 || single.paths[0] != "shots/clip.qoi";
+
+    auto mb = std::size_t (width) * height * 3 / 1e6;
+    std::cout << "image:                  " << width << 'x' << height << '\n'
+              << "qoi ms, ratio:          " << qoi_ms << ", " << qoi.size () / 1e6 / mb << '\n'
+              << "png ms, ratio:          " << png_ms << ", " << png.size () / 1e6 / mb << '\n'
+              << "submit us per frame:    " << submit_us << '\n'
+              << "writer qoi fps:         " << writer_fps << '\n'
+              << "gpu lag 1, mapped:      " << fast.mapped << " (polls " << fast.polls << ")\n"
+              << "gpu lag 5, mapped:      " << slow.mapped << " (dropped " << slow.dropped
+                                            << ", polls " << slow.polls << ")" << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,178 @@
+/**
+ * @file bench_deferred.cpp
+ * @brief Ordering check and benchmark of the deferred listeners rendering
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * A mock device/context pair stands for D3D11: a context records plain integers and executing a
+ * command list appends them to the immediate context. Each synthetic plugin burns some CPU and
+ * records its own index, so after each Present the immediate context must contain the indices in
+ * the registration order. The render thread time per frame is compared to the serial dispatch.
+ * Usage: bench_deferred [plugins] [microseconds per plugin] [frames] [threads]
+ */
+
+#include "deferred.hpp"
+#include "profiler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+struct mock_context
+{
+    std::vector<int> commands;
+};
+
+struct mock_command_list
+{
+    std::vector<int> commands;
+};
+
+struct mock_backend
+{
+    typedef mock_context context;
+    typedef mock_command_list command_list;
+
+    mock_context* immediate;
+    std::atomic<unsigned> created;
+
+    mock_backend () : immediate (nullptr), created (0) {}
+
+    context* create_context () { ++created; return new mock_context; }
+
+    command_list*
+    finish (context* c)
+    {
+        auto l = new mock_command_list { std::move (c->commands) };
+        c->commands.clear ();
+        return l;
+    }
+
+    void
+    execute (command_list* l)
+    {
+        immediate->commands.insert (
+                immediate->commands.end (), l->commands.cbegin (), l->commands.cend ());
+    }
+
+    static void release (context* c) { delete c; }
+    static void release (command_list* l) { delete l; }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+struct plugin
+{
+    int index;
+    deferred_slot<mock_backend> slot;
+};
+
+/// Something to keep the CPU busy
+static void
+burn (std::uint64_t ns)
+{
+    auto end = profiler_now () + ns;
+    while (profiler_now () < end)
+        ;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    int plugins = argc > 1 ? std::atoi (argv[1]) : 8;
+    std::uint64_t work = (argc > 2 ? std::atoi (argv[2]) : 200) * 1000ull;
+    int frames = argc > 3 ? std::atoi (argv[3]) : 500;
+    unsigned threads = argc > 4 ? std::atoi (argv[4]) : 0;
+
+    std::vector<std::shared_ptr<plugin>> list;
+    for (int i = 0; i < plugins; ++i)
+        list.emplace_back (new plugin { i, {} });
+
+    mock_context immediate;
+
+    // Serial, as on the immediate context
+
+    auto t0 = profiler_now ();
+    for (int f = 0; f < frames; ++f)
+    {
+        immediate.commands.clear ();
+        for (auto const& p: list)
+        {
+            burn (work);
+            immediate.commands.push_back (p->index);
+        }
+    }
+    auto serial = (profiler_now () - t0) / frames;
+
+    // Deferred, while some other work (the game frame) happens on the render thread
+
+    deferred_renderer<mock_backend> renderer;
+    renderer.backend ().immediate = &immediate;
+    renderer.threads (threads);
+
+    int bad = 0;
+    std::uint64_t present = 0;
+    for (int f = 0; f < frames; ++f)
+    {
+        auto t1 = profiler_now ();
+        immediate.commands.clear ();
+        renderer.sync ();
+        for (auto const& p: list)
+            renderer.execute (p->slot);
+        for (auto const& p: list)
+            renderer.record (p, p->slot, [p, work] (mock_context* c) {
+                burn (work);
+                c->commands.push_back (p->index);
+            });
+        present += profiler_now () - t1;
+
+        if (f > 0)
+        {
+            bad += int (immediate.commands.size ()) != plugins;
+            for (int i = 0; i < plugins && i < int (immediate.commands.size ()); ++i)
+                bad += immediate.commands[i] != i;
+        }
+
+        burn (work * plugins / 2);
+    }
+    renderer.sync ();
+    present /= frames;
+
+    std::cout << "plugins:                 " << plugins << '\n'
+              << "work per plugin us:      " << work / 1000 << '\n'
+              << "contexts created:        " << renderer.backend ().created << '\n'
+              << "serial per frame us:     " << serial / 1000 << '\n'
+              << "deferred per frame us:   " << present / 1000 << '\n'
+              << "out of order frames:     " << bad << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
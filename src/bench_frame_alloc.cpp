@@ -0,0 +1,223 @@
+/**
+ * @file bench_frame_alloc.cpp
+ * @brief Checks and benchmark of the per-frame arenas against the heap
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * The Present loop dispatches through the listener registry to a number of render listeners, each
+ * building a few strings and vertex arrays per frame - once with malloc/free and once with the
+ * frame arenas - while other threads churn the heap as the game would. The arena memory of each
+ * frame is checked to be intact during the next one, and properly aligned.
+ * Usage: bench_frame_alloc [frames] [listeners] [heap threads]
+ */
+
+#include "frame_arena.hpp"
+#include "listeners.hpp"
+#include "profiler.hpp"
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+typedef void (*render_callback) (unsigned);
+
+static bool use_arena;
+static std::atomic<std::uint64_t> frame (0);
+static thread_local frame_arenas arenas;
+static int bad_align = 0, bad_data = 0;
+
+static void*
+allocate (std::size_t size, std::size_t alignment)
+{
+    return use_arena ? arenas.allocate (size, alignment, frame.load (std::memory_order_acquire))
+                     : std::malloc (size);
+}
+
+static void
+release (void* p)
+{
+    if (!use_arena)
+        std::free (p);
+}
+
+/// What a listener keeps from the previous frame, to be checked
+struct kept
+{
+    unsigned char* data = nullptr;
+    std::size_t size = 0;
+    unsigned char pattern = 0;
+};
+static std::array<kept, 64> previous;
+
+template<int N>
+static void
+callback (unsigned f)
+{
+    // Formatting a few labels and filling a vertex array of varying size
+    constexpr std::size_t sizes[] = { 24, 40, 72, 130, 260 };
+    void* labels[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        auto n = sizes[(i + f + N) % 5];
+        labels[i] = allocate (n, 16);
+        std::memset (labels[i], i, n);
+    }
+    auto vertices = static_cast<float*> (allocate (sizeof (float) * 4 * (64 + f % 64), 16));
+    bad_align += (reinterpret_cast<std::uintptr_t> (vertices) & 15) != 0;
+    for (unsigned i = 0; i < 4 * (64 + f % 64); ++i)
+        vertices[i] = float (i);
+
+    for (auto p: labels)
+        release (p);
+    release (vertices);
+
+    if (N >= int (previous.size ()))
+        return;
+
+    // Must survive until the end of the next frame, the heap has to free it explicitly
+    auto& k = previous[N];
+    for (std::size_t i = 0; i < k.size; ++i)
+        bad_data += k.data[i] != k.pattern;
+    release (k.data);
+    k.size = 512 + f % 512;
+    k.pattern = std::uint8_t (f);
+    k.data = static_cast<unsigned char*> (allocate (k.size, 64));
+    bad_align += use_arena && (reinterpret_cast<std::uintptr_t> (k.data) & 63) != 0;
+    std::memset (k.data, k.pattern, k.size);
+}
+
+template<int... N>
+static constexpr std::array<render_callback, sizeof... (N)>
+make_callbacks (std::integer_sequence<int, N...>)
+{
+    return {{ &callback<N>... }};
+}
+
+static constexpr auto callbacks = make_callbacks (std::make_integer_sequence<int, 64> ());
+
+//--------------------------------------------------------------------------------------------------
+
+/// Average nanoseconds per frame of the Present loop
+
+static std::uint64_t
+present_loop (listener_registry<render_callback>& registry, int frames)
+{
+    auto t0 = profiler_now ();
+    for (int f = 0; f < frames; ++f)
+    {
+        for (auto l: registry.read ())
+            l (unsigned (f));
+        frame.fetch_add (1, std::memory_order_release); // As chain_present() does
+    }
+    return (profiler_now () - t0) / frames;
+}
+
+/// Average nanoseconds of an allocation alone, mixed sizes and none kept past the frame
+
+static double
+allocation_loop (int frames)
+{
+    constexpr std::size_t sizes[] = { 24, 40, 72, 130, 260, 1024, 16, 4096 };
+    void* p[64];
+    auto t0 = profiler_now ();
+    for (int f = 0; f < frames; ++f)
+    {
+        for (int i = 0; i < 64; ++i)
+            p[i] = allocate (sizes[(i + f) % 8], 16);
+        for (auto q: p)
+            release (q);
+        frame.fetch_add (1, std::memory_order_release);
+    }
+    return double (profiler_now () - t0) / frames / 64;
+}
+
+int
+main (int argc, char* argv[])
+{
+    int frames = argc > 1 ? std::atoi (argv[1]) : 5000;
+    unsigned listeners = argc > 2 ? std::atoi (argv[2]) : 16;
+    unsigned heap_threads = argc > 3 ? std::atoi (argv[3]) : 2;
+    listeners = std::min<unsigned> (listeners, callbacks.size ());
+
+    listener_registry<render_callback> registry;
+    for (unsigned i = 0; i < listeners; ++i)
+        registry.update (callbacks[i], false);
+
+    // The game allocates too
+    std::atomic<bool> stop (false);
+    std::vector<std::thread> heap;
+    for (unsigned t = 0; t < heap_threads; ++t)
+        heap.emplace_back ([&stop, t] {
+            std::mt19937 rng (t);
+            std::uniform_int_distribution<std::size_t> size (16, 1024);
+            std::vector<void*> live (256, nullptr);
+            while (!stop.load (std::memory_order_relaxed))
+            {
+                auto& p = live[rng () % live.size ()];
+                std::free (p);
+                p = std::malloc (size (rng));
+                std::this_thread::yield ();
+            }
+            for (auto p: live)
+                std::free (p);
+        });
+
+    use_arena = false;
+    auto heap_alloc_ns = allocation_loop (frames);
+    present_loop (registry, frames / 10);
+    auto heap_ns = present_loop (registry, frames);
+    for (auto& k: previous)
+        release (std::exchange (k, kept {}).data);
+    use_arena = true;
+    auto arena_alloc_ns = allocation_loop (frames);
+    present_loop (registry, frames / 10);
+    auto arena_ns = present_loop (registry, frames);
+
+    stop = true;
+    for (auto& t: heap)
+        t.join ();
+
+    auto per_frame = listeners * 17 + std::min<unsigned> (listeners, unsigned (previous.size ()));
+    std::cout << "listeners:               " << listeners << '\n'
+              << "allocations per frame:   " << per_frame << '\n'
+              << "malloc ns per alloc:     " << heap_alloc_ns << '\n'
+              << "arena ns per alloc:      " << arena_alloc_ns << '\n'
+              << "malloc ns per frame:     " << heap_ns << '\n'
+              << "arena ns per frame:      " << arena_ns << '\n'
+              << "arena allocations:       " << arenas.stats.allocations << '\n'
+              << "arena peak bytes:        " << arenas.stats.peak << '\n'
+              << "arena reserved bytes:    " << arenas.stats.reserved << '\n'
+              << "bad align/data           " << bad_align << '/' << bad_data << std::endl;
+
+    return bad_align + bad_data ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
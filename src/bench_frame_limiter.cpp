@@ -0,0 +1,158 @@
+/**
+ * @file bench_frame_limiter.cpp
+ * @brief Frame limiter cadence checks on a simulated clock, and its precision on the real one
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * A synthetic game capped at 100 FPS runs on a simulated clock whose sleeps oversleep randomly,
+ * with a long hitch now and then. The average frame rate must match the cap, the hitches must
+ * restart the cadence rather than cause bursts, and the wake up error is compared to a limiter
+ * which only sleeps. Then the limiter runs on the real clock, with std::this_thread::sleep_for,
+ * for a second at 240 FPS - reported only, as it depends on the machine.
+ * Usage: bench_frame_limiter [frames]
+ */
+
+#include "frame_limiter.hpp"
+#include "profiler.hpp"
+
+#include <random>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Sleeps oversleep by ~0.5ms, a spin takes 1us
+struct simulated_clock
+{
+    std::uint64_t t = 1;
+    std::uint64_t spins = 0;
+    std::mt19937 rng { 42 };
+    std::lognormal_distribution<double> oversleep { 0., .5 };
+
+    std::uint64_t now () { return t; }
+    void sleep (std::uint64_t ns) { t += ns + std::uint64_t (5e5 * oversleep (rng)); }
+    void relax () { t += 1000; ++spins; }
+};
+
+/// Sleeps up to the deadline, no spinning
+struct sleep_only
+{
+    std::uint64_t deadline = 0;
+    duration_histogram error;
+
+    void
+    wait (simulated_clock& c, std::uint64_t interval)
+    {
+        if (!deadline)
+            deadline = c.now ();
+        if (c.now () < deadline)
+        {
+            c.sleep (deadline - c.now ());
+            error.record (c.now () - deadline);
+        }
+        else if (c.now () - deadline >= interval)
+            deadline = c.now ();
+        deadline += interval;
+    }
+};
+
+struct real_clock
+{
+    std::uint64_t now () { return profiler_now (); }
+    void sleep (std::uint64_t ns) { std::this_thread::sleep_for (std::chrono::nanoseconds (ns)); }
+    void relax () {}
+};
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    int frames = argc > 1 ? std::atoi (argv[1]) : 100000;
+    constexpr std::uint64_t interval = 10000000;
+
+    std::mt19937 rng (7);
+    std::lognormal_distribution<double> work (0., .3);
+
+    frame_limiter<simulated_clock> limiter;
+    limiter.limit (100);
+    auto& clock = limiter.clock ();
+    std::uint64_t hitches = 0, start = 0;
+    for (int f = 0; f < frames; ++f)
+    {
+        if (f % 1000 == 999)
+        {
+            clock.t += 50000000;
+            ++hitches;
+        }
+        else
+            clock.t += std::uint64_t (4e6 * work (rng));
+        limiter.wait ();
+        if (!f)
+            start = clock.t;
+    }
+    // Hitches cost 50ms, plus the frame they cut short
+    double expected = double (frames - 1 - hitches) * interval + hitches * 50e6;
+    double rate = double (clock.t - start) / expected;
+
+    simulated_clock naive_clock;
+    sleep_only naive;
+    for (int f = 0; f < frames; ++f)
+    {
+        naive_clock.t += std::uint64_t (4e6 * work (rng));
+        naive.wait (naive_clock, interval);
+    }
+
+    // Real clock, few enough frames for a quick run
+    frame_limiter<real_clock> real;
+    real.limit (240);
+    auto t0 = profiler_now ();
+    for (int f = 0; f < 240; ++f)
+        real.wait ();
+    auto elapsed = profiler_now () - t0;
+
+    bool bad = rate < .99 || rate > 1.01 || limiter.resyncs.load () != hitches
+            || limiter.error.quantile (.5) > 10000
+            || limiter.error.quantile (.5) * 10 > naive.error.quantile (.5);
+
+    std::cout << "frames:                   " << frames << '\n'
+              << "duration vs expected:     " << rate << '\n'
+              << "resyncs:                  " << limiter.resyncs.load ()
+                                              << " (" << hitches << " hitches)\n"
+              << "late:                     " << limiter.late.load () << '\n'
+              << "margin us:                " << limiter.margin () * 1e-3 << '\n'
+              << "spins per frame:          " << double (clock.spins) / frames << '\n'
+              << "error p50/p99 us:         " << limiter.error.quantile (.5) * 1e-3 << '/'
+                                              << limiter.error.quantile (.99) * 1e-3 << '\n'
+              << "sleep only p50/p99 us:    " << naive.error.quantile (.5) * 1e-3 << '/'
+                                              << naive.error.quantile (.99) * 1e-3 << '\n'
+              << "real 240 FPS in ms:       " << elapsed * 1e-6 << '\n'
+              << "real error p50/p99 us:    " << real.error.quantile (.5) * 1e-3 << '/'
+                                              << real.error.quantile (.99) * 1e-3 << '\n'
+              << "real margin us:           " << real.margin () * 1e-3 << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
@@ -0,0 +1,152 @@
+/**
+ * @file bench_frame_pacing.cpp
+ * @brief Checks and benchmark of the frame pacing histograms against exact quantiles
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * A synthetic game runs at ~60 FPS with jitter, some stutters and a few loading screens, on a
+ * simulated clock. The quantiles of the frame and blocking times are compared to the exact ones
+ * (sorting all samples), and so is the stutter count. The cost of the three timestamps per
+ * Present is then measured on the real clock.
+ * Usage: bench_frame_pacing [frames]
+ */
+
+#include "frame_pacing.hpp"
+#include "profiler.hpp"
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+static double
+exact (std::vector<std::uint64_t>& v, double q)
+{
+    auto n = std::size_t (q * (v.size () - 1));
+    std::nth_element (v.begin (), v.begin () + n, v.end ());
+    return double (v[n]);
+}
+
+/// Relative error of the histogram quantiles, the worst of them
+template<class Histogram>
+static double
+worst_error (Histogram const& h, std::vector<std::uint64_t>& samples)
+{
+    double worst = 0;
+    for (double q: { .5, .9, .99, .999 })
+    {
+        auto e = exact (samples, q);
+        worst = std::max (worst, std::abs (double (h.quantile (q)) - e) / e);
+    }
+    return worst;
+}
+
+int
+main (int argc, char* argv[])
+{
+    int frames = argc > 1 ? std::atoi (argv[1]) : 1000000;
+
+    std::mt19937 rng (42);
+    std::lognormal_distribution<double> jitter (0., .08);
+    std::uniform_real_distribution<double> spikes (2.5, 4.);
+    std::uniform_int_distribution<int> events (0, 9999);
+
+    frame_pacing pacing;
+    duration_histogram coarse;
+    std::vector<std::uint64_t> frame_times, blocked_times;
+    frame_times.reserve (frames);
+    blocked_times.reserve (frames);
+
+    std::uint64_t now = 1, injected = 0;
+    for (int f = 0; f < frames; ++f)
+    {
+        pacing.enter (now);
+        auto work = std::uint64_t (2e6 * jitter (rng));         // Listeners and such
+        pacing.call (now + work);
+        auto present = std::uint64_t (12e6 * jitter (rng));     // Waiting for vsync
+        pacing.exit (now + work + present);
+        blocked_times.push_back (present);
+
+        auto frame = std::uint64_t (16.67e6 * jitter (rng));
+        auto e = events (rng);
+        if (e < 100)
+        {
+            frame = std::uint64_t (frame * spikes (rng));
+            ++injected;
+        }
+        else if (e == 100)
+            frame = 5000000000; // Loading screen
+        frame = std::max (frame, work + present);
+        if (frame < frame_pacing::pause)
+        {
+            frame_times.push_back (frame);
+            coarse.record (frame);
+        }
+        now += frame;
+    }
+    pacing.enter (now);
+
+    auto frame_error = worst_error (pacing.frame, frame_times);
+    auto blocked_error = worst_error (pacing.blocked, blocked_times);
+    auto coarse_error = worst_error (coarse, frame_times);
+
+    // Three timestamps per Present, as chain_present() does
+    frame_pacing timed;
+    int loops = 1000000;
+    auto t0 = profiler_now ();
+    for (int i = 0; i < loops; ++i)
+    {
+        timed.enter (profiler_now ());
+        timed.call (profiler_now ());
+        timed.exit (profiler_now ());
+    }
+    auto ns = double (profiler_now () - t0) / loops;
+
+    auto stutters = pacing.stutters.load ();
+    bool bad_stutters = stutters < injected * 9 / 10 || stutters > injected * 11 / 10;
+    bool bad = frame_error > .01 || blocked_error > .01 || bad_stutters
+            || pacing.frame.count () != frame_times.size ();
+
+    std::cout << "frames:                 " << pacing.frame.count () << '\n'
+              << "p50/p90/p99/p999 ms:    " << pacing.frame.quantile (.5) * 1e-6 << '/'
+                                            << pacing.frame.quantile (.9) * 1e-6 << '/'
+                                            << pacing.frame.quantile (.99) * 1e-6 << '/'
+                                            << pacing.frame.quantile (.999) * 1e-6 << '\n'
+              << "stutters:               " << stutters << " (" << injected << " injected)\n"
+              << "pauses:                 " << pacing.pauses.load () << '\n'
+              << "blocked p50/p99 ms:     " << pacing.blocked.quantile (.5) * 1e-6 << '/'
+                                            << pacing.blocked.quantile (.99) * 1e-6 << '\n'
+              << "frame quantile error:   " << frame_error * 100 << "%\n"
+              << "blocked quantile error: " << blocked_error * 100 << "%\n"
+              << "coarse quantile error:  " << coarse_error * 100 << "%\n"
+              << "sketch bytes:           " << sizeof (frame_pacing) << '\n'
+              << "ns per Present:         " << ns << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
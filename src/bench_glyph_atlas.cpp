@@ -0,0 +1,174 @@
+/**
+ * @file bench_glyph_atlas.cpp
+ * @brief Checks and benchmark of the glyph atlas eviction and signed distance fields
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * Each frame looks up text drawn from a Zipf distribution over a large set of code points (think
+ * CJK), in a few fonts, as the font service does. The atlas must never hand out the same cell
+ * twice, nor evict a glyph used in the last two frames. The distance field of a disc is checked
+ * against the analytic one and the UTF-8 decoder against a few malformed sequences.
+ * Usage: bench_glyph_atlas [frames] [glyphs per frame] [distinct code points]
+ */
+
+#include "glyph_atlas.hpp"
+#include "profiler.hpp"
+
+#include <set>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+struct glyph { std::uint64_t since; };
+
+static int
+check_utf8 ()
+{
+    struct { std::string text; std::u32string expected; } const cases[] = {
+        { "a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", U"a\u00e9\u20ac\U0001f600" },
+        { "\xc0\xaf", U"\ufffd\ufffd" },            // Overlong
+        { "\xed\xa0\x80", U"\ufffd\ufffd\ufffd" },  // Surrogate
+        { "\xe2\x82", U"\ufffd\ufffd" },            // Truncated
+        { "\x80z", U"\ufffdz" },                    // Lone continuation
+    };
+    int bad = 0;
+    for (auto const& c: cases)
+    {
+        std::u32string decoded;
+        for (char const* s = c.text.data (), *e = s + c.text.size (); s < e; )
+            decoded += utf8_next (s, e);
+        bad += decoded != c.expected;
+    }
+    return bad;
+}
+
+static int
+check_sdf (std::uint64_t& ns)
+{
+    const unsigned scale = 4, cell = 48, size = (cell - 8) * scale;
+    const float spread = 4, radius = size / 2.5f;
+    std::vector<std::uint8_t> coverage (size * size), sdf (cell * cell);
+    for (unsigned y = 0; y < size; ++y)
+        for (unsigned x = 0; x < size; ++x)
+        {
+            float dx = x + .5f - size / 2.f, dy = y + .5f - size / 2.f;
+            coverage[y * size + x] = dx * dx + dy * dy <= radius * radius ? 255 : 0;
+        }
+
+    auto t0 = profiler_now ();
+    make_sdf (coverage.data (), size, size, scale, spread, sdf.data (), cell, cell);
+    ns = profiler_now () - t0;
+
+    // Within the spread the value must follow the distance to the circle, in output pixels
+    int bad = 0;
+    float m = float (sdf_margin (spread)), c = m + size / 2.f / scale, r = radius / scale;
+    for (unsigned y = 0; y < cell; ++y)
+        for (unsigned x = 0; x < cell; ++x)
+        {
+            float d = r - std::hypot (x + .5f - c, y + .5f - c);
+            if (std::abs (d) >= spread - 1)
+                continue;
+            float expected = 128 + d * 127 / spread;
+            bad += std::abs (sdf[y * cell + x] - expected) > 127 / spread * .75f;
+        }
+    return bad;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    int frames = argc > 1 ? std::atoi (argv[1]) : 2000;
+    int per_frame = argc > 2 ? std::atoi (argv[2]) : 2000;
+    int distinct = argc > 3 ? std::atoi (argv[3]) : 6000;
+
+    int bad_utf8 = check_utf8 ();
+    std::uint64_t sdf_ns;
+    int bad_sdf = check_sdf (sdf_ns);
+
+    // Zipf over the code points, as in the natural languages
+    std::vector<double> weights (distinct);
+    for (int i = 0; i < distinct; ++i)
+        weights[i] = 1. / (i + 1);
+    std::discrete_distribution<int> zipf (weights.begin (), weights.end ());
+    std::uniform_int_distribution<std::uint32_t> fonts (0, 2);
+    std::mt19937 rng (42);
+
+    std::vector<glyph_key> text (per_frame), previous;
+    glyph_atlas<glyph> atlas (2048, 2048, 48);
+    int bad_cells = 0, bad_evictions = 0;
+    std::uint64_t lookup_ns = 0;
+
+    for (int f = 2; f < frames + 2; ++f)
+    {
+        for (auto& k: text)
+            k = { fonts (rng), char32_t (0x4e00 + zipf (rng)) };
+
+        auto t0 = profiler_now ();
+        for (auto& k: text)
+        {
+            auto e = atlas.find (k, f);
+            if (!e && (e = atlas.insert (k, f)))
+                e->glyph.since = f;
+            if (!e)
+                k.font = ~0u; // Refused, not to be checked below
+        }
+        lookup_ns += profiler_now () - t0;
+
+        // Anything found or placed in this frame, or the previous one, must still be there
+        for (auto const& k: text)
+            bad_evictions += k.font != ~0u && !atlas.peek (k);
+        for (auto const& k: previous)
+            bad_evictions += k.font != ~0u && !atlas.peek (k);
+        previous = text;
+
+        if (f % 100 == 0)
+        {
+            std::set<unsigned> cells;
+            for (auto const& e: atlas)
+                bad_cells += !cells.insert (e.cell).second;
+            bad_cells += atlas.size () > atlas.capacity ();
+        }
+    }
+
+    auto lookups = std::uint64_t (frames) * per_frame;
+    int bad = bad_utf8 + bad_sdf + bad_cells + bad_evictions;
+
+    std::cout << "capacity:              " << atlas.capacity () << '\n'
+              << "hit ratio:             " << double (atlas.hits) / lookups << '\n'
+              << "evictions:             " << atlas.evictions << '\n'
+              << "refusals (all in use): " << atlas.refusals << '\n'
+              << "lookup ns:             " << lookup_ns / lookups << '\n'
+              << "sdf 48x48 x4 us:       " << sdf_ns / 1000 << '\n'
+              << "bad utf8/sdf/cells/lru " << bad_utf8 << '/' << bad_sdf << '/'
+              << bad_cells << '/' << bad_evictions << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
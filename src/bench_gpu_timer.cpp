@@ -0,0 +1,208 @@
+/**
+ * @file bench_gpu_timer.cpp
+ * @brief Checks and benchmark of the GPU timestamp query ring against a fake GPU
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * Each frame a number of listeners "draw" for a known count of GPU ticks, each timed through the
+ * ring. The fake GPU has the query results a random number of frames later, sometimes much later
+ * (a hitch, so the ring runs full and frames are skipped) or never (e.g. a lost device). Some
+ * frames are disjoint. Every reported time must be the one of its listener and frame, reported
+ * once, and no query may be read before its results are there or sooner than the ring latency.
+ * Usage: bench_gpu_timer [frames] [listeners]
+ */
+
+#include "gpu_timer.hpp"
+#include "profiler.hpp"
+
+#include <memory>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+struct fake_gpu
+{
+    std::uint64_t frame = 0;        ///< Current CPU frame
+    std::uint64_t ticks = 0;        ///< GPU clock, advanced by the listeners "drawing"
+    std::uint64_t latency = 1;      ///< Of the queries ended this frame
+    bool unreliable = false;        ///< This frame is disjoint
+    std::uint64_t polls = 0, not_ready = 0, early = 0, alive = 0;
+
+    static constexpr std::uint64_t frequency = 25000000;
+};
+
+struct fake_query
+{
+    fake_gpu* gpu;
+    std::uint64_t issued, ready_at, value;
+    bool unreliable;
+};
+
+struct fake_backend
+{
+    typedef fake_query query;
+
+    fake_gpu* gpu;
+
+    query*
+    create (bool)
+    {
+        ++gpu->alive;
+        return new fake_query { gpu, 0, 0, 0, false };
+    }
+
+    void begin (query*) {}
+
+    void
+    end (query* q)
+    {
+        q->issued = gpu->frame;
+        q->ready_at = gpu->frame + gpu->latency;
+        q->value = gpu->ticks;
+        q->unreliable = gpu->unreliable;
+    }
+
+    bool
+    poll (query* q)
+    {
+        ++gpu->polls;
+        gpu->early += gpu->frame - q->issued < gpu_timer<fake_backend, int>::latency;
+        gpu->not_ready += gpu->frame < q->ready_at;
+        return gpu->frame >= q->ready_at;
+    }
+
+    bool
+    ready (query* q, std::uint64_t& frequency, bool& disjoint)
+    {
+        frequency = fake_gpu::frequency;
+        disjoint = q->unreliable;
+        return poll (q);
+    }
+
+    bool
+    ready (query* q, std::uint64_t& ticks)
+    {
+        ticks = q->value;
+        return poll (q);
+    }
+
+    static void
+    release (query* q)
+    {
+        --q->gpu->alive;
+        delete q;
+    }
+};
+
+/// Whose time, as the render listener info pointer would be
+struct key
+{
+    int listener = -1;
+    std::uint64_t frame = 0;
+};
+
+static std::uint64_t
+cost (int listener, std::uint64_t frame)
+{
+    return 100 + (listener * 7919 + frame * 104729) % 5000;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    int frames = argc > 1 ? std::atoi (argv[1]) : 100000;
+    int listeners = argc > 2 ? std::atoi (argv[2]) : 16;
+
+    fake_gpu gpu;
+    std::mt19937 rng (42);
+    std::uniform_int_distribution<int> latencies (1, 5), hitches (0, 999), disjoints (0, 99);
+
+    std::vector<std::uint8_t> seen (std::size_t (frames + 1) * listeners, 0);
+    std::uint64_t results = 0, wrong = 0, twice = 0, disjoint_frames = 0, ns = 0;
+    int bad_frames = 0;
+
+    {
+        gpu_timer<fake_backend, key> timer (fake_backend { &gpu });
+        std::vector<std::uint8_t> unreliable (frames + 1, 0);
+
+        for (int f = 1; f <= frames; ++f)
+        {
+            gpu.frame = std::uint64_t (f);
+            auto h = hitches (rng);
+            gpu.latency = h == 0 ? 40 : h == 1 ? 1000000 : latencies (rng);
+            gpu.unreliable = !disjoints (rng);
+            unreliable[f] = gpu.unreliable;
+            disjoint_frames += gpu.unreliable;
+
+            auto t0 = profiler_now ();
+            timer.collect ([&] (key const& k, std::uint64_t t) {
+                ++results;
+                if (k.listener < 0 || unreliable[k.frame]
+                        || t != cost (k.listener, k.frame) * 1000000000 / fake_gpu::frequency)
+                    ++wrong;
+                else
+                    twice += seen[k.frame * listeners + k.listener]++ != 0;
+            });
+            timer.begin_frame ();
+            for (int i = 0; i < listeners; ++i)
+            {
+                int q = timer.start (key { i, std::uint64_t (f) });
+                gpu.ticks += cost (i, f);
+                timer.stop (q);
+            }
+            timer.end_frame ();
+            ns += profiler_now () - t0;
+        }
+
+        // Each frame timed must have all of its listeners, none of the others
+        for (int f = 1; f <= frames; ++f)
+        {
+            int n = 0;
+            for (int i = 0; i < listeners; ++i)
+                n += seen[std::size_t (f) * listeners + i];
+            bad_frames += n != 0 && n != listeners;
+        }
+
+        std::cout << "frames timed:           " << timer.timed.load () << '/' << frames << '\n'
+                  << "skipped (GPU late):     " << timer.skipped.load () << '\n'
+                  << "disjoint:               " << timer.disjoint.load () << '/'
+                                                << disjoint_frames << '\n'
+                  << "lost:                   " << timer.lost.load () << '\n'
+                  << "listener times:         " << results << '\n'
+                  << "polls not ready:        " << gpu.not_ready << '/' << gpu.polls << '\n'
+                  << "ns per frame:           " << double (ns) / frames << '\n';
+    }
+
+    std::cout << "bad early/wrong/twice/frames/leaks "
+              << gpu.early << '/' << wrong << '/' << twice << '/' << bad_frames << '/'
+              << gpu.alive << std::endl;
+
+    return gpu.early + wrong + twice + bad_frames + gpu.alive || !results ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
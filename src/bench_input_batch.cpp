@@ -0,0 +1,206 @@
+/**
+ * @file bench_input_batch.cpp
+ * @brief Input delivered per message against coalesced per frame batches
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * A 1000Hz mouse (WM_MOUSEMOVE and relative WM_INPUT each millisecond), typing, clicks and wheel
+ * turns are replayed at 60 FPS to a few plugins, once with a call per message and once with a
+ * batch per frame. The batches must carry the same motion sums and the same presses, releases
+ * and characters in the same order. Then a window thread and a render thread push and take
+ * concurrently, and no message may get lost.
+ * Usage: bench_input_batch [seconds] [plugins]
+ */
+
+#include "input_batch.hpp"
+#include "profiler.hpp"
+
+#include <random>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+/// What a plugin makes of the input, so the calls are not optimized out
+struct plugin_state
+{
+    std::int64_t x = 0, y = 0;
+    std::uint64_t edges = 0;
+    std::vector<unsigned> order;    ///< Of the edges, for the first plugin only
+};
+
+static bool
+is_motion (ssegui_input_event const& e)
+{
+    return e.msg == 0x0200 || e.msg == 0x020A || (e.msg == 0x00FF && !e.wParam);
+}
+
+#if defined(__GNUC__)
+#   define NOINLINE __attribute__ ((noinline))
+#else
+#   define NOINLINE __declspec (noinline)
+#endif
+
+/// As if in another module
+NOINLINE static void
+handle (plugin_state& p, ssegui_input_event const& e, bool record)
+{
+    p.x += e.dx;
+    p.y += e.dy;
+    if (!is_motion (e))
+    {
+        ++p.edges;
+        if (record)
+            p.order.push_back (e.msg);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    double seconds = argc > 1 ? std::atof (argv[1]) : 60;
+    unsigned plugins = argc > 2 ? std::atoi (argv[2]) : 4;
+
+    // Input and frames, in time order, a frame being a zero message
+    std::mt19937 rng (42);
+    std::uniform_int_distribution<int> motion (-3, 3), chance (0, 999);
+    std::vector<ssegui_input_event> trace;
+    std::uint64_t frame = 0, ms = 0, inputs = 0;
+    for (std::uint64_t t = 0; t < std::uint64_t (seconds * 1e9); t += 100000)
+    {
+        if (t >= frame)
+        {
+            trace.push_back ({ 0, 0, 0, 0, 0, 0, t });
+            frame += 16666667;
+        }
+        if (t < ms)
+            continue;
+        ms += 1000000;
+        trace.push_back ({ 0x0200, 1, 0, std::intptr_t (t & 0xFFFF), 0, 0, t });
+        trace.push_back ({ 0x00FF, 1, 0, 0, motion (rng), motion (rng), t });
+        auto c = chance (rng);
+        if (c < 10) // Typing, 10 keys per second
+        {
+            trace.push_back ({ 0x0100, 1, 'A', 0, 0, 0, t });
+            trace.push_back ({ 0x0102, 1, 'a', 0, 0, 0, t });
+            trace.push_back ({ 0x0101, 1, 'A', 0, 0, 0, t });
+        }
+        else if (c < 15)
+        {
+            trace.push_back ({ 0x0201, 1, 1, 0, 0, 0, t });
+            trace.push_back ({ 0x0202, 1, 0, 0, 0, 0, t });
+        }
+        else if (c < 17)
+            trace.push_back ({ 0x020A, 1, 0, 0, 0, 120, t });
+    }
+    for (auto const& e: trace)
+        inputs += e.count;
+
+    // A call per message and plugin
+    std::vector<plugin_state> each (plugins);
+    std::uint64_t calls = 0;
+    auto t0 = profiler_now ();
+    for (auto const& e: trace)
+        if (e.count)
+            for (unsigned i = 0; i < plugins; ++i, ++calls)
+                handle (each[i], e, !i);
+    auto t1 = profiler_now ();
+
+    // A batch per frame and plugin
+    std::vector<plugin_state> batched (plugins);
+    input_batch batch;
+    std::vector<ssegui_input_event> taken;
+    std::uint64_t batch_calls = 0, merged = 0;
+    auto t2 = profiler_now ();
+    for (auto const& e: trace)
+    {
+        if (e.count)
+        {
+            batch.push (e, is_motion (e));
+            continue;
+        }
+        if (!batch.take (taken))
+            continue;
+        for (unsigned i = 0; i < plugins; ++i, ++batch_calls)
+            for (auto const& b: taken)
+            {
+                handle (batched[i], b, !i);
+                merged += i ? 0 : b.count;
+            }
+    }
+    batch.take (taken);
+    for (unsigned i = 0; i < plugins; ++i)
+        for (auto const& b: taken)
+        {
+            handle (batched[i], b, !i);
+            merged += i ? 0 : b.count;
+        }
+    auto t3 = profiler_now ();
+
+    bool bad = merged != inputs || batch.dropped.load ();
+    for (unsigned i = 0; i < plugins; ++i)
+        bad = bad || each[i].x != batched[i].x || each[i].y != batched[i].y
+                  || each[i].edges != batched[i].edges;
+    bad = bad || each[0].order != batched[0].order;
+
+    // Concurrent push and take
+    input_batch shared;
+    std::uint64_t pushed = 2000000, received = 0;
+    std::thread window ([&] {
+        for (std::uint64_t i = 0; i < pushed; ++i)
+        {
+            ssegui_input_event e = { i % 64 ? 0x0200u : 0x0100u, 1, 0, 0, 1, 0, i };
+            shared.push (e, e.msg == 0x0200);
+        }
+    });
+    std::vector<ssegui_input_event> frame_events;
+    while (received + shared.dropped.load () < pushed)
+    {
+        std::this_thread::sleep_for (std::chrono::microseconds (200));
+        shared.take (frame_events);
+        for (auto const& e: frame_events)
+            received += e.count;
+    }
+    window.join ();
+    bad = bad || (!shared.dropped.load () && received != pushed);
+
+    auto frames = batch.batches.load ();
+    std::cout << "input messages:         " << inputs << '\n'
+              << "frames with input:      " << frames << '\n'
+              << "events after merging:   " << batch.events.load () << '\n'
+              << "calls per message:      " << calls << '\n'
+              << "calls per batch:        " << batch_calls << '\n'
+              << "ns per message, calls:  " << double (t1 - t0) / inputs << '\n'
+              << "ns per message, batch:  " << double (t3 - t2) / inputs << '\n'
+              << "concurrent received:    " << received << " of " << pushed
+                                            << " (" << shared.dropped.load () << " dropped)"
+                                            << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
@@ -0,0 +1,180 @@
+/**
+ * @file bench_input_trace.cpp
+ * @brief Input trace ring push cost, loss under contention and the file format round trip
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * Every kind of record is encoded, written to a temporary file and loaded back, and must come
+ * out the same. Then one thread pushes while nothing pops, for the cost of a push and of a drop
+ * on a full ring. Last, a window thread and an input thread push bursts of 64 records each
+ * millisecond - many times a 1000Hz mouse - while a writer pops every 5ms as in the game: each
+ * producer's records must come out in order, and the ones not popped must have been counted as
+ * dropped.
+ * Usage: bench_input_trace [records per producer]
+ */
+
+#include "input_trace.hpp"
+#include "profiler.hpp"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+static bool
+same (trace_record const& a, trace_record const& b)
+{
+    return a.time == b.time && a.kind == b.kind && a.size == b.size
+        && !std::memcmp (a.data, b.data, a.size);
+}
+
+/// Through a temporary file, @returns false if anything changed
+static bool
+round_trip ()
+{
+    std::array<std::uint8_t, 256> keys = {};
+    keys[0x1E] = keys[0x39] = keys[0xFF] = 0x80;
+    std::uint8_t buttons[8] = { 0x80, 0, 0, 0, 0, 0, 0, 0x80 };
+    trace_device_item items[3] = { { 0x1E, 0x80, 1, 2 }, { 0x1E, 0, 3, 4 }, { 4, 5, 6, 7 } };
+
+    std::vector<trace_record> written = {
+        make_trace_message (1, 0x0100, 0x41, -1),
+        make_trace_keyboard (2, keys.data ()),
+        make_trace_mouse (3, -5, 7, 120, buttons),
+        make_trace_device_data (4, false, items, 2),
+        make_trace_device_data (5, true, items + 2, 1),
+        make_trace_dropped (6, 42)
+    };
+
+    std::vector<std::uint8_t> bytes;
+    for (auto const& r: written)
+        trace_encode (r, bytes);
+    std::uint64_t start = 123456789, loaded_start = 0;
+    std::FILE* f = std::tmpfile ();
+    if (!f)
+        return false;
+    std::fwrite (trace_magic, sizeof (trace_magic), 1, f);
+    std::fwrite (&start, sizeof (start), 1, f);
+    std::fwrite (bytes.data (), 1, bytes.size (), f);
+    std::rewind (f);
+    std::vector<trace_record> loaded;
+    bool ok = trace_load (f, loaded, loaded_start);
+    std::fclose (f);
+
+    ok = ok && loaded_start == start && loaded.size () == written.size ();
+    for (std::size_t i = 0; ok && i < loaded.size (); ++i)
+        ok = same (loaded[i], written[i]);
+    if (!ok)
+        return false;
+
+    auto m = read_trace_message (loaded[0]);
+    auto mouse = read_trace_mouse (loaded[2]);
+    bool is_mouse;
+    trace_device_item back[2];
+    ok = m.msg == 0x0100 && m.wParam == 0x41 && m.lParam == -1
+      && trace_key (loaded[1], 0x1E) && trace_key (loaded[1], 0xFF) && !trace_key (loaded[1], 1)
+      && mouse.x == -5 && mouse.y == 7 && mouse.z == 120 && mouse.buttons == 0x81
+      && read_trace_device_data (loaded[3], is_mouse, back) == 2 && !is_mouse
+      && back[1].offset == 0x1E && back[1].time == 3 && back[1].sequence == 4
+      && read_trace_device_data (loaded[4], is_mouse, back) == 1 && is_mouse
+      && back[0].data == 5;
+    return ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    std::uint64_t n = argc > 1 ? std::strtoull (argv[1], nullptr, 10) : 100000;
+    constexpr unsigned slots = 8192;
+
+    bool trip = round_trip ();
+    bool bad = !trip;
+
+    // Uncontended, the first pushes fill the ring, the rest are drops
+    auto ring = std::make_unique<trace_ring<slots>> ();
+    auto t0 = profiler_now ();
+    for (unsigned i = 0; i < slots; ++i)
+        ring->push (make_trace_message (i, 0x0200, i, 0));
+    auto t1 = profiler_now ();
+    for (unsigned i = 0; i < slots; ++i)
+        ring->push (make_trace_message (i, 0x0200, i, 0));
+    auto t2 = profiler_now ();
+    bad = bad || ring->pushed.load () != slots || ring->dropped.load () != slots;
+
+    // The game threads against the writer
+    ring = std::make_unique<trace_ring<slots>> ();
+    std::atomic<unsigned> running { 2 };
+    auto produce = [&ring, &running, n] (unsigned id) {
+        for (std::uint64_t i = 0; i < n; ++i)
+        {
+            ring->push (make_trace_message (profiler_now (), 0x0200 + id, id, std::int64_t (i)));
+            if (i % 64 == 63)
+                std::this_thread::sleep_for (std::chrono::milliseconds (1));
+        }
+        --running;
+    };
+    auto t3 = profiler_now ();
+    std::thread window (produce, 0), input (produce, 1);
+    std::array<std::int64_t, 2> last = { -1, -1 };
+    std::uint64_t popped = 0, misordered = 0;
+    for (bool done = false; !done; )
+    {
+        done = !running.load ();
+        trace_record r;
+        while (ring->pop (r))
+        {
+            auto m = read_trace_message (r);
+            misordered += m.lParam <= last[m.wParam];
+            last[m.wParam] = m.lParam;
+            ++popped;
+        }
+        if (!done)
+            std::this_thread::sleep_for (std::chrono::milliseconds (5));
+    }
+    window.join ();
+    input.join ();
+    auto t4 = profiler_now ();
+    bad = bad || misordered || popped + ring->dropped.load () != 2 * n
+              || popped != ring->pushed.load ();
+
+    std::cout << "round trip:             " << (trip ? "ok" : "failed") << '\n'
+              << "ns per push:            " << double (t1 - t0) / slots << '\n'
+              << "ns per drop:            " << double (t2 - t1) / slots << '\n'
+              << "concurrent pushes:      " << 2 * n << '\n'
+              << "written:                " << popped << '\n'
+              << "dropped:                " << ring->dropped.load () << '\n'
+              << "records per second:     " << 2e9 * n / (t4 - t3) << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
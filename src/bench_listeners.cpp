@@ -0,0 +1,196 @@
+/**
+ * @file bench_listeners.cpp
+ * @brief Stress benchmark of the listener registry
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * Several threads register and remove render listeners as fast as they can, while the main thread
+ * runs a synthetic 360 Hz Present loop dispatching to whatever is registered at the moment.
+ * Each list seen by a dispatch must be a published one, newer or the same as the one before, and
+ * its content as published. In the end, every copy but the current list must have been freed,
+ * and there must be one publish per successful update. Meant for the sanitizers too.
+ * Usage: bench_listeners [seconds] [writer threads]
+ */
+
+#include <sse-gui/sse-gui.h>
+#include "listeners.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+typedef void (SSEGUI_CCONV* render_callback) (void*, unsigned, unsigned);
+
+static std::atomic<std::uint64_t> calls (0);
+
+template<int N>
+static void SSEGUI_CCONV
+callback (void*, unsigned, unsigned)
+{
+    calls.fetch_add (1, std::memory_order_relaxed);
+}
+
+template<int... N>
+static constexpr std::array<render_callback, sizeof... (N)>
+make_callbacks (std::integer_sequence<int, N...>)
+{
+    return {{ &callback<N>... }};
+}
+
+/// Distinct addresses to register, as different plugins would do
+static constexpr auto callbacks = make_callbacks (std::make_integer_sequence<int, 64> ());
+
+//--------------------------------------------------------------------------------------------------
+
+static std::atomic<std::uint64_t> lists_made (0), lists_freed (0), publishes (0);
+
+/// Counts its copies and frees, and carries the number of the publish which made it
+struct counted_list : std::vector<render_callback>
+{
+    std::uint64_t publish = 0;  ///< Zero for the initial, empty one
+    std::uint64_t digest = 0;   ///< Of the content when published
+
+    counted_list () { lists_made.fetch_add (1, std::memory_order_relaxed); }
+    counted_list (counted_list const& l)
+        : std::vector<render_callback> (l), publish (l.publish), digest (l.digest)
+    {
+        lists_made.fetch_add (1, std::memory_order_relaxed);
+    }
+    ~counted_list () { lists_freed.fetch_add (1, std::memory_order_relaxed); }
+    counted_list& operator= (counted_list const&) = delete;
+
+    std::uint64_t
+    content_digest () const
+    {
+        std::uint64_t d = size ();
+        for (auto f: *this)
+            d = d * 0x100000001B3ull ^ reinterpret_cast<std::uintptr_t> (f);
+        return d;
+    }
+};
+
+/// Under the writers lock, on each publish
+static void
+list_changed (counted_list& l)
+{
+    l.publish = publishes.load (std::memory_order_relaxed) + 1;
+    l.digest = l.content_digest ();
+    publishes.store (l.publish, std::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    using namespace std::chrono;
+
+    double seconds = argc > 1 ? std::atof (argv[1]) : 3.0;
+    unsigned writers = argc > 2 ? std::atoi (argv[2])
+                                : std::max (2u, std::thread::hardware_concurrency ());
+
+    listener_registry<render_callback, counted_list> registry;
+    std::atomic<bool> stop (false);
+    std::atomic<std::uint64_t> updates (0);
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < writers; ++i)
+    {
+        threads.emplace_back ([&, i] {
+            std::minstd_rand rng (i + 1);
+            std::uint64_t n = 0;
+            while (!stop.load (std::memory_order_relaxed))
+            {
+                auto f = callbacks[rng () % callbacks.size ()];
+                n += registry.update (f, rng () & 1);
+            }
+            updates.fetch_add (n);
+        });
+    }
+
+    auto const period = duration_cast<steady_clock::duration> (duration<double> (1.0 / 360));
+    auto const end = steady_clock::now () + duration_cast<steady_clock::duration> (
+            duration<double> (seconds));
+
+    std::uint64_t frames = 0, listeners = 0, last_publish = 0, bad_lists = 0;
+    steady_clock::duration worst {}, total {};
+    for (auto next = steady_clock::now (); next < end; next += period)
+    {
+        std::this_thread::sleep_until (next);
+        auto t0 = steady_clock::now ();
+        auto r = registry.read ();
+        for (auto const& f: r)
+        {
+            f (nullptr, 0, 0);
+            ++listeners;
+        }
+        auto dt = steady_clock::now () - t0;
+
+        // Not timed, the list is still held
+        auto const& l = r.list ();
+        std::vector<render_callback> sorted (l.cbegin (), l.cend ());
+        std::sort (sorted.begin (), sorted.end ());
+        bad_lists += l.publish < last_publish
+                  || l.publish > publishes.load (std::memory_order_acquire)
+                  || l.digest != l.content_digest ()
+                  || std::adjacent_find (sorted.cbegin (), sorted.cend ()) != sorted.cend ();
+        last_publish = l.publish;
+        worst = std::max (worst, dt);
+        total += dt;
+        ++frames;
+    }
+
+    stop = true;
+    for (auto& t: threads)
+        t.join ();
+    registry.read (); // Frees what got retired since the last frame
+
+    // The current list is the only one alive, all the others were either rejected or retired
+    auto live = lists_made.load () - lists_freed.load ();
+    bool bad = bad_lists || calls != listeners || live != 1 || publishes != updates;
+
+    auto ns = [] (steady_clock::duration d) { return duration_cast<nanoseconds> (d).count (); };
+    std::cout << "writers:          " << writers << '\n'
+              << "frames:           " << frames << '\n'
+              << "updates:          " << updates << '\n'
+              << "listener calls:   " << listeners << '\n'
+              << "dispatch avg ns:  " << (frames ? ns (total) / frames : 0) << '\n'
+              << "dispatch max ns:  " << ns (worst) << '\n'
+              << "publishes:        " << publishes << '\n'
+              << "lists freed:      " << lists_freed << '\n'
+              << "lists alive:      " << live << '\n'
+              << "bad lists:        " << bad_lists << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
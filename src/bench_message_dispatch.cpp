@@ -0,0 +1,268 @@
+/**
+ * @file bench_message_dispatch.cpp
+ * @brief Window message dispatch through the per message table against calling every listener
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * A message mix as seen while playing with a 1000Hz mouse - per move WM_INPUT, WM_NCHITTEST,
+ * WM_SETCURSOR and WM_MOUSEMOVE, some keys and clicks, timers, application messages and rare
+ * focus and size changes - is replayed through listeners of typical plugins: a UI, hotkeys, a
+ * focus tracker, raw input, IME, explicit application messages and one taking everything. The
+ * former way calls every listener, which filters on its own, and looks the message up in the
+ * list of blocked ones. The table calls only the subscribers and tests one bit. Both must handle
+ * the same messages, and the table must not call a listener for nothing. Last, the UI gets the
+ * top priority and consumes the keyboard and the mouse buttons, as while focused: the listeners
+ * after it must no longer see these, and the calls are made in priority order.
+ * Usage: bench_message_dispatch [messages] [plugins]
+ */
+
+#include "message_dispatch.hpp"
+#include "profiler.hpp"
+
+#include <array>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <climits>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+typedef std::intptr_t (SSEGUI_CCONV* message_callback) (void*, unsigned, std::uintptr_t,
+                                                        std::intptr_t);
+
+struct plugin_info
+{
+    message_filter filter;
+    std::uint64_t calls = 0;
+    std::uint64_t handled = 0;
+    std::uint64_t input = 0;    ///< Keyboard and mouse buttons
+};
+
+typedef ordered_listener<message_callback, plugin_info> message_listener;
+
+/// What a focused UI consumes
+static constexpr int input_classes = SSEGUI_MESSAGE_KEYBOARD | SSEGUI_MESSAGE_MOUSE_BUTTON;
+
+static constexpr unsigned max_plugins = 32;
+static std::array<plugin_info*, max_plugins> infos;
+
+template<int N>
+static std::intptr_t SSEGUI_CCONV
+callback (void*, unsigned msg, std::uintptr_t, std::intptr_t)
+{
+    auto& info = *infos[N];
+    ++info.calls;
+    if (info.filter.accepts (msg))
+        ++info.handled;
+    info.input += !!(message_class (msg) & input_classes);
+    return 0;
+}
+
+template<int... N>
+static constexpr std::array<message_callback, sizeof... (N)>
+make_callbacks (std::integer_sequence<int, N...>)
+{
+    return {{ &callback<N>... }};
+}
+
+static constexpr auto callbacks = make_callbacks (std::make_integer_sequence<int, max_plugins> ());
+
+/// The defaults of settings.json
+static constexpr unsigned blocked_list[] = {
+    0x201, 0x203, 0x204, 0x206, 0x207, 0x209, 0x20B, 0x20D,
+    0x202, 0x205, 0x208, 0x20C, 0x20A, 0x20E, 0x100, 0x101, 0x102
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Message identifier and how many of it per second of play
+struct message_rate
+{
+    unsigned msg;
+    double rate;
+};
+
+static constexpr message_rate mix[] = {
+    { 0x00FF, 1000 },   // WM_INPUT
+    { 0x0084, 1000 },   // WM_NCHITTEST
+    { 0x0020, 1000 },   // WM_SETCURSOR
+    { 0x0200, 1000 },   // WM_MOUSEMOVE
+    { 0x0113, 60 },     // WM_TIMER
+    { 0x0401, 60 },     // WM_USER+1
+    { 0xC123, 30 },     // Registered
+    { 0x0100, 10 },     // WM_KEYDOWN
+    { 0x0102, 10 },     // WM_CHAR
+    { 0x0101, 10 },     // WM_KEYUP
+    { 0x0201, 5 },      // WM_LBUTTONDOWN
+    { 0x0202, 5 },      // WM_LBUTTONUP
+    { 0x020A, 5 },      // WM_MOUSEWHEEL
+    { 0x001C, .1 },     // WM_ACTIVATEAPP
+    { 0x0005, .1 },     // WM_SIZE
+    { 0x0281, .1 },     // WM_IME_SETCONTEXT
+};
+
+/// Filters of typical plugins, repeated for more
+static message_filter
+plugin_filter (unsigned i)
+{
+    switch (i % 8)
+    {
+        case 0: return { SSEGUI_MESSAGE_KEYBOARD | SSEGUI_MESSAGE_MOUSE_BUTTON
+                       | SSEGUI_MESSAGE_MOUSE_MOVE, {} };
+        case 1: return { SSEGUI_MESSAGE_KEYBOARD, {} };
+        case 2: return { SSEGUI_MESSAGE_FOCUS | SSEGUI_MESSAGE_WINDOW, {} };
+        case 3: return { SSEGUI_MESSAGE_RAW_INPUT, {} };
+        case 4: return { SSEGUI_MESSAGE_ALL, {} };
+        case 5: return { SSEGUI_MESSAGE_IME | SSEGUI_MESSAGE_KEYBOARD, {} };
+        case 6: return { 0, { 0x0401, 0xC123 } };
+        default: return { SSEGUI_MESSAGE_FOCUS, { 0x0102 } };
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    int messages = argc > 1 ? std::atoi (argv[1]) : 4000000;
+    unsigned plugins = argc > 2 ? std::min<unsigned> (std::atoi (argv[2]), max_plugins) : 8;
+
+    std::vector<double> weights;
+    for (auto const& m: mix)
+        weights.push_back (m.rate);
+    std::mt19937 rng (42);
+    std::discrete_distribution<unsigned> pick (weights.begin (), weights.end ());
+    std::vector<unsigned> trace (messages);
+    for (auto& m: trace)
+        m = mix[pick (rng)].msg;
+
+    std::vector<plugin_info> before (plugins), after (plugins);
+    listener_registry<message_listener, message_table<message_listener>> registry;
+    for (unsigned i = 0; i < plugins; ++i)
+    {
+        before[i].filter = after[i].filter = plugin_filter (i);
+        std::shared_ptr<plugin_info> info (&after[i], [] (auto) {});
+        registry.insert ({ { callbacks[i], info }, 0, i, false });
+    }
+    registry.modify ([] (auto& list) {
+        list.block ({ std::begin (blocked_list), std::end (blocked_list) });
+        return true;
+    });
+
+    // Every listener, then the blocked list, as window_proc() did
+    for (unsigned i = 0; i < plugins; ++i)
+        infos[i] = &before[i];
+    std::vector<message_callback> all (callbacks.begin (), callbacks.begin () + plugins);
+    std::uint64_t blocked_before = 0;
+    auto t0 = profiler_now ();
+    for (auto msg: trace)
+    {
+        for (auto f: all)
+            f (nullptr, msg, 0, 0);
+        for (auto b: blocked_list)
+            if (b == msg)
+            {
+                ++blocked_before;
+                break;
+            }
+    }
+    auto t1 = profiler_now ();
+
+    for (unsigned i = 0; i < plugins; ++i)
+        infos[i] = &after[i];
+    std::uint64_t blocked_after = 0;
+    auto t2 = profiler_now ();
+    for (auto msg: trace)
+    {
+        auto listeners = registry.read ();
+        listeners.list ().dispatch (msg, [msg] (auto const& l) {
+            l.callback (nullptr, msg, 0, 0);
+            return false;
+        });
+        blocked_after += listeners.list ().blocked (msg);
+    }
+    auto t3 = profiler_now ();
+
+    bool bad = blocked_before != blocked_after;
+    std::uint64_t calls_before = 0, calls_after = 0;
+    for (unsigned i = 0; i < plugins; ++i)
+    {
+        bad = bad || before[i].handled != after[i].handled || after[i].calls != after[i].handled;
+        calls_before += before[i].calls;
+        calls_after += after[i].calls;
+    }
+
+    // The UI on top, consuming, and a check of the order on the way
+    registry.modify ([] (auto& list) {
+        for (auto& l: list)
+        {
+            l.consumes = l.callback == callbacks[0];
+            l.priority = l.consumes ? 10 : -int (l.sequence % 3);
+        }
+        return true;
+    });
+    std::vector<plugin_info> focused (plugins);
+    for (unsigned i = 0; i < plugins; ++i)
+    {
+        focused[i].filter = plugin_filter (i);
+        infos[i] = &focused[i];
+    }
+    std::uint64_t stopped = 0, misordered = 0;
+    auto t4 = profiler_now ();
+    for (auto msg: trace)
+    {
+        auto listeners = registry.read ();
+        auto previous = std::make_pair (INT_MIN, std::uint64_t (0));
+        stopped += listeners.list ().dispatch (msg, [msg, &previous, &misordered] (auto const& l) {
+            auto order = std::make_pair (-l.priority, l.sequence);
+            misordered += order < previous;
+            previous = order;
+            l.callback (nullptr, msg, 0, 0);
+            return l.consumes && (message_class (msg) & input_classes);
+        });
+    }
+    auto t5 = profiler_now ();
+
+    std::uint64_t calls_focused = 0, leaked = 0;
+    for (unsigned i = 0; i < plugins; ++i)
+    {
+        calls_focused += focused[i].calls;
+        leaked += i % 8 ? focused[i].input : 0;
+    }
+    bad = bad || misordered || leaked || stopped != focused[0].input;
+
+    std::cout << "messages:               " << messages << '\n'
+              << "plugins:                " << plugins << '\n'
+              << "blocked:                " << blocked_after << '\n'
+              << "calls every listener:   " << calls_before << '\n'
+              << "calls by table:         " << calls_after << '\n'
+              << "ns per message before:  " << double (t1 - t0) / messages << '\n'
+              << "ns per message table:   " << double (t3 - t2) / messages << '\n'
+              << "stopped by the UI:      " << stopped << '\n'
+              << "calls while focused:    " << calls_focused << '\n'
+              << "ns per message focused: " << double (t5 - t4) / messages << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
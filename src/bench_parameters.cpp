@@ -0,0 +1,167 @@
+/**
+ * @file bench_parameters.cpp
+ * @brief Parameter reads by name against by handle, and a check that concurrent writes never tear
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * By name is the former string comparison chain, run per call with a std::string made of the C
+ * string, as #ssegui_parameter() did. By handle is a single slot load. Meanwhile, one writer keeps
+ * publishing values whose halves must match, while another thread keeps interning new names.
+ * Usage: bench_parameters [reads]
+ */
+
+#include "parameters.hpp"
+#include "profiler.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+static void* device = &device;
+static void* context = &context;
+static void* chain = &chain;
+static void* window = &window;
+static void* rtv = &rtv;
+static unsigned size[2] = { 1920, 1080 };
+
+#if defined(__GNUC__)
+#   define NOINLINE __attribute__ ((noinline))
+#else
+#   define NOINLINE __declspec (noinline)
+#endif
+
+/// As render_parameter() was
+NOINLINE static bool
+by_name (std::string const& name, void* value)
+{
+    if (name == "ID3D11Device")
+        *((void**) value) = device;
+    else if (name == "ID3D11DeviceContext")
+        *((void**) value) = context;
+    else if (name == "IDXGISwapChain")
+        *((void**) value) = chain;
+    else if (name == "window")
+        *((void**) value) = window;
+    else if (name == "BackBufferRTV")
+        *((void**) value) = rtv;
+    else if (name == "BackBufferSize")
+        std::copy_n (size, 2, (unsigned*) value);
+    else
+        return false;
+    return true;
+}
+
+static parameter_registry<256> registry;
+
+NOINLINE static bool
+by_handle (int handle, void* value)
+{
+    std::uint64_t bits;
+    if (!registry.get (handle, bits))
+        return false;
+    *((void**) value) = (void*) std::uintptr_t (bits);
+    return true;
+}
+
+int
+main (int argc, char* argv[])
+{
+    int reads = argc > 1 ? std::atoi (argv[1]) : 10000000;
+
+    registry.set_pointer (param_device, device);
+    registry.set_pointer (param_back_buffer_rtv, rtv);
+
+    bool bad = registry.intern ("BackBufferRTV", 0) != param_back_buffer_rtv
+            || registry.intern ("BackBufferRTV", parameter_real) != 0
+            || registry.intern ("Nope", 0) != 0;
+
+    // The worst realistic case by name: the fifth comparison
+    const char* name = "BackBufferRTV";
+    void* v = nullptr;
+    std::uintptr_t sum = 0;
+    auto t0 = profiler_now ();
+    for (int i = 0; i < reads; ++i)
+    {
+        by_name (name, &v);
+        sum += std::uintptr_t (v);
+    }
+    auto name_ns = double (profiler_now () - t0) / reads;
+
+    int h = registry.intern (name, parameter_pointer);
+    t0 = profiler_now ();
+    for (int i = 0; i < reads; ++i)
+    {
+        by_handle (h, &v);
+        sum -= std::uintptr_t (v);
+    }
+    auto handle_ns = double (profiler_now () - t0) / reads;
+    bad = bad || sum != 0;
+
+    // Concurrent: one writer, one interning, this thread reading
+    int shared = registry.intern ("Bench.Shared", parameter_integer);
+    std::atomic<bool> done (false);
+    std::thread writer ([&] {
+        for (std::uint64_t i = 1; !done.load (std::memory_order_relaxed); ++i)
+            registry.set_integer (shared, std::int64_t ((i << 32) | (i & 0xffffffff)));
+    });
+    std::atomic<int> interned (0);
+    std::thread interner ([&] {
+        for (int i = 0; i < 200; ++i)
+            if (registry.intern ("Bench.Name" + std::to_string (i), parameter_real))
+                interned.fetch_add (1);
+    });
+
+    unsigned torn = 0, seen = 0;
+    for (int i = 0; i < reads; ++i)
+    {
+        std::uint64_t bits;
+        if (!registry.get (shared, bits))
+            continue;
+        ++seen;
+        torn += (bits >> 32) != (bits & 0xffffffff);
+        by_handle (h, &v);
+        torn += v != rtv;
+    }
+    done = true;
+    writer.join ();
+    interner.join ();
+
+    // Handle zero, 8 built-ins, "Bench.Shared" and the new ones
+    bad = bad || torn || interned != 200 || registry.size () != 210
+            || registry.intern ("Bench.Name199", 0) != 209;
+
+    std::cout << "by name ns per read:    " << name_ns << '\n'
+              << "by handle ns per read:  " << handle_ns << '\n'
+              << "concurrent reads:       " << seen << '\n'
+              << "torn reads:             " << torn << '\n'
+              << "names interned:         " << registry.size () - 1 << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,222 @@
+/**
+ * @file bench_pipeline_state.cpp
+ * @brief Count of the context state calls, per listener versus shared save/restore
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * A mock context counts each Get/Set call and hands out references to a single "game" object.
+ * Each synthetic plugin binds its own object to some of the slots, as a real overlay would before
+ * drawing. Per frame, either each plugin saves and restores the state itself, or the frame is
+ * wrapped once as chain_present() does for #SSEGUI_RENDER_SHARED_STATE listeners. After each frame
+ * the game state must be back and all references released. The shared count must not depend on
+ * the count of plugins.
+ * Usage: bench_pipeline_state [max plugins] [frames]
+ */
+
+#include "pipeline_state.hpp"
+#include "profiler.hpp"
+
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+struct mock_object
+{
+    int references = 1;
+    void AddRef () { ++references; }
+    void Release () { --references; }
+};
+
+struct mock_viewport { float x, y, width, height, min_depth, max_depth; };
+struct mock_rect { long left, top, right, bottom; };
+
+/// Only what pipeline_state and the plugins use
+struct mock_context
+{
+    unsigned calls = 0;
+    mock_object* game;      ///< Bound to everything by the game
+    mock_object* bound;     ///< The last input layout set
+
+    explicit mock_context (mock_object* g) : game (g), bound (g) {}
+
+    template<class T> void
+    get (T** p, unsigned n = 1)
+    {
+        for (unsigned i = 0; i < n; ++i)
+            game->AddRef (), p[i] = game;
+    }
+
+    void IAGetInputLayout (mock_object** p) { ++calls; get (p); }
+    void IAGetVertexBuffers (unsigned, unsigned n, mock_object** p, unsigned*, unsigned*)
+        { ++calls; get (p, n); }
+    void IAGetIndexBuffer (mock_object** p, int*, unsigned*) { ++calls; get (p); }
+    void IAGetPrimitiveTopology (int*) { ++calls; }
+    void VSGetShader (mock_object** p, mock_object**, unsigned* n) { ++calls; get (p); *n = 0; }
+    void PSGetShader (mock_object** p, mock_object**, unsigned* n) { ++calls; get (p); *n = 0; }
+    void GSGetShader (mock_object** p, mock_object**, unsigned* n) { ++calls; get (p); *n = 0; }
+    void HSGetShader (mock_object** p, mock_object**, unsigned* n) { ++calls; get (p); *n = 0; }
+    void DSGetShader (mock_object** p, mock_object**, unsigned* n) { ++calls; get (p); *n = 0; }
+    void VSGetConstantBuffers (unsigned, unsigned n, mock_object** p) { ++calls; get (p, n); }
+    void PSGetConstantBuffers (unsigned, unsigned n, mock_object** p) { ++calls; get (p, n); }
+    void PSGetShaderResources (unsigned, unsigned n, mock_object** p) { ++calls; get (p, n); }
+    void PSGetSamplers (unsigned, unsigned n, mock_object** p) { ++calls; get (p, n); }
+    void RSGetState (mock_object** p) { ++calls; get (p); }
+    void RSGetViewports (unsigned* n, mock_viewport*) { ++calls; *n = 1; }
+    void RSGetScissorRects (unsigned* n, mock_rect*) { ++calls; *n = 0; }
+    void OMGetRenderTargets (unsigned n, mock_object** p, mock_object** d)
+        { ++calls; get (p, n); get (d); }
+    void OMGetBlendState (mock_object** p, float*, unsigned*) { ++calls; get (p); }
+    void OMGetDepthStencilState (mock_object** p, unsigned*) { ++calls; get (p); }
+
+    void IASetInputLayout (mock_object* p) { ++calls; bound = p; }
+    void IASetVertexBuffers (unsigned, unsigned, mock_object* const*, unsigned const*,
+            unsigned const*) { ++calls; }
+    void IASetIndexBuffer (mock_object*, int, unsigned) { ++calls; }
+    void IASetPrimitiveTopology (int) { ++calls; }
+    void VSSetShader (mock_object*, mock_object* const*, unsigned) { ++calls; }
+    void PSSetShader (mock_object*, mock_object* const*, unsigned) { ++calls; }
+    void GSSetShader (mock_object*, mock_object* const*, unsigned) { ++calls; }
+    void HSSetShader (mock_object*, mock_object* const*, unsigned) { ++calls; }
+    void DSSetShader (mock_object*, mock_object* const*, unsigned) { ++calls; }
+    void VSSetConstantBuffers (unsigned, unsigned, mock_object* const*) { ++calls; }
+    void PSSetConstantBuffers (unsigned, unsigned, mock_object* const*) { ++calls; }
+    void PSSetShaderResources (unsigned, unsigned, mock_object* const*) { ++calls; }
+    void PSSetSamplers (unsigned, unsigned, mock_object* const*) { ++calls; }
+    void RSSetState (mock_object*) { ++calls; }
+    void RSSetViewports (unsigned, mock_viewport const*) { ++calls; }
+    void RSSetScissorRects (unsigned, mock_rect const*) { ++calls; }
+    void OMSetRenderTargets (unsigned, mock_object* const*, mock_object*) { ++calls; }
+    void OMSetBlendState (mock_object*, float const*, unsigned) { ++calls; }
+    void OMSetDepthStencilState (mock_object*, unsigned) { ++calls; }
+};
+
+struct mock_traits
+{
+    typedef mock_context context;
+    typedef mock_object buffer;
+    typedef mock_object input_layout;
+    typedef mock_object vertex_shader;
+    typedef mock_object pixel_shader;
+    typedef mock_object geometry_shader;
+    typedef mock_object hull_shader;
+    typedef mock_object domain_shader;
+    typedef mock_object class_instance;
+    typedef mock_object shader_resource_view;
+    typedef mock_object sampler_state;
+    typedef mock_object rasterizer_state;
+    typedef mock_object render_target_view;
+    typedef mock_object depth_stencil_view;
+    typedef mock_object blend_state;
+    typedef mock_object depth_stencil_state;
+    typedef mock_viewport viewport;
+    typedef mock_rect rect;
+    typedef int format;
+    typedef int topology;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// What a typical overlay binds before its draw calls
+static void
+draw (mock_context* c, mock_object* own)
+{
+    c->IASetInputLayout (own);
+    c->VSSetShader (own, nullptr, 0);
+    c->PSSetShader (own, nullptr, 0);
+    c->OMSetRenderTargets (1, &own, nullptr);
+}
+
+/// State calls per frame, returns zero if the game state was not left as found
+static unsigned
+frame (mock_context& c, std::vector<mock_object>& plugins, bool shared)
+{
+    pipeline_state<mock_traits> state;
+    auto references = c.game->references;
+    c.calls = 0;
+
+    if (shared)
+        state.capture (&c);
+    for (auto& p: plugins)
+    {
+        if (!shared)
+            state.capture (&c);
+        draw (&c, &p);
+        if (!shared)
+            state.restore (&c);
+    }
+    state.restore (&c);
+
+    bool ok = c.bound == c.game && c.game->references == references;
+    return ok ? c.calls : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    int max_plugins = argc > 1 ? std::atoi (argv[1]) : 16;
+    int frames = argc > 2 ? std::atoi (argv[2]) : 10000;
+
+    mock_object game;
+    mock_context context (&game);
+    draw (&context, &game);
+    unsigned draws = context.calls;
+
+    int bad = 0;
+    unsigned shared_calls = 0;
+
+    std::cout << "plugins   own calls   shared calls   own ns   shared ns\n";
+    for (int n = 1; n <= max_plugins; n *= 2)
+    {
+        std::vector<mock_object> plugins (n);
+        unsigned calls[2];
+        std::uint64_t ns[2];
+        for (int shared = 0; shared < 2; ++shared)
+        {
+            auto t0 = profiler_now ();
+            for (int f = 0; f < frames; ++f)
+                if (!(calls[shared] = frame (context, plugins, shared)))
+                    ++bad;
+            ns[shared] = (profiler_now () - t0) / frames;
+        }
+
+        // Without the plugins own draw calls, the shared overhead is constant
+        auto overhead = calls[1] - n * draws;
+        if (n > 1 && overhead != shared_calls)
+            ++bad;
+        shared_calls = overhead;
+
+        std::cout << n << "\t  " << calls[0] << "\t      " << calls[1]
+                  << "\t     " << ns[0] << "\t      " << ns[1] << '\n';
+    }
+
+    std::cout << "shared state calls:  " << shared_calls << '\n'
+              << "failed checks:       " << bad << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,157 @@
+/**
+ * @file bench_present_bypass.cpp
+ * @brief Per frame cost of the Present hook with zero, one and many listeners, and without it
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * The game calls Present through the swap chain virtual table. Hooked, that lands in a stand-in
+ * of chain_present() doing the listener independent work (frame pacing timestamps, registry read,
+ * frame counter, idle check) and calling the original through a trampoline pointer. Unhooked, the
+ * game calls the original directly - what sync_hooks() does with nothing subscribed.
+ * Usage: bench_present_bypass [frames] [listeners]
+ */
+
+#include "listeners.hpp"
+#include "frame_pacing.hpp"
+#include "profiler.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+typedef long (*present_t) (void*, unsigned, unsigned);
+typedef void (*render_callback) (void*, unsigned, unsigned);
+
+static volatile unsigned presented = 0;
+static volatile unsigned rendered = 0;
+
+#if defined(__GNUC__)
+#   define NOINLINE __attribute__ ((noinline))
+#else
+#   define NOINLINE __declspec (noinline)
+#endif
+
+/// The driver, taken as doing nothing
+NOINLINE static long
+present_orig (void*, unsigned, unsigned)
+{
+    presented = presented + 1;
+    return 0;
+}
+
+NOINLINE static void
+render (void*, unsigned, unsigned)
+{
+    rendered = rendered + 1;
+}
+
+template<int N>
+NOINLINE static void
+render_n (void* c, unsigned i, unsigned f)
+{
+    render (c, i + N, f);
+}
+
+static std::atomic<bool> profiling (false);
+static std::atomic<std::uint64_t> frame (0);
+static listener_registry<render_callback> registry;
+static frame_pacing pacing;
+static present_t volatile trampoline = &present_orig;
+static unsigned idle_frames = 0;
+
+/// What chain_present() does around the listeners
+NOINLINE static long
+present_hook (void* chain, unsigned interval, unsigned flags)
+{
+    pacing.enter (profiler_now ());
+    bool busy = profiling.load (std::memory_order_relaxed);
+    {
+        auto listeners = registry.read ();
+        busy = busy || !listeners.empty ();
+        for (auto l: listeners)
+            l (chain, interval, flags);
+    }
+    frame.fetch_add (1, std::memory_order_release);
+    if (busy)
+        idle_frames = 0;
+    else
+        ++idle_frames;
+    pacing.call (profiler_now ());
+    long r = trampoline (chain, interval, flags);
+    pacing.exit (profiler_now ());
+    return r;
+}
+
+/// The game side, @returns nanoseconds per frame
+static double
+game_loop (present_t volatile& vtable, int frames)
+{
+    auto t0 = profiler_now ();
+    for (int f = 0; f < frames; ++f)
+        vtable (nullptr, 1, 0);
+    return double (profiler_now () - t0) / frames;
+}
+
+int
+main (int argc, char* argv[])
+{
+    int frames = argc > 1 ? std::atoi (argv[1]) : 2000000;
+    int many = argc > 2 ? std::atoi (argv[2]) : 8;
+
+    render_callback callbacks[] = {
+        &render_n<0>, &render_n<1>, &render_n<2>, &render_n<3>,
+        &render_n<4>, &render_n<5>, &render_n<6>, &render_n<7>,
+        &render_n<8>, &render_n<9>, &render_n<10>, &render_n<11>,
+        &render_n<12>, &render_n<13>, &render_n<14>, &render_n<15>,
+    };
+    many = std::max (1, std::min (many, int (sizeof (callbacks) / sizeof (*callbacks))));
+
+    present_t volatile vtable = &present_orig;
+    game_loop (vtable, frames / 10);
+    auto bypass_ns = game_loop (vtable, frames);
+
+    vtable = &present_hook;
+    auto zero_ns = game_loop (vtable, frames);
+    auto idle = idle_frames; // Each of them would unhook after a while
+    registry.update (callbacks[0], false);
+    auto one_ns = game_loop (vtable, frames);
+    for (int i = 1; i < many; ++i)
+        registry.update (callbacks[i], false);
+    auto many_ns = game_loop (vtable, frames);
+
+    bool bad = idle != unsigned (frames) || idle_frames
+            || presented != unsigned (frames / 10 + 4 * frames)
+            || rendered != unsigned (frames + many * frames);
+
+    std::cout << "unhooked ns per frame:      " << bypass_ns << '\n'
+              << "hooked, 0 listeners:        " << zero_ns << '\n'
+              << "hooked, 1 listener:         " << one_ns << '\n'
+              << "hooked, " << many << " listeners:        " << many_ns << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,179 @@
+/**
+ * @file bench_quad_batch.cpp
+ * @brief Checks and benchmark of the quad sorting, batching and upload ring
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * Several plugins queue their quads in small chunks each frame - text, icons and solid panels over
+ * a few layers - and the whole frame is sorted and flushed into a fake vertex buffer. The draws
+ * must come out in the stable layer/texture/flags order, be the fewest possible, and never write
+ * over the part of the ring used since the last discard.
+ * Usage: bench_quad_batch [frames] [quads per frame] [ring capacity in quads]
+ */
+
+#include "quad_batch.hpp"
+#include "profiler.hpp"
+
+#include <map>
+#include <tuple>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Stands for the dynamic vertex buffer and the device context
+
+struct fake_backend
+{
+    std::vector<quad_vertex> buffer;
+    std::uint32_t since_discard = 0;    ///< Quads written after the last discard
+    std::vector<std::uint32_t> drawn;   ///< Quad indices, as encoded into u0
+    std::vector<quad_draw> draws;
+    int bad_ring = 0;
+
+    quad_vertex*
+    map (bool discard)
+    {
+        if (discard)
+            since_discard = 0;
+        return buffer.data ();
+    }
+
+    void unmap () {}
+
+    void
+    draw (quad_draw const& d, std::uint32_t ring_first)
+    {
+        bad_ring += ring_first < since_discard || ring_first + d.count > buffer.size () / 4;
+        since_discard = ring_first + d.count;
+        for (std::uint32_t i = 0; i < d.count; ++i)
+            drawn.push_back (std::uint32_t (buffer[(ring_first + i) * 4].u));
+        draws.push_back (d);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    int frames = argc > 1 ? std::atoi (argv[1]) : 200;
+    int per_frame = argc > 2 ? std::atoi (argv[2]) : 100000;
+    std::uint32_t capacity = argc > 3 ? std::atoi (argv[3]) : 16384;
+
+    // Textures are just distinct addresses here
+    static char textures[32];
+    std::mt19937 rng (42);
+    std::uniform_int_distribution<int> layers (-2, 2), pick (0, 31), chunk (16, 256), kind (0, 9);
+
+    quad_ring ring (capacity);
+    fake_backend backend;
+    backend.buffer.resize (capacity * 4);
+    quad_batch batch;
+    std::vector<ssegui_quad> frame (per_frame);
+
+    int bad_order = 0, bad_draws = 0;
+    std::uint64_t sort_ns = 0, flush_ns = 0, unbatched = 0, batched = 0;
+
+    for (int f = 0; f < frames; ++f)
+    {
+        // Each plugin submits a run of quads on one layer, mostly of one texture (a glyph run)
+        for (int i = 0; i < per_frame; )
+        {
+            int layer = layers (rng), n = std::min (chunk (rng), per_frame - i);
+            void* texture = kind (rng) < 2 ? nullptr : &textures[pick (rng)];
+            for (int j = 0; j < n; ++j, ++i)
+            {
+                auto& q = frame[i];
+                q = { 0, 0, 1, 1, float (i), 0, 0, 0, 0xffffffff, layer, texture, 0 };
+                if (texture && kind (rng) == 0)
+                    q.texture = &textures[pick (rng)]; // An icon in the middle of the text
+                q.flags = q.texture == &textures[0] ? SSEGUI_QUAD_SDF : 0;
+            }
+        }
+        for (int i = 0; i < per_frame; ++i)
+            unbatched += !i || frame[i].texture != frame[i-1].texture
+                            || frame[i].layer != frame[i-1].layer;
+
+        batch.clear ();
+        auto t0 = profiler_now ();
+        for (int i = 0, n; i < per_frame; i += n)
+        {
+            n = std::min (64, per_frame - i);
+            batch.add (&frame[i], n);
+        }
+        batch.sort ();
+        auto t1 = profiler_now ();
+        backend.drawn.clear ();
+        backend.draws.clear ();
+        batch.flush (ring, backend);
+        auto t2 = profiler_now ();
+        sort_ns += t1 - t0;
+        flush_ns += t2 - t1;
+        batched += backend.draws.size ();
+
+        // The expected order and the fewest draws: one per distinct state, plus the ring wraps
+        std::map<void*, int> first_use;
+        for (auto const& q: frame)
+            first_use.emplace (q.texture, int (first_use.size ()));
+        auto key = [&] (std::uint32_t i) {
+            return std::make_tuple (frame[i].layer, first_use[frame[i].texture], frame[i].flags);
+        };
+        std::vector<std::uint32_t> expected (per_frame);
+        for (int i = 0; i < per_frame; ++i)
+            expected[i] = i;
+        std::stable_sort (expected.begin (), expected.end (),
+                [&] (auto a, auto b) { return key (a) < key (b); });
+        bad_order += expected != backend.drawn;
+
+        std::size_t states = 1;
+        for (int i = 1; i < per_frame; ++i)
+            states += key (expected[i]) != key (expected[i-1]);
+        std::size_t wraps = (per_frame + capacity - 1) / capacity - 1;
+        bad_draws += backend.draws.size () > states + wraps + 1; // Plus one for the ring start
+        for (auto const& d: backend.draws)
+            for (auto i = d.first; i < d.first + d.count; ++i)
+                bad_draws += std::make_tuple (frame[expected[i]].layer,
+                        frame[expected[i]].texture, frame[expected[i]].flags)
+                    != std::make_tuple (d.layer, d.texture, d.flags);
+    }
+
+    int bad = bad_order + bad_draws + backend.bad_ring;
+    auto quads = std::uint64_t (frames) * per_frame;
+
+    std::cout << "quads per frame:        " << per_frame << '\n'
+              << "draws per frame:        " << double (batched) / frames << '\n'
+              << "unbatched draws:        " << double (unbatched) / frames << '\n'
+              << "add+sort us per frame:  " << sort_ns / frames / 1000 << '\n'
+              << "flush us per frame:     " << flush_ns / frames / 1000 << '\n'
+              << "ns per quad:            " << double (sort_ns + flush_ns) / quads << '\n'
+              << "bad order/draws/ring    " << bad_order << '/' << bad_draws << '/'
+              << backend.bad_ring << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
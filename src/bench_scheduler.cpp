@@ -0,0 +1,146 @@
+/**
+ * @file bench_scheduler.cpp
+ * @brief Frame budget scheduler checks on fake listener costs, and its overhead
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * A 144Hz frame loop on a simulated clock calls listeners whose cost per call is made up:
+ * - 3ms against a 1ms budget must run every third frame;
+ * - the same, after a listener leaving 3ms unused, must run every frame on that slack;
+ * - 100ms against 1ms, with a 50ms minimum interval, must never wait longer than that;
+ * - 0.5ms against 1ms, with a 100ms first call and another one later, must skip only a few
+ *   frames and be back to every frame.
+ * Then the cost of an admit and account pair, on the real clock.
+ * Usage: bench_scheduler [frames]
+ */
+
+#include "scheduler.hpp"
+#include "profiler.hpp"
+
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <functional>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Simulated frame interval, 144Hz
+static constexpr std::uint64_t frame_ns = 1000000000 / 144;
+
+struct fake_listener
+{
+    budget_state state;
+    std::function<std::uint64_t (std::uint64_t)> cost;   ///< Nanoseconds of the Nth call
+    std::uint64_t calls = 0;
+    std::uint64_t last_call = 0;    ///< Simulated time
+    std::uint64_t max_gap = 0;      ///< Between two calls, nanoseconds
+
+    fake_listener (std::uint64_t budget, std::uint64_t min_interval,
+                   std::function<std::uint64_t (std::uint64_t)> c)
+        : cost (std::move (c))
+    {
+        state.set (budget, min_interval);
+    }
+};
+
+/// Dispatches @param frames in a row to @param listeners, in their order
+static void
+run (std::vector<fake_listener*> const& listeners, std::uint64_t frames)
+{
+    frame_scheduler scheduler;
+    std::uint64_t now = frame_ns;
+    for (std::uint64_t f = 0; f < frames; ++f, now += frame_ns)
+    {
+        scheduler.begin_frame ();
+        for (auto l: listeners)
+        {
+            if (!scheduler.admit (l->state, now))
+                continue;
+            if (l->calls)
+                l->max_gap = std::max (l->max_gap, now - l->last_call);
+            l->last_call = now;
+            scheduler.account (l->state, l->cost (l->calls++), now);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    std::uint64_t frames = argc > 1 ? std::strtoull (argv[1], nullptr, 10) : 3000;
+    constexpr std::uint64_t ms = 1000000;
+    auto constant = [] (std::uint64_t ns) { return [ns] (std::uint64_t) { return ns; }; };
+
+    fake_listener over (1 * ms, 0, constant (3 * ms));
+    run ({ &over }, frames);
+    double ratio = double (frames) / over.calls;
+    bool period_bad = over.state.period () != 3 || ratio < 2.9 || ratio > 3.1;
+
+    fake_listener light (4 * ms, 0, constant (1 * ms));
+    fake_listener heavy (1 * ms, 0, constant (3 * ms));
+    run ({ &light, &heavy }, frames);
+    bool slack_bad = light.calls != frames || heavy.calls != frames;
+
+    fake_listener slow (1 * ms, 50 * ms, constant (100 * ms));
+    run ({ &slow }, frames);
+    bool rate_bad = slow.max_gap > 50 * ms + frame_ns || slow.state.period () != 100;
+
+    fake_listener spiky (1 * ms, 0, [] (std::uint64_t call) {
+        return call == 0 || call == 1000 ? 100 * ms : ms / 2;
+    });
+    run ({ &spiky }, frames);
+    auto skipped = spiky.state.skips.load ();
+    bool spike_bad = skipped > 8 || spiky.state.period () != 1 || spiky.calls + skipped != frames;
+
+    // Overhead, on a listener which gets skipped every other frame
+    budget_state s;
+    s.set (1 * ms, 0);
+    frame_scheduler scheduler;
+    constexpr unsigned n = 1000000;
+    auto t0 = profiler_now ();
+    for (unsigned i = 0; i < n; ++i)
+    {
+        scheduler.begin_frame ();
+        if (scheduler.admit (s, i * frame_ns))
+            scheduler.account (s, 2 * ms, i * frame_ns);
+    }
+    auto t1 = profiler_now ();
+
+    bool bad = period_bad || slack_bad || rate_bad || spike_bad;
+
+    std::cout << "frames:                 " << frames << '\n'
+              << "over budget period:     " << over.state.period () << " (" << ratio
+                                            << (period_bad ? ") failed\n" : ") ok\n")
+              << "on slack calls:         " << heavy.calls
+                                            << (slack_bad ? " failed\n" : " ok\n")
+              << "min rate max gap ms:    " << slow.max_gap * 1e-6
+                                            << (rate_bad ? " failed\n" : " ok\n")
+              << "skipped on spikes:      " << skipped << (spike_bad ? " failed\n" : " ok\n")
+              << "ns per admit:           " << double (t1 - t0) / n << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,152 @@
+/**
+ * @file bench_upload_ring.cpp
+ * @brief Checks and benchmark of the frame fenced upload ring against a fake GPU
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Benchmarks
+ *
+ * @details
+ * Each frame several plugins upload vertices and constants of random sizes and alignments into the
+ * ring, which stands for the dynamic buffer. The fake GPU "reads" each frame a random number of
+ * frames later, in order, checking that nothing it reads got overwritten meanwhile, and signals
+ * the fence. Once in a while it stalls for long, so the ring must run full and refuse instead of
+ * overwriting, then recover.
+ * Usage: bench_upload_ring [frames] [uploads per frame] [ring capacity]
+ */
+
+#include "upload_ring.hpp"
+#include "profiler.hpp"
+
+#include <deque>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+/// What the GPU will read of a frame, the fence being the frame number
+struct gpu_frame
+{
+    std::uint64_t fence;
+    int latency;
+    struct range { std::size_t offset, size; unsigned char pattern; };
+    std::vector<range> reads;
+};
+
+int
+main (int argc, char* argv[])
+{
+    int frames = argc > 1 ? std::atoi (argv[1]) : 20000;
+    int per_frame = argc > 2 ? std::atoi (argv[2]) : 64;
+    std::size_t capacity = argc > 3 ? std::atoi (argv[3]) : 1 << 20;
+
+    upload_ring<std::uint64_t> ring (capacity);
+    std::vector<unsigned char> buffer (capacity);
+    std::deque<gpu_frame> gpu;
+    std::uint64_t signaled = 0;     ///< Fences up to it have passed
+
+    std::mt19937 rng (42);
+    std::uniform_int_distribution<std::size_t> sizes (16, 4096), shifts (0, 8);
+    std::uniform_int_distribution<int> latencies (0, 3), stalls (0, 999);
+
+    int bad_align = 0, bad_bounds = 0, bad_data = 0, stalled = 0, recovered = 0;
+    std::uint64_t refused_during_stall = 0;
+
+    for (int f = 1; f <= frames; ++f)
+    {
+        // The GPU consumes the frames in order, each when its latency is up
+        for (auto& g: gpu)
+            g.latency--;
+        while (!gpu.empty () && gpu.front ().latency < 0)
+        {
+            for (auto const& r: gpu.front ().reads)
+                for (std::size_t i = 0; i < r.size; ++i)
+                    bad_data += buffer[r.offset + i] != r.pattern;
+            signaled = gpu.front ().fence;
+            gpu.pop_front ();
+        }
+        ring.retire ([signaled] (std::uint64_t fence) { return fence <= signaled; });
+
+        gpu_frame frame = { std::uint64_t (f), latencies (rng), {} };
+        if (!stalled && !stalls (rng))
+        {
+            frame.latency = 200; // E.g. a shader compilation hitch
+            stalled = f;
+        }
+
+        auto failures = ring.failures.load ();
+        for (int i = 0; i < per_frame; ++i)
+        {
+            std::size_t size = sizes (rng), alignment = std::size_t (1) << shifts (rng), offset;
+            if (!ring.allocate (size, alignment, offset))
+                continue;
+            bad_align += offset % alignment != 0;
+            bad_bounds += offset + size > capacity;
+            auto pattern = std::uint8_t (f * 31 + i);
+            std::memset (&buffer[offset], pattern, size);
+            frame.reads.push_back ({ offset, size, pattern });
+        }
+        if (stalled && ring.failures.load () != failures)
+            refused_during_stall += ring.failures.load () - failures;
+        if (stalled && ring.failures.load () == failures && f > stalled + 210)
+        {
+            stalled = 0;
+            ++recovered;
+        }
+
+        ring.end_frame (std::uint64_t (f));
+        gpu.push_back (std::move (frame));
+    }
+
+    // Allocation alone, with an always idle GPU
+    upload_ring<int> fast (capacity);
+    auto t0 = profiler_now ();
+    for (int f = 0; f < frames; ++f)
+    {
+        fast.retire ([] (int) { return true; });
+        for (int i = 0; i < per_frame; ++i)
+        {
+            std::size_t offset;
+            fast.allocate (16 + (i & 63) * 16, 16, offset);
+        }
+        fast.end_frame (f);
+    }
+    auto ns = profiler_now () - t0;
+
+    int bad = bad_align + bad_bounds + bad_data;
+    auto attempts = std::uint64_t (frames) * per_frame;
+
+    std::cout << "uploads:                " << ring.allocations.load () << '/' << attempts << '\n'
+              << "megabytes:              " << ring.bytes.load () / (1 << 20) << '\n'
+              << "wraps:                  " << ring.wraps.load () << '\n'
+              << "refused (GPU stalls):   " << refused_during_stall << '\n'
+              << "refused otherwise:      " << ring.failures.load () - refused_during_stall << '\n'
+              << "stalls recovered:       " << recovered << '\n'
+              << "ns per allocation:      " << double (ns) / attempts << '\n'
+              << "bad align/bounds/data   " << bad_align << '/' << bad_bounds << '/'
+              << bad_data << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,332 @@
+/**
+ * @file capture.cpp
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Public API
+ *
+ * @details
+ * Screenshots and short captures of the back buffer as presented, overlays included. The render
+ * thread only copies into staging textures and reads them back frames later, without waiting the
+ * GPU. Encoding and writing the files is done by a worker. @see capture_ring.hpp
+ */
+
+#include <sse-gui/sse-gui.h>
+#include <nlohmann/json.hpp>
+#include <gsl/gsl_util>
+
+#include <utils/winutils.hpp>
+#include "capture_ring.hpp"
+#include "histogram.hpp"
+#include "profiler.hpp"
+#include "deferred.hpp"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <fstream>
+
+#include <windows.h>
+#include <d3d11.h>
+
+//--------------------------------------------------------------------------------------------------
+
+using namespace std::string_literals;
+
+/// Opened from within skse.cpp
+extern std::ofstream& log ();
+
+/// Defined in sse-gui.cpp
+extern thread_local std::string ssegui_error;
+
+/// Defined in render.cpp
+extern void wake_present ();
+
+//--------------------------------------------------------------------------------------------------
+
+struct d3d11_capture_backend
+{
+    IDXGISwapChain* chain = nullptr;
+    ID3D11Device* device = nullptr;
+    ID3D11DeviceContext* context = nullptr;
+    std::array<ID3D11Texture2D*, 3> staging = {};
+    ID3D11Texture2D* resolved = nullptr;        ///< Of multisampled back buffers
+
+    static bool
+    supported (DXGI_FORMAT f, bool& bgra)
+    {
+        switch (f)
+        {
+            case DXGI_FORMAT_R8G8B8A8_UNORM:
+            case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+                bgra = false;
+                return true;
+            case DXGI_FORMAT_B8G8R8A8_UNORM:
+            case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            case DXGI_FORMAT_B8G8R8X8_UNORM:
+            case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+                bgra = true;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /// Re-creates @param t if it does not match @param desc
+    bool
+    fit (ID3D11Texture2D*& t, D3D11_TEXTURE2D_DESC const& desc)
+    {
+        if (t)
+        {
+            D3D11_TEXTURE2D_DESC d;
+            t->GetDesc (&d);
+            if (d.Width == desc.Width && d.Height == desc.Height && d.Format == desc.Format
+                    && d.SampleDesc.Count == desc.SampleDesc.Count)
+                return true;
+            std::exchange (t, nullptr)->Release ();
+        }
+        return device->CreateTexture2D (&desc, nullptr, &t) == S_OK;
+    }
+
+    bool
+    copy (unsigned slot)
+    {
+        ID3D11Texture2D* back = nullptr;
+        if (chain->GetBuffer (0, IID_PPV_ARGS (&back)) != S_OK)
+            return false;
+        auto guard = gsl::finally ([back] { back->Release (); });
+
+        D3D11_TEXTURE2D_DESC desc;
+        back->GetDesc (&desc);
+        bool bgra;
+        if (!supported (desc.Format, bgra))
+        {
+            log () << "Capture of back buffer format " << int (desc.Format)
+                   << " is not supported." << std::endl;
+            return false;
+        }
+
+        ID3D11Texture2D* source = back;
+        if (desc.SampleDesc.Count > 1)
+        {
+            D3D11_TEXTURE2D_DESC r = desc;
+            r.SampleDesc = { 1, 0 };
+            r.Usage = D3D11_USAGE_DEFAULT;
+            r.BindFlags = 0;
+            r.CPUAccessFlags = 0;
+            r.MiscFlags = 0;
+            if (!fit (resolved, r))
+                return false;
+            context->ResolveSubresource (resolved, 0, back, 0, desc.Format);
+            source = resolved;
+        }
+
+        D3D11_TEXTURE2D_DESC s = desc;
+        s.MipLevels = s.ArraySize = 1;
+        s.SampleDesc = { 1, 0 };
+        s.Usage = D3D11_USAGE_STAGING;
+        s.BindFlags = 0;
+        s.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        s.MiscFlags = 0;
+        if (!fit (staging[slot], s))
+            return false;
+        context->CopyResource (staging[slot], source);
+        return true;
+    }
+
+    bool
+    map (unsigned slot, capture_image& out)
+    {
+        auto t = staging[slot];
+        D3D11_MAPPED_SUBRESOURCE m;
+        if (!t || context->Map (t, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &m) != S_OK)
+            return false;
+
+        D3D11_TEXTURE2D_DESC desc;
+        t->GetDesc (&desc);
+        supported (desc.Format, out.bgra);
+        out.width = desc.Width;
+        out.height = desc.Height;
+        std::size_t row = std::size_t (desc.Width) * 4;
+        out.pixels.resize (row * desc.Height);
+        for (UINT y = 0; y < desc.Height; ++y)
+            std::memcpy (&out.pixels[y * row], static_cast<char*> (m.pData) + y * m.RowPitch, row);
+        context->Unmap (t, 0);
+        return true;
+    }
+
+    void
+    release ()
+    {
+        for (auto& t: staging)
+            if (t) std::exchange (t, nullptr)->Release ();
+        if (resolved)
+            std::exchange (resolved, nullptr)->Release ();
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// All in one holder of the capture fields
+struct capture_t
+{
+    capture_ring<d3d11_capture_backend> ring;
+    std::uint64_t frame = 0;
+    std::unique_ptr<worker_pool> writer;        ///< One thread, so files get written in order
+    std::atomic<unsigned> queued { 0 };
+    std::atomic<std::uint64_t> discarded { 0 }; ///< Read back, but the writer was behind
+    std::atomic<std::uint64_t> written { 0 };
+    std::atomic<std::uint64_t> failed { 0 };
+    std::atomic<std::uint64_t> bytes { 0 };
+    duration_histogram encode;                  ///< Recorded by the writer
+};
+
+/// Frames read back and waiting for the writer, at most, ~33MB each at 4K
+static constexpr unsigned max_queued = 4;
+
+/// One and only one object
+static capture_t capture;
+
+//--------------------------------------------------------------------------------------------------
+
+/// Writer thread
+static void
+write_capture (capture_job const& job)
+{
+    static std::vector<std::uint8_t> encoded; // Only this thread
+    auto t0 = profiler_now ();
+    if (job.format == SSEGUI_CAPTURE_QOI)
+        encode_qoi (job.image.view (), encoded);
+    else
+        encode_png (job.image.view (), encoded);
+    capture.encode.record (profiler_now () - t0);
+
+    std::wstring path;
+    std::FILE* f = utf8_to_utf16 (job.path.c_str (), path) ? ::_wfopen (path.c_str (), L"wb")
+                                                            : nullptr;
+    bool ok = f && std::fwrite (encoded.data (), 1, encoded.size (), f) == encoded.size ();
+    ok = f && !std::fclose (f) && ok;
+    if (ok)
+    {
+        capture.written.fetch_add (1, std::memory_order_relaxed);
+        capture.bytes.fetch_add (encoded.size (), std::memory_order_relaxed);
+    }
+    else
+        capture.failed.fetch_add (1, std::memory_order_relaxed);
+}
+
+/// Render thread, on each Present after everything got drawn, @returns whether it is capturing
+
+bool
+capture_present (IDXGISwapChain* chain, ID3D11Device* device, ID3D11DeviceContext* context)
+{
+    if (!capture.ring.busy ())
+        return false;
+
+    auto& b = capture.ring.backend ();
+    b.chain = chain;
+    b.device = device;
+    b.context = context;
+    capture.ring.frame (capture.frame++, [] (capture_job&& job) {
+        if (capture.queued.load (std::memory_order_relaxed) >= max_queued)
+        {
+            capture.discarded.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+        if (!capture.writer)
+            capture.writer.reset (new worker_pool (1));
+        capture.queued.fetch_add (1, std::memory_order_relaxed);
+        auto shared = std::make_shared<capture_job> (std::move (job));
+        capture.writer->submit ([shared] {
+            write_capture (*shared);
+            capture.queued.fetch_sub (1, std::memory_order_relaxed);
+        });
+    });
+    return true;
+}
+
+/// Any thread, whether capture_present() has anything to do
+
+bool
+capture_busy ()
+{
+    return capture.ring.busy ();
+}
+
+/// Render thread, the tracked device is replaced: what is in flight is lost, not the requests
+
+void
+capture_device_reset ()
+{
+    capture.ring.reset ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @see #ssegui_capture()
+
+bool
+capture_frames (const char* path, int format, int frames)
+{
+    ssegui_error.clear ();
+    if (!path || !*path || (format != SSEGUI_CAPTURE_PNG && format != SSEGUI_CAPTURE_QOI)
+            || frames < 1 || frames > 10000)
+    {
+        ssegui_error = __func__ + " invalid argument"s;
+        return false;
+    }
+    capture.ring.request_frames (path, format, unsigned (frames));
+    wake_present ();
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Read back and writer statistics, @see ssegui_execute ("stats")
+
+void
+capture_stats (nlohmann::json& json)
+{
+    auto const& r = capture.ring;
+    json["capture"] = {
+        { "requested",  r.requested.load () },
+        { "copied",     r.copied.load () },
+        { "mapped",     r.mapped.load () },
+        { "dropped",    r.dropped.load () },
+        { "lost",       r.lost.load () },
+        { "polls",      r.polls.load () },
+        { "discarded",  capture.discarded.load () },
+        { "written",    capture.written.load () },
+        { "failed",     capture.failed.load () },
+        { "bytes",      capture.bytes.load () },
+        { "encode", {
+            { "mean",   capture.encode.mean () },
+            { "p50",    capture.encode.quantile (.50) },
+            { "p99",    capture.encode.quantile (.99) },
+            { "max",    capture.encode.maximum () }
+        } }
+    };
+}
+
+//--------------------------------------------------------------------------------------------------
+
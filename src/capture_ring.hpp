@@ -0,0 +1,226 @@
+/**
+ * @file capture_ring.hpp
+ * @brief Back buffer copies into a ring of staging textures, read back frames later
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Mapping a staging texture right after copying into it waits for the GPU to finish the whole
+ * frame. Instead, each captured frame is copied into the next free slot of a small ring, and the
+ * oldest copies are mapped without waiting on later Presents, once the GPU got there. What is
+ * read back goes to a sink, e.g. encoding workers. Requests come from any thread, the rest runs
+ * on the render thread.
+ *
+ * The D3D11 specifics are behind a Backend type, so the scheduling can run against mocks:
+ *
+ *     struct Backend {
+ *         bool copy (unsigned slot);                       // Back buffer into the slot texture
+ *         bool map (unsigned slot, capture_image& out);    // Non-blocking, false if not yet
+ *         void release ();                                 // Of all slot textures
+ *     };
+ */
+
+#ifndef SSEGUI_CAPTURE_RING_HPP
+#define SSEGUI_CAPTURE_RING_HPP
+
+#include "image_codec.hpp"
+#include "histogram.hpp"
+
+#include <deque>
+#include <mutex>
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <utility>
+
+//--------------------------------------------------------------------------------------------------
+
+struct capture_image
+{
+    std::vector<std::uint8_t> pixels;   ///< Tightly packed, 4 bytes per pixel
+    unsigned width = 0, height = 0;
+    bool bgra = false;
+
+    image_view view () const noexcept { return { pixels.data (), width, height, bgra }; }
+};
+
+/// What to write, where
+struct capture_job
+{
+    std::string path;
+    int format;
+    capture_image image;
+};
+
+template<class Backend, unsigned Slots = 3>
+class capture_ring
+{
+public:
+    static constexpr unsigned min_latency = 1;  ///< Presents after the copy before trying to map
+    static constexpr unsigned give_up = 120;    ///< Presents after which a copy is taken as lost
+
+    std::atomic<std::uint64_t> requested { 0 }; ///< Frames
+    std::atomic<std::uint64_t> copied { 0 };
+    std::atomic<std::uint64_t> mapped { 0 };
+    std::atomic<std::uint64_t> dropped { 0 };   ///< Not copied, as all slots were in flight
+    std::atomic<std::uint64_t> lost { 0 };      ///< Never mapped, or the copy failed
+    std::atomic<std::uint64_t> polls { 0 };     ///< Map attempts which would have waited
+
+private:
+    struct request
+    {
+        std::string path;
+        int format;
+        unsigned frames, taken;
+    };
+
+    struct slot
+    {
+        std::uint64_t frame;
+        std::string path;
+        int format;
+    };
+
+    Backend backend_;
+    std::mutex mutex_;                          ///< Of the requests
+    std::deque<request> requests_;
+    std::atomic<bool> pending_ { false };
+    std::array<slot, Slots> slots_;
+    unsigned head_ = 0, count_ = 0;             ///< In flight, oldest first
+
+    /// "shot.png" as is for one frame, "shot-0003.png" for the fourth of many
+    static std::string
+    frame_path (request const& r)
+    {
+        if (r.frames == 1)
+            return r.path;
+        char n[16];
+        std::snprintf (n, sizeof (n), "-%04u", r.taken);
+        auto dot = r.path.find_last_of ('.');
+        auto slash = r.path.find_last_of ("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && slash > dot))
+            return r.path + n;
+        return r.path.substr (0, dot) + n + r.path.substr (dot);
+    }
+
+public:
+    capture_ring () = default;
+    explicit capture_ring (Backend b) : backend_ (std::move (b)) {}
+
+    capture_ring (capture_ring const&) = delete;
+    capture_ring& operator= (capture_ring const&) = delete;
+
+    static constexpr unsigned slots () noexcept { return Slots; }
+    Backend& backend () noexcept { return backend_; }
+
+    /// Any thread, the next @param frames Presents, one file each
+    void
+    request_frames (std::string path, int format, unsigned frames)
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+        requests_.push_back ({ std::move (path), format, frames, 0 });
+        requested.fetch_add (frames, std::memory_order_relaxed);
+        pending_.store (true, std::memory_order_release);
+    }
+
+    /// Any thread, whether #frame() has anything to do
+    bool
+    busy () const noexcept
+    {
+        return pending_.load (std::memory_order_acquire);
+    }
+
+    /**
+     * Render thread, on each Present once everything got drawn: reads back the copies the GPU
+     * is done with, into @param sink (capture_job&&), and copies this frame if requested.
+     *
+     * @param frame counter, increasing by one on each Present
+     */
+    template<class Sink>
+    void
+    frame (std::uint64_t frame, Sink&& sink)
+    {
+        while (count_)
+        {
+            auto& s = slots_[head_];
+            if (frame - s.frame < min_latency)
+                break;
+            capture_job job { std::move (s.path), s.format, {} };
+            if (backend_.map (head_, job.image))
+            {
+                relaxed_add (mapped);
+                sink (std::move (job));
+            }
+            else if (frame - s.frame < give_up)
+            {
+                s.path = std::move (job.path);
+                relaxed_add (polls);
+                break; // The GPU is in order, later copies are not done either
+            }
+            else
+                relaxed_add (lost);
+            head_ = (head_ + 1) % Slots;
+            --count_;
+        }
+
+        std::unique_lock<std::mutex> lock (mutex_);
+        if (!requests_.empty ())
+        {
+            auto& r = requests_.front ();
+            if (count_ == Slots)
+                relaxed_add (dropped);
+            else
+            {
+                auto i = (head_ + count_) % Slots;
+                if (backend_.copy (i))
+                {
+                    slots_[i] = { frame, frame_path (r), r.format };
+                    ++count_;
+                    relaxed_add (copied);
+                }
+                else
+                    relaxed_add (lost);
+            }
+            if (++r.taken == r.frames)
+                requests_.pop_front ();
+        }
+        pending_.store (count_ || !requests_.empty (), std::memory_order_release);
+    }
+
+    /// Render thread, e.g. the device is going away: what is in flight is lost
+    void
+    reset ()
+    {
+        lost.fetch_add (count_, std::memory_order_relaxed);
+        head_ = count_ = 0;
+        backend_.release ();
+        std::lock_guard<std::mutex> lock (mutex_);
+        pending_.store (!requests_.empty (), std::memory_order_release);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,237 @@
+/**
+ * @file deferred.hpp
+ * @brief Recording render listeners on worker threads through deferred contexts
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each deferred listener owns a #deferred_slot with its own deferred context. On Present, the
+ * render thread waits for the recordings started on the previous Present, executes the finished
+ * command lists in the listeners order and starts the recordings for the next frame on the
+ * workers. So the deferred listeners are one frame behind, but their CPU cost overlaps with the
+ * game frame instead of adding to it.
+ *
+ * The D3D11 specifics are behind a Backend type, so the scheduling can run against mocks:
+ *
+ *     struct Backend {
+ *         typedef ... context;         // e.g. ID3D11DeviceContext
+ *         typedef ... command_list;    // e.g. ID3D11CommandList
+ *         context* create_context ();  // Called from the workers
+ *         command_list* finish (context*);
+ *         void execute (command_list*);
+ *         static void release (context*);
+ *         static void release (command_list*);
+ *     };
+ */
+
+#ifndef SSEGUI_DEFERRED_HPP
+#define SSEGUI_DEFERRED_HPP
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Fixed set of threads running jobs, with a wait for all of them to finish.
+
+class worker_pool
+{
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void ()>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable work_, done_;
+    unsigned pending_ = 0;
+    bool stop_ = false;
+
+    void
+    loop ()
+    {
+        std::unique_lock<std::mutex> lock (mutex_);
+        for (;;)
+        {
+            work_.wait (lock, [this] { return stop_ || !jobs_.empty (); });
+            if (jobs_.empty ())
+                return;
+            auto job = std::move (jobs_.front ());
+            jobs_.pop_front ();
+            lock.unlock ();
+            job ();
+            lock.lock ();
+            if (!--pending_)
+                done_.notify_all ();
+        }
+    }
+
+public:
+    explicit worker_pool (unsigned n)
+    {
+        for (n = std::max (n, 1u); n--; )
+            threads_.emplace_back (&worker_pool::loop, this);
+    }
+
+    ~worker_pool ()
+    {
+        {
+            std::lock_guard<std::mutex> lock (mutex_);
+            stop_ = true;
+        }
+        work_.notify_all ();
+        for (auto& t: threads_)
+            t.join ();
+    }
+
+    worker_pool (worker_pool const&) = delete;
+    worker_pool& operator= (worker_pool const&) = delete;
+
+    std::size_t size () const noexcept { return threads_.size (); }
+
+    void
+    submit (std::function<void ()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock (mutex_);
+            jobs_.push_back (std::move (job));
+            ++pending_;
+        }
+        work_.notify_one ();
+    }
+
+    /// Until all submitted jobs are done
+    void
+    wait ()
+    {
+        std::unique_lock<std::mutex> lock (mutex_);
+        done_.wait (lock, [this] { return !pending_; });
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Per listener state, touched by one thread at a time: its worker or the render thread.
+
+template<class Backend>
+struct deferred_slot
+{
+    typename Backend::context* context = nullptr;
+    typename Backend::command_list* list = nullptr;  ///< Recorded, not yet executed
+
+    deferred_slot () = default;
+    deferred_slot (deferred_slot const&) = delete;
+    deferred_slot& operator= (deferred_slot const&) = delete;
+    ~deferred_slot ()
+    {
+        if (list) Backend::release (list);
+        if (context) Backend::release (context);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+template<class Backend>
+class deferred_renderer
+{
+    Backend backend_;
+    std::unique_ptr<worker_pool> pool_;
+    unsigned threads_ = 0;
+
+public:
+    typedef deferred_slot<Backend> slot_type;
+
+    Backend& backend () noexcept { return backend_; }
+
+    /// Worker threads to use, zero picks by the hardware. Applied on the next #record().
+    void
+    threads (unsigned n)
+    {
+        threads_ = n;
+        pool_.reset ();
+    }
+
+    unsigned threads () const noexcept { return threads_; }
+
+    /// Render thread, before anything else on Present
+    void
+    sync ()
+    {
+        if (pool_)
+            pool_->wait ();
+    }
+
+    /// Render thread, replays what the listener recorded during the last frame
+    void
+    execute (slot_type& slot)
+    {
+        if (slot.list)
+        {
+            backend_.execute (slot.list);
+            Backend::release (std::exchange (slot.list, nullptr));
+        }
+    }
+
+    /// Render thread, after #sync(), drops the context too, e.g. when the device changes
+    void
+    reset (slot_type& slot)
+    {
+        if (slot.list)
+            Backend::release (std::exchange (slot.list, nullptr));
+        if (slot.context)
+            Backend::release (std::exchange (slot.context, nullptr));
+    }
+
+    /**
+     * Render thread, starts recording for the next frame on a worker.
+     *
+     * @param owner keeps the @param slot alive until the job is done
+     * @param f called as f (context*) on the worker thread
+     */
+    template<class Owner, class F>
+    void
+    record (std::shared_ptr<Owner> owner, slot_type& slot, F&& f)
+    {
+        if (!pool_)
+        {
+            auto n = threads_ ? threads_ : std::thread::hardware_concurrency () / 2;
+            pool_.reset (new worker_pool (std::min (n, 8u)));
+        }
+        pool_->submit ([this, owner, &slot, f] () mutable {
+            if (!slot.context)
+                slot.context = backend_.create_context ();
+            if (!slot.context)
+                return;
+            f (slot.context);
+            if (slot.list) // Never executed, e.g. the listener was toggled
+                Backend::release (std::exchange (slot.list, nullptr));
+            slot.list = backend_.finish (slot.context);
+        });
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
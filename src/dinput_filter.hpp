@@ -0,0 +1,88 @@
+/**
+ * @file dinput_filter.hpp
+ * @brief What of the DirectInput devices the game gets, toggled by a key
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each keyboard state the game reads is looked at first: releasing the disable key toggles both
+ * devices, a disabled device reads as idle. Only the input thread calls it. Does not depend on
+ * Windows, input.cpp wraps it around the actual devices.
+ */
+
+#ifndef SSEGUI_DINPUT_FILTER_HPP
+#define SSEGUI_DINPUT_FILTER_HPP
+
+#include "profiler.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+struct dinput_filter
+{
+    unsigned disable_key = 0;       ///< DIK_* code
+    bool key_pressed = false;       ///< On the last state
+    bool keyboard_disabled = false; ///< For the game
+    bool mouse_disabled = false;
+
+    /// Of the 256 bytes @param keys, @returns whether it toggled the devices
+
+    bool
+    keyboard_state (std::uint8_t const* keys) noexcept
+    {
+        bool pressed = keys[disable_key];
+        if (!std::exchange (key_pressed, pressed) || pressed)
+            return false;
+        mouse_disabled = !mouse_disabled;
+        keyboard_disabled = !keyboard_disabled;
+        return true;
+    }
+
+    /// What the game reads from the keyboard, @param keys in place
+
+    void
+    filter_keyboard (std::uint8_t* keys, std::size_t size) const noexcept
+    {
+        if (keyboard_disabled)
+            std::fill_n (keys, size, 0);
+    }
+
+    /// Tells each of @param listeners whether the keyboard and the mouse are enabled
+
+    template<class List>
+    void
+    notify (List const& listeners, bool profile) const
+    {
+        for (auto const& l: listeners)
+        {
+            cost_timer t (profile ? &l.info->cost : nullptr);
+            l.callback (!keyboard_disabled, !mouse_disabled);
+        }
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,342 @@
+/**
+ * @file fonts.cpp
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Public API
+ *
+ * @details
+ * Shared glyph atlas of signed distance fields. GDI rasterizes each glyph at 4x oversampling on a
+ * worker thread, the distance field is computed there too, and the render thread only uploads the
+ * finished cells into the atlas texture on the next Present. @see glyph_atlas.hpp
+ */
+
+#include <sse-gui/sse-gui.h>
+#include <gsl/gsl_util>
+
+#include <utils/winutils.hpp>
+#include "glyph_atlas.hpp"
+#include "deferred.hpp"
+#include "parameters.hpp"
+
+#include <mutex>
+#include <string>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <utility>
+#include <algorithm>
+#include <fstream>
+
+#include <windows.h>
+#include <d3d11.h>
+
+//--------------------------------------------------------------------------------------------------
+
+using namespace std::string_literals;
+
+/// Opened from within skse.cpp
+extern std::ofstream& log ();
+
+/// Defined in sse-gui.cpp
+extern thread_local std::string ssegui_error;
+
+/// Defined in parameters.cpp
+extern void publish_pointer (builtin_parameter, void const*);
+extern void withdraw_parameter (builtin_parameter);
+
+//--------------------------------------------------------------------------------------------------
+
+constexpr unsigned atlas_size = 2048;   ///< Pixels per side of the texture
+constexpr unsigned cell_size = 48;      ///< Pixels per side of a glyph cell
+constexpr unsigned em_size = 32;        ///< Pixels per em in the atlas
+constexpr unsigned oversample = 4;      ///< Coverage pixels per distance field pixel
+
+/// In atlas pixels, so the public #SSEGUI_FONT_SPREAD is in ems
+constexpr float spread = SSEGUI_FONT_SPREAD * em_size;
+
+struct font_face
+{
+    std::wstring face;
+    int weight;
+};
+
+struct font_glyph
+{
+    bool ready;
+    ssegui_glyph quad;
+};
+
+/// Output of a worker, waiting for the upload
+struct raster_result
+{
+    glyph_key key;
+    unsigned cell;
+    unsigned width, height;
+    std::vector<std::uint8_t> sdf;
+    ssegui_glyph quad;  ///< Without the texture coordinates
+};
+
+/// All in one holder of the font service fields
+struct fonts_t
+{
+    std::mutex mutex;   ///< Guards everything below, but the D3D objects (render thread only)
+    std::vector<font_face> faces;
+    glyph_atlas<font_glyph> atlas { atlas_size, atlas_size, cell_size };
+    std::uint64_t frame = 2;    ///< Presents so far, from 2 as the previous is never evicted
+    std::vector<raster_result> finished;
+    std::unique_ptr<worker_pool> workers;
+
+    ID3D11Texture2D* texture = nullptr;
+    ID3D11ShaderResourceView* view = nullptr;
+};
+
+/// One and only one object
+static fonts_t fonts;
+
+//--------------------------------------------------------------------------------------------------
+
+/// Worker thread, false if the font has no such glyph
+
+static bool
+rasterize (font_face const& face, char32_t codepoint, raster_result& r)
+{
+    if (codepoint > 0xffff) // GetGlyphOutlineW takes UTF-16 code units, @see ssegui_font_glyphs()
+        return false;
+
+    HDC dc = ::CreateCompatibleDC (nullptr);
+    if (!dc)
+        return false;
+    HFONT font = ::CreateFont (-int (em_size * oversample), 0, 0, 0, face.weight,
+            FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_TT_PRECIS, CLIP_DEFAULT_PRECIS,
+            ANTIALIASED_QUALITY, DEFAULT_PITCH, face.face.c_str ());
+    HGDIOBJ old = font ? ::SelectObject (dc, font) : nullptr;
+    auto cleanup = gsl::finally ([=] {
+        if (old) ::SelectObject (dc, old);
+        if (font) ::DeleteObject (font);
+        ::DeleteDC (dc);
+    });
+    if (!font)
+        return false;
+
+    MAT2 identity = { {0, 1}, {0, 0}, {0, 0}, {0, 1} };
+    GLYPHMETRICS gm;
+    DWORD size = ::GetGlyphOutline (dc, codepoint, GGO_GRAY8_BITMAP, &gm, 0, nullptr, &identity);
+    if (size == GDI_ERROR)
+        return false;
+
+    constexpr float ems = 1.f / (em_size * oversample);
+    r.quad.advance = gm.gmCellIncX * ems;
+    if (!size) // White space
+        return true;
+
+    std::vector<std::uint8_t> bits (size);
+    if (::GetGlyphOutline (dc, codepoint, GGO_GRAY8_BITMAP, &gm, size, bits.data (), &identity)
+            == GDI_ERROR)
+        return false;
+
+    // 65 gray levels, rows aligned on DWORD
+    auto w = gm.gmBlackBoxX, h = gm.gmBlackBoxY, pitch = (w + 3) & ~3u;
+    std::vector<std::uint8_t> coverage (w * h);
+    for (unsigned y = 0; y < h; ++y)
+        for (unsigned x = 0; x < w; ++x)
+            coverage[y * w + x] = std::uint8_t (std::min (bits[y * pitch + x] * 4u, 255u));
+
+    auto m = sdf_margin (spread);
+    r.width = std::min (cell_size, (w + oversample - 1) / oversample + 2 * m);
+    r.height = std::min (cell_size, (h + oversample - 1) / oversample + 2 * m);
+    r.sdf.resize (r.width * r.height);
+    make_sdf (coverage.data (), w, h, oversample, spread, r.sdf.data (), r.width, r.height);
+
+    r.quad.x0 = gm.gmptGlyphOrigin.x * ems - float (m) / em_size;
+    r.quad.y0 = -gm.gmptGlyphOrigin.y * ems - float (m) / em_size;
+    r.quad.x1 = r.quad.x0 + float (r.width) / em_size;
+    r.quad.y1 = r.quad.y0 + float (r.height) / em_size;
+    return true;
+}
+
+/// Under the lock, the glyph just got its cell in the atlas
+
+static void
+request (glyph_key key, unsigned cell)
+{
+    if (!fonts.workers)
+    {
+        auto n = std::thread::hardware_concurrency () / 2;
+        fonts.workers.reset (new worker_pool (std::min (std::max (n, 1u), 4u)));
+    }
+    auto face = fonts.faces[key.font];
+    fonts.workers->submit ([face, key, cell] {
+        raster_result r = { key, cell, 0, 0, {}, {} };
+        if (!rasterize (face, key.codepoint, r))
+            r.quad = {}; // Still "ready", so it is not asked again and again
+        std::lock_guard<std::mutex> lock (fonts.mutex);
+        fonts.finished.push_back (std::move (r));
+    });
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Render thread, on each Present before the listeners, uploads the rasterized glyphs
+
+void
+font_frame (ID3D11Device* device, ID3D11DeviceContext* context)
+{
+    std::lock_guard<std::mutex> lock (fonts.mutex);
+    ++fonts.frame;
+    if (fonts.finished.empty ())
+        return;
+
+    if (!fonts.texture)
+    {
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = desc.Height = atlas_size;
+        desc.MipLevels = desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_R8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        if (device->CreateTexture2D (&desc, nullptr, &fonts.texture) != S_OK
+                || device->CreateShaderResourceView (fonts.texture, nullptr, &fonts.view) != S_OK)
+        {
+            log () << "Unable to create the font atlas." << std::endl;
+            if (fonts.texture) std::exchange (fonts.texture, nullptr)->Release ();
+            fonts.finished.clear ();
+            return;
+        }
+        publish_pointer (param_font_atlas, fonts.view);
+    }
+
+    for (auto const& r: fonts.finished)
+    {
+        // Might have been evicted and its cell reused, while rasterizing
+        auto e = fonts.atlas.peek (r.key);
+        if (!e || e->cell != r.cell || e->glyph.ready)
+            continue;
+
+        e->glyph.ready = true;
+        e->glyph.quad = r.quad;
+        e->glyph.quad.ready = 1;
+        if (r.sdf.empty ())
+            continue;
+
+        unsigned x, y;
+        fonts.atlas.origin (r.cell, x, y);
+        D3D11_BOX box = { x, y, 0, x + r.width, y + r.height, 1 };
+        context->UpdateSubresource (fonts.texture, 0, &box, r.sdf.data (), r.width, 0);
+
+        constexpr float texel = 1.f / atlas_size;
+        e->glyph.quad.u0 = x * texel;
+        e->glyph.quad.v0 = y * texel;
+        e->glyph.quad.u1 = (x + r.width) * texel;
+        e->glyph.quad.v1 = (y + r.height) * texel;
+    }
+    fonts.finished.clear ();
+}
+
+/// Render thread, the tracked device is replaced: the glyphs get rasterized anew on next use
+
+void
+font_device_reset ()
+{
+    std::lock_guard<std::mutex> lock (fonts.mutex);
+    std::vector<glyph_key> keys;
+    for (auto const& e: fonts.atlas)
+        keys.push_back (e.key);
+    for (auto const& k: keys)
+        fonts.atlas.erase (k);
+    fonts.finished.clear ();
+    withdraw_parameter (param_font_atlas);
+    if (fonts.view) std::exchange (fonts.view, nullptr)->Release ();
+    if (fonts.texture) std::exchange (fonts.texture, nullptr)->Release ();
+}
+
+/// Render thread, the atlas or nullptr if no glyph was ever used
+
+ID3D11ShaderResourceView*
+font_atlas ()
+{
+    return fonts.view;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @see #ssegui_font()
+
+bool
+load_font (const char* face, int weight, int* font)
+{
+    Expects (font);
+    ssegui_error.clear ();
+
+    font_face f = { {}, std::min (std::max (weight, 1), 1000) };
+    if (!face || !*face || !utf8_to_utf16 (face, f.face))
+    {
+        ssegui_error = __func__ + " invalid face name"s;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock (fonts.mutex);
+    auto it = std::find_if (fonts.faces.cbegin (), fonts.faces.cend (), [&f] (auto const& o) {
+        return o.face == f.face && o.weight == f.weight;
+    });
+    *font = int (it - fonts.faces.cbegin ());
+    if (it == fonts.faces.cend ())
+    {
+        fonts.faces.push_back (f);
+        log () << "Font " << face << ' ' << f.weight << " loaded as " << *font << '.' << std::endl;
+    }
+    return true;
+}
+
+/// @see #ssegui_font_glyphs()
+
+bool
+font_glyphs (int font, const char* text, std::size_t size, std::size_t* count, ssegui_glyph* out)
+{
+    Expects (count);
+    ssegui_error.clear ();
+
+    std::lock_guard<std::mutex> lock (fonts.mutex);
+    if (font < 0 || std::size_t (font) >= fonts.faces.size () || (!text && size))
+    {
+        ssegui_error = __func__ + " invalid font or text"s;
+        return false;
+    }
+
+    std::size_t n = 0;
+    for (auto s = text, end = text + size; s < end; ++n)
+    {
+        glyph_key key = { std::uint32_t (font), utf8_next (s, end) };
+        if (!out)
+            continue;
+        if (n >= *count)
+            break;
+
+        auto e = fonts.atlas.find (key, fonts.frame);
+        if (!e && (e = fonts.atlas.insert (key, fonts.frame)))
+            request (key, e->cell);
+        out[n] = e && e->glyph.ready ? e->glyph.quad : ssegui_glyph {};
+    }
+    *count = n;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,171 @@
+/**
+ * @file frame_alloc.cpp
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Public API
+ *
+ * @details
+ * Transient per-frame memory for the plugins, so the listeners do not hit the heap the game uses.
+ * The threads register their arenas only for the statistics. @see frame_arena.hpp
+ */
+
+#include <sse-gui/sse-gui.h>
+#include <nlohmann/json.hpp>
+#include "frame_arena.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+using namespace std::string_literals;
+
+/// Defined in sse-gui.cpp
+extern thread_local std::string ssegui_error;
+
+/// Defined in render.cpp
+extern void wake_present ();
+
+//--------------------------------------------------------------------------------------------------
+
+struct thread_arenas;
+
+/// All in one holder of the allocator fields
+struct frame_alloc_t
+{
+    std::atomic<std::uint64_t> frame;   ///< Bumped after the render listeners on each Present
+    std::atomic<std::uint64_t> used;    ///< Frame of the last allocation plus one, zero if none
+
+    std::mutex mutex;
+    std::vector<thread_arenas*> threads;
+    std::uint64_t retired[4];           ///< Allocations, bytes, failures & peak of ended threads
+};
+
+/// One and only one object
+static frame_alloc_t frame_alloc = {};
+
+/// Registered for the statistics only, the allocations do not lock
+struct thread_arenas : frame_arenas
+{
+    thread_arenas ()
+    {
+        std::lock_guard<std::mutex> lock (frame_alloc.mutex);
+        frame_alloc.threads.push_back (this);
+    }
+
+    ~thread_arenas ()
+    {
+        std::lock_guard<std::mutex> lock (frame_alloc.mutex);
+        auto& t = frame_alloc.threads;
+        t.erase (std::remove (t.begin (), t.end (), this), t.end ());
+        auto& r = frame_alloc.retired;
+        r[0] += stats.allocations;
+        r[1] += stats.bytes;
+        r[2] += stats.failures;
+        r[3] = std::max<std::uint64_t> (r[3], stats.peak);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Render thread, after the last render listener returned
+
+void
+frame_alloc_next ()
+{
+    frame_alloc.frame.fetch_add (1, std::memory_order_release);
+}
+
+/// Any thread, whether there were allocations in this frame or the previous one, so Present
+/// stays hooked until their arenas got recycled
+
+bool
+frame_alloc_busy ()
+{
+    auto used = frame_alloc.used.load (std::memory_order_relaxed);
+    return used && frame_alloc.frame.load (std::memory_order_relaxed) + 1 - used <= 1;
+}
+
+/// @see #ssegui_frame_alloc()
+
+void*
+frame_allocate (std::size_t size, std::size_t alignment)
+{
+    if (!alignment)
+        alignment = 16;
+    if ((alignment & (alignment - 1)) || alignment > frame_arena::max_alignment
+            || size > PTRDIFF_MAX / 2)
+    {
+        ssegui_error = __func__ + " invalid size or alignment"s;
+        return nullptr;
+    }
+
+    static thread_local thread_arenas arenas;
+    auto frame = frame_alloc.frame.load (std::memory_order_acquire);
+    void* p = arenas.allocate (size, alignment, frame);
+    if (!p)
+    {
+        ssegui_error = __func__ + " out of memory"s;
+        return p;
+    }
+
+    // Once per frame: without Present hooked the frames would not go on and the arenas would grow
+    if (frame_alloc.used.load (std::memory_order_relaxed) != frame + 1)
+    {
+        frame_alloc.used.store (frame + 1, std::memory_order_relaxed);
+        wake_present ();
+    }
+    return p;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Allocator statistics, @see ssegui_execute ("stats")
+
+void
+frame_alloc_stats (nlohmann::json& json)
+{
+    std::lock_guard<std::mutex> lock (frame_alloc.mutex);
+    auto const& r = frame_alloc.retired;
+    std::uint64_t allocations = r[0], bytes = r[1], failures = r[2], peak = r[3], reserved = 0;
+    for (auto t: frame_alloc.threads)
+    {
+        allocations += t->stats.allocations;
+        bytes += t->stats.bytes;
+        failures += t->stats.failures;
+        peak = std::max<std::uint64_t> (peak, t->stats.peak);
+        reserved += t->stats.reserved;
+    }
+    json["frame_alloc"] = {
+        { "frame",       frame_alloc.frame.load () },
+        { "threads",     frame_alloc.threads.size () },
+        { "allocations", allocations },
+        { "bytes",       bytes },
+        { "failures",    failures },
+        { "peak",        peak },
+        { "reserved",    reserved }
+    };
+}
+
+//--------------------------------------------------------------------------------------------------
+
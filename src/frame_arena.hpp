@@ -0,0 +1,193 @@
+/**
+ * @file frame_arena.hpp
+ * @brief Per-thread, double buffered bump allocation of memory living for about two frames
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each thread owns two arenas and allocates from the one of the current frame parity. The frame
+ * number is bumped by the render thread after the last listener returns, and an arena is reset by
+ * its own thread, lazily, on the first allocation in a frame of the same parity - two frames
+ * later. Hence there is no synchronization between the threads besides reading the frame number,
+ * and memory from one frame is still valid during the next.
+ *
+ * An arena which needed more than one block in a frame is merged into one block on reset, so in
+ * the steady state each allocation is an aligned pointer bump.
+ *
+ * The frame number is passed in by the caller, frame_alloc.cpp, so bench_frame_alloc steps the
+ * frames itself.
+ */
+
+#ifndef SSEGUI_FRAME_ARENA_HPP
+#define SSEGUI_FRAME_ARENA_HPP
+
+#include "histogram.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Single bump allocator over a list of blocks, owner thread only
+
+class frame_arena
+{
+    struct block
+    {
+        std::unique_ptr<unsigned char[]> data;
+        std::size_t size;
+    };
+
+    std::vector<block> blocks_;
+    std::size_t current_ = 0;       ///< Block to allocate from
+    std::size_t offset_ = 0;        ///< In the current block
+    std::size_t used_ = 0;          ///< Bytes handed out since the reset, without the padding
+    std::size_t reserved_ = 0;      ///< Of all blocks
+
+    bool
+    grow (std::size_t size)
+    {
+        auto n = std::max (size, blocks_.empty () ? initial_size : blocks_.back ().size * 2);
+        block b = { std::unique_ptr<unsigned char[]> (new (std::nothrow) unsigned char[n]), n };
+        if (!b.data)
+            return false;
+        blocks_.push_back (std::move (b));
+        reserved_ += n;
+        current_ = blocks_.size () - 1;
+        offset_ = 0;
+        return true;
+    }
+
+public:
+    static constexpr std::size_t initial_size = 64 * 1024;
+    static constexpr std::size_t max_alignment = 4096;
+
+    std::size_t used () const noexcept { return used_; }
+    std::size_t reserved () const noexcept { return reserved_; }
+    std::size_t blocks () const noexcept { return blocks_.size (); }
+
+    /// @param alignment is a power of two up to #max_alignment, nullptr when out of memory
+    void*
+    allocate (std::size_t size, std::size_t alignment) noexcept
+    {
+        for (;;)
+        {
+            if (current_ < blocks_.size ())
+            {
+                auto& b = blocks_[current_];
+                auto base = reinterpret_cast<std::uintptr_t> (b.data.get ());
+                auto at = ((base + offset_ + alignment - 1) & ~(alignment - 1)) - base;
+                if (at <= b.size && size <= b.size - at)
+                {
+                    offset_ = at + size;
+                    used_ += size;
+                    return b.data.get () + at;
+                }
+                if (current_ + 1 < blocks_.size ())
+                {
+                    ++current_;
+                    offset_ = 0;
+                    continue;
+                }
+            }
+            if (!grow (size + alignment))
+                return nullptr;
+        }
+    }
+
+    /// Everything allocated becomes invalid, the memory is kept for reuse
+    void
+    reset () noexcept
+    {
+        if (blocks_.size () > 1) // Next time all should fit in one
+        {
+            auto n = reserved_;
+            blocks_.clear ();
+            reserved_ = 0;
+            grow (n);
+        }
+        current_ = offset_ = used_ = 0;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Statistics of one thread, written by it only, so plain loads and stores suffice
+
+struct frame_arena_stats
+{
+    std::atomic<std::uint64_t> allocations { 0 };
+    std::atomic<std::uint64_t> bytes { 0 };
+    std::atomic<std::uint64_t> failures { 0 };
+    std::atomic<std::uint64_t> peak { 0 };          ///< Most bytes in a single frame
+    std::atomic<std::uint64_t> reserved { 0 };      ///< Currently held by both arenas
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// The two arenas of one thread
+
+class frame_arenas
+{
+    frame_arena arenas_[2];
+    std::uint64_t frames_[2] = { ~std::uint64_t (0), ~std::uint64_t (0) };
+
+public:
+    frame_arena_stats stats;
+
+    /// From the arena of @param frame, resetting it if it still holds memory of an older frame
+    void*
+    allocate (std::size_t size, std::size_t alignment, std::uint64_t frame) noexcept
+    {
+        auto i = frame & 1;
+        auto& a = arenas_[i];
+        if (frames_[i] != frame)
+        {
+            if (a.used () > stats.peak.load (std::memory_order_relaxed))
+                stats.peak.store (a.used (), std::memory_order_relaxed);
+            a.reset ();
+            frames_[i] = frame;
+        }
+
+        auto reserved = a.reserved ();
+        void* p = a.allocate (size, alignment);
+        if (!p)
+        {
+            relaxed_add (stats.failures, 1);
+            return nullptr;
+        }
+        relaxed_add (stats.allocations, 1);
+        relaxed_add (stats.bytes, size);
+        if (a.reserved () != reserved)
+            stats.reserved.store (arenas_[0].reserved () + arenas_[1].reserved (),
+                    std::memory_order_relaxed);
+        return p;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
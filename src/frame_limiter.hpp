@@ -0,0 +1,178 @@
+/**
+ * @file frame_limiter.hpp
+ * @brief Frame rate cap by a coarse sleep and a busy wait tail
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each frame has a deadline, one interval after the previous one, so the cadence does not drift
+ * with the small errors of each wait. The wait sleeps until shortly before the deadline, then
+ * spins for the rest. Sleeping oversleeps by a varying amount (timer resolution, scheduling), so
+ * the margin left for spinning follows the recent oversleeps - little CPU burnt with a precise
+ * high resolution timer, more with a coarse one. A frame which is late by more than an interval
+ * starts a new cadence instead of trying to catch up with a burst of frames.
+ *
+ * The time source is behind a Clock type, so the limiter runs against simulated clocks:
+ *
+ *     struct Clock {
+ *         std::uint64_t now ();            // Nanoseconds, monotonic
+ *         void sleep (std::uint64_t ns);   // At least that long, maybe more
+ *         void relax ();                   // Once per spin, e.g. a pause instruction
+ *     };
+ */
+
+#ifndef SSEGUI_FRAME_LIMITER_HPP
+#define SSEGUI_FRAME_LIMITER_HPP
+
+#include "histogram.hpp"
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Render thread only, but for the interval and the statistics
+
+template<class Clock>
+class frame_limiter
+{
+    Clock clock_;
+    std::uint64_t deadline_ = 0;    ///< Of the current frame, zero for none yet
+    std::atomic<std::uint64_t> interval_ { 0 };
+    std::atomic<std::uint64_t> oversleep_ { 0 };   ///< Moving average, nanoseconds
+
+public:
+    static constexpr std::uint64_t min_margin = 200000;     ///< Spinning at least that long
+    static constexpr std::uint64_t max_margin = 4000000;    ///< Spinning at most that long
+    static constexpr unsigned average_frames = 16;
+
+    duration_histogram waited;      ///< Per frame, zero if late
+    duration_histogram error;       ///< Past the deadline, when woken on time
+    std::atomic<std::uint64_t> late { 0 };     ///< Frames already past their deadline
+    std::atomic<std::uint64_t> resyncs { 0 };  ///< Frames late by more than an interval
+
+    frame_limiter () = default;
+    explicit frame_limiter (Clock c) : clock_ (std::move (c)) {}
+
+    Clock& clock () noexcept { return clock_; }
+
+    /// Any thread, @param fps zero disables it
+    void
+    limit (double fps) noexcept
+    {
+        interval_.store (fps > 0 ? std::uint64_t (1e9 / fps) : 0, std::memory_order_relaxed);
+    }
+
+    std::uint64_t interval () const noexcept { return interval_.load (std::memory_order_relaxed); }
+    bool enabled () const noexcept { return interval () != 0; }
+
+    /// What is left for spinning after the sleep
+    std::uint64_t
+    margin () const noexcept
+    {
+        auto over = oversleep_.load (std::memory_order_relaxed);
+        return std::min (max_margin, std::max (min_margin, 2 * over));
+    }
+
+    /// Once per frame, returns on its deadline, or right away if past it
+    void
+    wait ()
+    {
+        auto interval = interval_.load (std::memory_order_relaxed);
+        if (!interval)
+        {
+            deadline_ = 0;
+            return;
+        }
+
+        auto now = clock_.now ();
+        if (!deadline_)
+            deadline_ = now;
+        if (now >= deadline_)
+        {
+            waited.record (0);
+            if (deadline_ != now)
+                relaxed_add (late);
+            if (now - deadline_ >= interval)
+            {
+                relaxed_add (resyncs);
+                deadline_ = now; // Start anew, rather than catching up
+            }
+            deadline_ += interval;
+            return;
+        }
+
+        auto start = now;
+        auto m = margin ();
+        if (deadline_ - now > m)
+        {
+            auto request = deadline_ - now - m;
+            clock_.sleep (request);
+            auto slept = clock_.now () - now;
+            auto over = slept > request ? slept - request : 0;
+            auto average = oversleep_.load (std::memory_order_relaxed);
+            average = average
+                ? average + (std::int64_t (over - average) / std::int64_t (average_frames))
+                : over;
+            oversleep_.store (average, std::memory_order_relaxed);
+            now += slept;
+        }
+        while (now < deadline_)
+        {
+            clock_.relax ();
+            now = clock_.now ();
+        }
+        waited.record (now - start);
+        error.record (now - deadline_);
+        deadline_ += interval;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+template<class Clock>
+inline void
+to_json (nlohmann::json& j, frame_limiter<Clock> const& l)
+{
+    j = nlohmann::json {
+        { "interval", l.interval () },
+        { "margin",   l.margin () },
+        { "late",     l.late.load (std::memory_order_relaxed) },
+        { "resyncs",  l.resyncs.load (std::memory_order_relaxed) },
+        { "waited", {
+            { "mean", l.waited.mean () },
+            { "p50",  l.waited.quantile (.50) },
+            { "p99",  l.waited.quantile (.99) } } },
+        { "error", {
+            { "mean", l.error.mean () },
+            { "p50",  l.error.quantile (.50) },
+            { "p99",  l.error.quantile (.99) },
+            { "max",  l.error.maximum () } } }
+    };
+}
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,130 @@
+/**
+ * @file frame_pacing.hpp
+ * @brief Frame time distribution and Present blocking, as seen from the Present hook
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Three timestamps per Present: its entry, the call of the original Present and its return. The
+ * frame time is from one entry to the next, the blocking time is what the original Present took
+ * (the driver waiting for a free back buffer, vsync and so on) and the overhead is what SSEGUI and
+ * its listeners added before it. Everything goes into fixed memory histograms, so there is no
+ * allocation, only a few relaxed stores per frame.
+ *
+ * A stutter is a frame longer than twice the recent average. Frames longer than a second are
+ * loading screens, alt-tabs or breakpoints rather than stutters, so they are only counted.
+ */
+
+#ifndef SSEGUI_FRAME_PACING_HPP
+#define SSEGUI_FRAME_PACING_HPP
+
+#include "histogram.hpp"
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cstdint>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Single writer (the render thread), any reader
+
+class frame_pacing
+{
+    std::uint64_t last_ = 0;    ///< Previous entry
+    std::uint64_t call_ = 0;    ///< Call of the original Present
+    std::uint64_t average_ = 0; ///< Moving, of the frame time
+
+public:
+    static constexpr std::uint64_t pause = 1000000000;
+    static constexpr unsigned stutter_factor = 2;
+    static constexpr unsigned average_frames = 16;  ///< Weight of the moving average
+
+    fine_histogram frame;           ///< From a Present entry to the next
+    fine_histogram blocked;         ///< Within the original Present
+    duration_histogram overhead;    ///< From the Present entry to the original Present
+    std::atomic<std::uint64_t> stutters { 0 }, pauses { 0 };
+
+    /// On entry of the hooked Present, @param now as given by profiler_now()
+    void
+    enter (std::uint64_t now) noexcept
+    {
+        auto dt = now - last_;
+        if (last_ && dt >= pause)
+            relaxed_add (pauses);
+        else if (last_)
+        {
+            frame.record (dt);
+            if (average_ && dt > stutter_factor * average_)
+                relaxed_add (stutters);
+            average_ = average_ ? average_ + (std::int64_t (dt - average_) / average_frames) : dt;
+        }
+        last_ = call_ = now;
+    }
+
+    /// Right before calling the original Present
+    void
+    call (std::uint64_t now) noexcept
+    {
+        overhead.record (now - last_);
+        call_ = now;
+    }
+
+    /// Right after the original Present returned
+    void
+    exit (std::uint64_t now) noexcept
+    {
+        blocked.record (now - call_);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+inline void
+to_json (nlohmann::json& j, frame_pacing const& p)
+{
+    j = nlohmann::json {
+        { "frames",   p.frame.count () },
+        { "mean",     p.frame.mean () },
+        { "p50",      p.frame.quantile (.50) },
+        { "p90",      p.frame.quantile (.90) },
+        { "p99",      p.frame.quantile (.99) },
+        { "p999",     p.frame.quantile (.999) },
+        { "max",      p.frame.maximum () },
+        { "stutters", p.stutters.load (std::memory_order_relaxed) },
+        { "pauses",   p.pauses.load (std::memory_order_relaxed) },
+        { "blocked", {
+            { "mean", p.blocked.mean () },
+            { "p50",  p.blocked.quantile (.50) },
+            { "p99",  p.blocked.quantile (.99) },
+            { "p999", p.blocked.quantile (.999) },
+            { "max",  p.blocked.maximum () } } },
+        { "overhead", {
+            { "mean", p.overhead.mean () },
+            { "p50",  p.overhead.quantile (.50) },
+            { "p99",  p.overhead.quantile (.99) },
+            { "max",  p.overhead.maximum () } } }
+    };
+}
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,351 @@
+/**
+ * @file glyph_atlas.hpp
+ * @brief Glyph cache packing, eviction and signed distance field generation
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The glyphs are stored as signed distance fields, which scale well to any size on screen, so each
+ * glyph is rasterized once at a single size. Hence the atlas is a grid of equal cells, where any
+ * glyph can go into any free cell, and the least recently used glyph gives its cell away when none
+ * is free. Glyphs used in the current or the previous frame are never evicted, as there may be
+ * quads still referring to them.
+ *
+ * The GDI rasterization and the texture upload stay in fonts.cpp, here is only the cache and the
+ * distance field math, which bench_glyph_atlas checks.
+ */
+
+#ifndef SSEGUI_GLYPH_ATLAS_HPP
+#define SSEGUI_GLYPH_ATLAS_HPP
+
+#include <list>
+#include <cmath>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Next code point of UTF-8 text, advances @param s. Any malformed sequence gives U+FFFD and
+/// skips only its leading byte.
+
+inline char32_t
+utf8_next (char const*& s, char const* end) noexcept
+{
+    auto c = std::uint8_t (*s++);
+    if (c < 0x80)
+        return c;
+
+    unsigned n = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+    if (!n || c > 0xf4 || end - s < std::ptrdiff_t (n))
+        return 0xfffd;
+
+    char32_t cp = c & (0x3f >> n);
+    for (unsigned i = 0; i < n; ++i)
+    {
+        auto b = std::uint8_t (s[i]);
+        if ((b & 0xc0) != 0x80)
+            return 0xfffd;
+        cp = (cp << 6) | (b & 0x3f);
+    }
+
+    static const char32_t least[] = { 0, 0x80, 0x800, 0x10000 };
+    if (cp < least[n] || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+        return 0xfffd;
+    s += n;
+    return cp;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+struct glyph_key
+{
+    std::uint32_t font;
+    char32_t codepoint;
+
+    bool operator== (glyph_key const& o) const noexcept
+    {
+        return font == o.font && codepoint == o.codepoint;
+    }
+};
+
+struct glyph_key_hash
+{
+    std::size_t
+    operator() (glyph_key const& k) const noexcept
+    {
+        return std::hash<std::uint64_t> () ((std::uint64_t (k.font) << 32) | k.codepoint);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * LRU cache of glyphs over a grid of cells, @param Glyph is whatever the user keeps per glyph.
+ *
+ * Not synchronized, the user should lock around it.
+ */
+
+template<class Glyph>
+class glyph_atlas
+{
+public:
+    struct entry
+    {
+        glyph_key key;
+        unsigned cell;
+        std::uint64_t used;     ///< Frame of the last use
+        Glyph glyph;
+    };
+
+private:
+    typedef std::list<entry> lru_type;
+
+    unsigned width_, height_, cell_;
+    unsigned columns_;
+    lru_type lru_;              ///< Most recently used first
+    std::unordered_map<glyph_key, typename lru_type::iterator, glyph_key_hash> index_;
+    std::vector<unsigned> free_;
+
+public:
+    std::uint64_t hits = 0, misses = 0, evictions = 0, refusals = 0;
+
+    /// Atlas of @param width x @param height pixels, split in squares of @param cell pixels
+    glyph_atlas (unsigned width, unsigned height, unsigned cell)
+        : width_ (width), height_ (height), cell_ (cell), columns_ (width / cell)
+    {
+        auto n = capacity ();
+        index_.reserve (n);
+        free_.reserve (n);
+        for (unsigned i = n; i--; )
+            free_.push_back (i);
+    }
+
+    unsigned width () const noexcept { return width_; }
+    unsigned height () const noexcept { return height_; }
+    unsigned cell () const noexcept { return cell_; }
+    unsigned capacity () const noexcept { return columns_ * (height_ / cell_); }
+    std::size_t size () const noexcept { return index_.size (); }
+
+    /// Top left pixel of a @param cell
+    void
+    origin (unsigned cell, unsigned& x, unsigned& y) const noexcept
+    {
+        x = (cell % columns_) * cell_;
+        y = (cell / columns_) * cell_;
+    }
+
+    /// The cached glyph or nullptr, marks it used in @param frame
+    entry*
+    find (glyph_key const& key, std::uint64_t frame)
+    {
+        auto it = index_.find (key);
+        if (it == index_.end ())
+        {
+            ++misses;
+            return nullptr;
+        }
+        ++hits;
+        it->second->used = frame;
+        lru_.splice (lru_.begin (), lru_, it->second);
+        return &*it->second;
+    }
+
+    /// Lookup without touching anything
+    entry*
+    peek (glyph_key const& key)
+    {
+        auto it = index_.find (key);
+        return it == index_.end () ? nullptr : &*it->second;
+    }
+
+    entry const*
+    peek (glyph_key const& key) const
+    {
+        return const_cast<glyph_atlas*> (this)->peek (key);
+    }
+
+    /**
+     * Place a new glyph, evicting the least recently used if needed.
+     *
+     * @returns nullptr if all cells hold glyphs in use by this or the previous @param frame
+     */
+    entry*
+    insert (glyph_key const& key, std::uint64_t frame)
+    {
+        unsigned cell;
+        if (!free_.empty ())
+        {
+            cell = free_.back ();
+            free_.pop_back ();
+        }
+        else
+        {
+            if (lru_.empty () || lru_.back ().used + 1 >= frame)
+            {
+                ++refusals;
+                return nullptr;
+            }
+            cell = lru_.back ().cell;
+            index_.erase (lru_.back ().key);
+            lru_.pop_back ();
+            ++evictions;
+        }
+        lru_.push_front (entry { key, cell, frame, Glyph {} });
+        index_.emplace (key, lru_.begin ());
+        return &lru_.front ();
+    }
+
+    /// Drop a glyph (e.g. failed to rasterize), its cell becomes free
+    void
+    erase (glyph_key const& key)
+    {
+        auto it = index_.find (key);
+        if (it == index_.end ())
+            return;
+        free_.push_back (it->second->cell);
+        lru_.erase (it->second);
+        index_.erase (it);
+    }
+
+    /// Iteration, most recently used first
+    typename lru_type::const_iterator begin () const noexcept { return lru_.cbegin (); }
+    typename lru_type::const_iterator end () const noexcept { return lru_.cend (); }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Exact squared Euclidean distance transform in linear time.
+ *
+ * P. Felzenszwalb and D. Huttenlocher, "Distance Transforms of Sampled Functions", 2012. On input
+ * @param f holds zero at the features and "infinity" elsewhere, on output the squared distance to
+ * the nearest feature. @param w x @param h grid, @param scratch is reused between calls.
+ */
+
+inline void
+distance_transform (std::vector<float>& f, unsigned w, unsigned h, std::vector<float>& scratch)
+{
+    auto n = std::max (w, h);
+    scratch.resize (n * 4 + 1);
+    float* d = scratch.data ();         // Output of one row or column
+    float* g = d + n;                   // Its input
+    float* z = g + n;                   // Parabola boundaries, n + 1
+    auto v = reinterpret_cast<int*> (z + n + 1); // Parabola vertices, scratch is big enough
+    static_assert (sizeof (int) == sizeof (float), "Scratch reuse");
+
+    auto one = [d, g, z, v] (unsigned n) {
+        auto meet = [g, v] (int q, int k) {
+            int p = v[k];
+            return ((g[q] + float (q) * q) - (g[p] + float (p) * p)) / float (2 * q - 2 * p);
+        };
+        int k = 0;
+        v[0] = 0;
+        z[0] = -INFINITY;
+        z[1] = +INFINITY;
+        for (int q = 1; q < int (n); ++q)
+        {
+            float s = meet (q, k);
+            while (s <= z[k])
+                s = meet (q, --k);
+            ++k;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = +INFINITY;
+        }
+        k = 0;
+        for (int q = 0; q < int (n); ++q)
+        {
+            while (z[k + 1] < q)
+                ++k;
+            float r = float (q - v[k]);
+            d[q] = r * r + g[v[k]];
+        }
+    };
+
+    for (unsigned x = 0; x < w; ++x)
+    {
+        for (unsigned y = 0; y < h; ++y) g[y] = f[y * w + x];
+        one (h);
+        for (unsigned y = 0; y < h; ++y) f[y * w + x] = d[y];
+    }
+    for (unsigned y = 0; y < h; ++y)
+    {
+        std::copy_n (&f[y * w], w, g);
+        one (w);
+        std::copy_n (d, w, &f[y * w]);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Signed distance field from a coverage bitmap.
+ *
+ * @param coverage @param w x @param h, a pixel is inside at 128 and above
+ * @param scale how many coverage pixels go into one output pixel (oversampling)
+ * @param spread output pixels of distance mapped over the full 0..255 range, 128 is the edge,
+ *  bigger values are inside
+ * @param out @param ow x @param oh, the coverage top left corner goes at the output pixel
+ *  (#sdf_margin(), #sdf_margin()) and whatever does not fit is cut
+ */
+
+inline unsigned sdf_margin (float spread) noexcept { return unsigned (std::ceil (spread)); }
+
+inline void
+make_sdf (std::uint8_t const* coverage, unsigned w, unsigned h, unsigned scale, float spread,
+        std::uint8_t* out, unsigned ow, unsigned oh)
+{
+    auto pw = ow * scale, ph = oh * scale;
+    auto m = sdf_margin (spread) * scale;
+
+    constexpr float far = 1e20f;
+    std::vector<float> inside (pw * ph, far), outside (pw * ph, 0.f), scratch;
+    for (unsigned y = 0; y < h && y + m < ph; ++y)
+        for (unsigned x = 0; x < w && x + m < pw; ++x)
+            if (coverage[y * w + x] >= 128)
+            {
+                auto i = (y + m) * pw + x + m;
+                inside[i] = 0.f;
+                outside[i] = far;
+            }
+
+    distance_transform (inside, pw, ph, scratch);  // Distance to the glyph, from outside
+    distance_transform (outside, pw, ph, scratch); // Distance to the background, from inside
+
+    // Sample the center of each output pixel
+    for (unsigned y = 0; y < oh; ++y)
+        for (unsigned x = 0; x < ow; ++x)
+        {
+            auto i = (y * scale + scale / 2) * pw + x * scale + scale / 2;
+            float d = (std::sqrt (outside[i]) - std::sqrt (inside[i])) / scale;
+            float v = 128.f + d * (127.f / spread);
+            out[y * ow + x] = std::uint8_t (std::min (std::max (v, 0.f), 255.f));
+        }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
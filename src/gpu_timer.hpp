@@ -0,0 +1,241 @@
+/**
+ * @file gpu_timer.hpp
+ * @brief GPU time of each listener through timestamp queries, read back without stalling
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each frame takes a slot of a small ring: a disjoint query around the frame and a pair of
+ * timestamp queries around each timed call. A slot is read back no sooner than #latency frames
+ * later, and only if the GPU already has the results, so the CPU never waits for the GPU. If the
+ * GPU is so late that the ring is full, the frame is not timed at all. Frames during which the
+ * GPU clock was unreliable (disjoint) are dropped.
+ *
+ * The D3D11 specifics are behind a Backend type, so the ring can run against mocks:
+ *
+ *     struct Backend {
+ *         typedef ... query;           // e.g. ID3D11Query
+ *         query* create (bool disjoint);
+ *         void begin (query*);         // Disjoint queries only
+ *         void end (query*);
+ *         bool ready (query*, std::uint64_t& frequency, bool& disjoint); // Without flushing
+ *         bool ready (query*, std::uint64_t& ticks);
+ *         static void release (query*);
+ *     };
+ */
+
+#ifndef SSEGUI_GPU_TIMER_HPP
+#define SSEGUI_GPU_TIMER_HPP
+
+#include "histogram.hpp"
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+//--------------------------------------------------------------------------------------------------
+
+/// @param Key tells whose time it was, e.g. a shared pointer to the listener statistics
+
+template<class Backend, class Key>
+class gpu_timer
+{
+public:
+    static constexpr unsigned latency = 3;      ///< Frames before the first read back attempt
+    static constexpr unsigned slots = latency + 3;
+    static constexpr unsigned give_up = 120;    ///< Frames after which a slot is considered lost
+
+private:
+    typedef typename Backend::query query;
+
+    struct pair
+    {
+        query* begin;
+        query* end;
+        Key key;
+    };
+
+    struct slot
+    {
+        query* disjoint = nullptr;
+        std::vector<pair> pairs;    ///< Only grows, reused
+        std::size_t used = 0;
+        std::uint64_t frame = 0;
+        bool pending = false;       ///< Issued but not read back yet
+    };
+
+    Backend backend_ {};
+    std::array<slot, slots> slots_;
+    slot* current_ = nullptr;
+    std::uint64_t frame_ = 0;
+
+    void
+    done (slot& s)
+    {
+        for (std::size_t i = 0; i < s.used; ++i)
+            s.pairs[i].key = Key {}; // E.g. do not keep removed listeners alive
+        s.used = 0;
+        s.pending = false;
+    }
+
+public:
+    /// Frame counts, can be read from any thread
+    std::atomic<std::uint64_t> timed { 0 }, skipped { 0 }, disjoint { 0 }, lost { 0 };
+
+    gpu_timer () = default;
+    explicit gpu_timer (Backend b) : backend_ (b) {}
+
+    ~gpu_timer () { release (); }
+
+    gpu_timer (gpu_timer const&) = delete;
+    gpu_timer& operator= (gpu_timer const&) = delete;
+
+    Backend& backend () noexcept { return backend_; }
+
+    /// All queries, e.g. when the device goes away. Results pending are lost.
+    void
+    release ()
+    {
+        for (auto& s: slots_)
+        {
+            if (s.disjoint)
+                Backend::release (s.disjoint);
+            for (auto& p: s.pairs)
+            {
+                Backend::release (p.begin);
+                Backend::release (p.end);
+            }
+            s = slot {};
+        }
+        current_ = nullptr;
+    }
+
+    /// Starts timing a frame, unless the GPU is too far behind to have a free slot
+    void
+    begin_frame ()
+    {
+        auto& s = slots_[++frame_ % slots];
+        current_ = nullptr;
+        if (s.pending)
+        {
+            relaxed_add (skipped);
+            return;
+        }
+        if (!s.disjoint && !(s.disjoint = backend_.create (true)))
+            return;
+        backend_.begin (s.disjoint);
+        s.frame = frame_;
+        current_ = &s;
+    }
+
+    /// Before a call to time, @returns what to give to #stop()
+    int
+    start (Key const& key)
+    {
+        if (!current_)
+            return -1;
+        auto& s = *current_;
+        if (s.used == s.pairs.size ())
+        {
+            pair p = { backend_.create (false), backend_.create (false), Key {} };
+            if (!p.begin || !p.end)
+            {
+                if (p.begin) Backend::release (p.begin);
+                if (p.end) Backend::release (p.end);
+                return -1;
+            }
+            s.pairs.push_back (p);
+        }
+        auto& p = s.pairs[s.used];
+        p.key = key;
+        backend_.end (p.begin);
+        return int (s.used++);
+    }
+
+    /// After the call, @param i as returned by #start()
+    void
+    stop (int i)
+    {
+        if (i >= 0 && current_)
+            backend_.end (current_->pairs[i].end);
+    }
+
+    void
+    end_frame ()
+    {
+        if (!current_)
+            return;
+        backend_.end (current_->disjoint);
+        current_->pending = true;
+        current_ = nullptr;
+    }
+
+    /**
+     * Reads back the frames whose results are already there.
+     *
+     * @param record (Key const&, std::uint64_t nanoseconds) is called for each timed call
+     */
+    template<class Record>
+    void
+    collect (Record&& record)
+    {
+        for (auto& s: slots_)
+        {
+            if (!s.pending || frame_ - s.frame < latency)
+                continue;
+
+            std::uint64_t frequency;
+            bool unreliable;
+            if (!backend_.ready (s.disjoint, frequency, unreliable))
+            {
+                if (frame_ - s.frame > give_up)
+                {
+                    relaxed_add (lost);
+                    done (s);
+                }
+                continue;
+            }
+            if (unreliable || !frequency)
+            {
+                relaxed_add (disjoint);
+                done (s);
+                continue;
+            }
+
+            // After the disjoint query, the timestamps within are ready too
+            for (std::size_t i = 0; i < s.used; ++i)
+            {
+                std::uint64_t t0, t1;
+                auto const& p = s.pairs[i];
+                if (backend_.ready (p.begin, t0) && backend_.ready (p.end, t1) && t1 >= t0)
+                    record (p.key, std::uint64_t (double (t1 - t0) * 1e9 / frequency));
+            }
+            relaxed_add (timed);
+            done (s);
+        }
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,167 @@
+/**
+ * @file histogram.hpp
+ * @brief Fixed memory, log-linear histogram of durations
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Values (nanoseconds) below 16 have own buckets, above that each power of two is split in 8
+ * linear sub-buckets, i.e. the relative error is at most 12.5%. Everything above ~18 minutes goes
+ * into the last bucket. More sub-buckets give more precision for more memory: with 128 of
+ * them (#fine_histogram) the error is below 0.8%, but the counters take 17KB. There is one
+ * recording thread, while any other may read at any time - the counters are relaxed atomics, so
+ * the readings may be a bit off, but never torn.
+ */
+
+#ifndef SSEGUI_HISTOGRAM_HPP
+#define SSEGUI_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Counter of a single writer, read by others: no need of the locked read-modify-write instructions
+
+template<class T, class U = T>
+inline void
+relaxed_add (std::atomic<T>& a, U v = 1) noexcept
+{
+    a.store (a.load (std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @param SubBits is log2 of the sub-buckets count of each power of two
+
+template<unsigned SubBits>
+class basic_histogram
+{
+public:
+    static constexpr unsigned sub_bits = SubBits;
+    static constexpr unsigned linear = 2u << sub_bits;
+    static constexpr unsigned buckets = linear + (40 - (sub_bits + 1)) * (1u << sub_bits);
+
+private:
+    std::array<std::atomic<std::uint32_t>, buckets> counts_;
+    std::atomic<std::uint64_t> total_;
+    std::atomic<std::uint64_t> sum_;
+    std::atomic<std::uint64_t> max_;
+
+    static unsigned
+    log2 (std::uint64_t v) noexcept
+    {
+        unsigned r = 0;
+        while (v >>= 1) ++r;
+        return r;
+    }
+
+public:
+    basic_histogram () noexcept { reset (); }
+
+    static unsigned
+    bucket (std::uint64_t ns) noexcept
+    {
+        if (ns < linear)
+            return unsigned (ns);
+        unsigned e = log2 (ns);
+        unsigned sub = unsigned (ns >> (e - sub_bits)) & ((1u << sub_bits) - 1);
+        return std::min (linear + (e - sub_bits - 1) * (1u << sub_bits) + sub, buckets - 1);
+    }
+
+    /// Lowest value which falls in the bucket @param b
+    static std::uint64_t
+    bucket_floor (unsigned b) noexcept
+    {
+        if (b < linear)
+            return b;
+        b -= linear;
+        unsigned e = sub_bits + 1 + (b >> sub_bits);
+        auto sub = std::uint64_t (b & ((1u << sub_bits) - 1));
+        return (std::uint64_t (1) << e) + (sub << (e - sub_bits));
+    }
+
+    void
+    record (std::uint64_t ns) noexcept
+    {
+        relaxed_add (counts_[bucket (ns)], 1u);
+        relaxed_add (total_, 1u);
+        relaxed_add (sum_, ns);
+        if (ns > max_.load (std::memory_order_relaxed))
+            max_.store (ns, std::memory_order_relaxed);
+    }
+
+    /// Not atomic as a whole, best done by the recording thread.
+    void
+    reset () noexcept
+    {
+        for (auto& c: counts_)
+            c.store (0, std::memory_order_relaxed);
+        total_.store (0, std::memory_order_relaxed);
+        sum_.store (0, std::memory_order_relaxed);
+        max_.store (0, std::memory_order_relaxed);
+    }
+
+    std::uint64_t count () const noexcept { return total_.load (std::memory_order_relaxed); }
+    std::uint64_t sum () const noexcept { return sum_.load (std::memory_order_relaxed); }
+    std::uint64_t maximum () const noexcept { return max_.load (std::memory_order_relaxed); }
+
+    double
+    mean () const noexcept
+    {
+        auto n = count ();
+        return n ? double (sum ()) / n : 0.;
+    }
+
+    /// Approximation of the @param q (0 to 1) quantile, middle of the matching bucket.
+    std::uint64_t
+    quantile (double q) const noexcept
+    {
+        std::uint64_t n = 0;
+        for (auto const& c: counts_)
+            n += c.load (std::memory_order_relaxed);
+        if (!n)
+            return 0;
+        auto rank = std::uint64_t (q * (n - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (unsigned b = 0; b < buckets; ++b)
+        {
+            seen += counts_[b].load (std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                auto lo = bucket_floor (b);
+                auto hi = b + 1 < buckets ? bucket_floor (b + 1) : lo + 1;
+                return std::min ((lo + hi) / 2, maximum ());
+            }
+        }
+        return maximum ();
+    }
+};
+
+typedef basic_histogram<3> duration_histogram;  ///< Call costs, small and coarse
+typedef basic_histogram<7> fine_histogram;      ///< Frame times, where 12.5% is too coarse
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,358 @@
+/**
+ * @file image_codec.hpp
+ * @brief PNG and QOI encoders of 8 bit RGBA/BGRA images, taken as opaque
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Screenshots of the back buffer, whose alpha means nothing once presented, so both write RGB.
+ * QOI is the fast one (@see https://qoiformat.org/qoi-specification.pdf). PNG is written with
+ * the Sub filter and a single deflate block of fixed Huffman codes, matched through a one probe
+ * hash - no zlib around, and for screenshots most of the gain is in the matching anyway.
+ */
+
+#ifndef SSEGUI_IMAGE_CODEC_HPP
+#define SSEGUI_IMAGE_CODEC_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Tightly packed, 4 bytes per pixel
+struct image_view
+{
+    std::uint8_t const* pixels;
+    unsigned width, height;
+    bool bgra;                      ///< Otherwise RGBA
+};
+
+namespace image_codec {
+
+inline void
+put32 (std::vector<std::uint8_t>& out, std::uint32_t v)
+{
+    std::uint8_t b[4] = { std::uint8_t (v >> 24), std::uint8_t (v >> 16),
+                          std::uint8_t (v >> 8), std::uint8_t (v) };
+    out.insert (out.end (), b, b + 4);
+}
+
+inline std::uint32_t
+crc32 (std::uint8_t const* data, std::size_t size, std::uint32_t crc = 0)
+{
+    static auto const table = [] {
+        std::array<std::uint32_t, 256> t;
+        for (std::uint32_t n = 0; n < 256; ++n)
+        {
+            auto c = n;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    } ();
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline std::uint32_t
+adler32 (std::uint8_t const* data, std::size_t size)
+{
+    std::uint32_t a = 1, b = 0;
+    while (size)
+    {
+        auto n = size < 5552 ? size : 5552; // The most before b could overflow
+        size -= n;
+        while (n--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+/// LSB first, as deflate wants it
+class bit_writer
+{
+    std::vector<std::uint8_t>& out_;
+    std::uint64_t bits_ = 0;
+    unsigned count_ = 0;
+
+public:
+    explicit bit_writer (std::vector<std::uint8_t>& out) : out_ (out) {}
+
+    void
+    put (std::uint32_t value, unsigned n)
+    {
+        bits_ |= std::uint64_t (value) << count_;
+        count_ += n;
+        if (count_ >= 32)
+        {
+            std::uint8_t b[4] = { std::uint8_t (bits_), std::uint8_t (bits_ >> 8),
+                                  std::uint8_t (bits_ >> 16), std::uint8_t (bits_ >> 24) };
+            out_.insert (out_.end (), b, b + 4);
+            bits_ >>= 32;
+            count_ -= 32;
+        }
+    }
+
+    void
+    flush ()
+    {
+        for (; count_ > 0; count_ = count_ > 8 ? count_ - 8 : 0, bits_ >>= 8)
+            out_.push_back (std::uint8_t (bits_));
+    }
+
+};
+
+inline std::uint32_t
+reverse (std::uint32_t code, unsigned n)
+{
+    std::uint32_t r = 0;
+    for (unsigned i = 0; i < n; ++i, code >>= 1)
+        r = (r << 1) | (code & 1);
+    return r;
+}
+
+/// Fixed Huffman literal/length code of @param sym
+inline void
+literal (bit_writer& w, unsigned sym)
+{
+    struct code { std::uint16_t bits, length; };
+    static auto const table = [] {
+        std::array<code, 288> t;
+        for (unsigned s = 0; s < 288; ++s)
+        {
+            if (s < 144)      t[s] = { std::uint16_t (reverse (0x30 + s, 8)), 8 };
+            else if (s < 256) t[s] = { std::uint16_t (reverse (0x190 + s - 144, 9)), 9 };
+            else if (s < 280) t[s] = { std::uint16_t (reverse (s - 256, 7)), 7 };
+            else              t[s] = { std::uint16_t (reverse (0xc0 + s - 280, 8)), 8 };
+        }
+        return t;
+    } ();
+    w.put (table[sym].bits, table[sym].length);
+}
+
+inline void
+match (bit_writer& w, unsigned length, unsigned distance)
+{
+    static const std::uint16_t len_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23,
+        27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const std::uint8_t len_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2,
+        2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const std::uint16_t dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65,
+        97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385,
+        24577 };
+    static const std::uint8_t dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5,
+        5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    unsigned l = 28;
+    while (len_base[l] > length) --l;
+    literal (w, 257 + l);
+    w.put (length - len_base[l], len_extra[l]);
+
+    unsigned d = 29;
+    while (dist_base[d] > distance) --d;
+    w.put (reverse (d, 5), 5); // Huffman codes go MSB first
+    w.put (distance - dist_base[d], dist_extra[d]);
+}
+
+/// Appends the zlib stream of @param data to @param out
+inline void
+deflate (std::uint8_t const* data, std::size_t size, std::vector<std::uint8_t>& out)
+{
+    constexpr unsigned hash_bits = 15, window = 32768, max_length = 258;
+    std::vector<std::uint32_t> last (1u << hash_bits, 0); // Position + 1, zero for none
+
+    out.push_back (0x78);
+    out.push_back (0x01);
+    bit_writer w (out);
+    w.put (1, 1); // Final
+    w.put (1, 2); // Fixed Huffman
+
+    std::size_t i = 0;
+    while (i + 4 <= size)
+    {
+        std::uint32_t v;
+        std::memcpy (&v, data + i, 4);
+        auto h = (v * 2654435761u) >> (32 - hash_bits);
+        auto candidate = last[h];
+        last[h] = std::uint32_t (i + 1);
+        if (candidate && i - (candidate - 1) <= window)
+        {
+            auto from = candidate - 1;
+            std::size_t n = 0, most = std::min<std::size_t> (max_length, size - i);
+            while (n < most && data[from + n] == data[i + n])
+                ++n;
+            if (n >= 4)
+            {
+                match (w, unsigned (n), unsigned (i - from));
+                i += n;
+                continue;
+            }
+        }
+        literal (w, data[i++]);
+    }
+    while (i < size)
+        literal (w, data[i++]);
+    literal (w, 256);
+    w.flush ();
+    put32 (out, adler32 (data, size));
+}
+
+} // image_codec
+
+//--------------------------------------------------------------------------------------------------
+
+/// Replaces @param out with the PNG of @param image
+inline void
+encode_png (image_view const& image, std::vector<std::uint8_t>& out)
+{
+    using namespace image_codec;
+    std::size_t const row = 1 + std::size_t (image.width) * 3;
+    std::vector<std::uint8_t> filtered (row * image.height);
+    unsigned const r = image.bgra ? 2 : 0, b = 2 - r;
+    for (unsigned y = 0; y < image.height; ++y)
+    {
+        auto src = image.pixels + std::size_t (y) * image.width * 4;
+        auto dst = &filtered[y * row];
+        *dst++ = 1; // Sub
+        std::uint8_t prev[3] = { 0, 0, 0 };
+        for (unsigned x = 0; x < image.width; ++x, src += 4)
+        {
+            std::uint8_t px[3] = { src[r], src[1], src[b] };
+            for (int c = 0; c < 3; ++c)
+                *dst++ = std::uint8_t (px[c] - prev[c]);
+            std::memcpy (prev, px, 3);
+        }
+    }
+
+    out.clear ();
+    out.reserve (filtered.size () / 8 * 9 + 1024); // Literals take at most 9 bits
+    static const std::uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    out.insert (out.end (), signature, signature + 8);
+
+    auto chunk = [&out] (const char* type, auto&& fill) {
+        auto at = out.size ();
+        put32 (out, 0);
+        out.insert (out.end (), type, type + 4);
+        fill ();
+        auto length = std::uint32_t (out.size () - at - 8);
+        for (int i = 0; i < 4; ++i)
+            out[at + i] = std::uint8_t (length >> (24 - 8 * i));
+        put32 (out, crc32 (&out[at + 4], length + 4));
+    };
+    chunk ("IHDR", [&] {
+        put32 (out, image.width);
+        put32 (out, image.height);
+        std::uint8_t rest[5] = { 8, 2, 0, 0, 0 }; // 8 bits, RGB, deflate, no interlace
+        out.insert (out.end (), rest, rest + 5);
+    });
+    chunk ("IDAT", [&] { deflate (filtered.data (), filtered.size (), out); });
+    chunk ("IEND", [] {});
+}
+
+/// Replaces @param out with the QOI of @param image
+inline void
+encode_qoi (image_view const& image, std::vector<std::uint8_t>& out)
+{
+    using namespace image_codec;
+    auto const pixels = std::size_t (image.width) * image.height;
+    out.clear ();
+    out.insert (out.end (), { 'q', 'o', 'i', 'f' });
+    put32 (out, image.width);
+    put32 (out, image.height);
+    out.push_back (3); // RGB
+    out.push_back (0); // sRGB
+    out.resize (14 + pixels * 4 + 8); // The worst case, trimmed at the end
+    auto p = &out[14];
+
+    std::uint32_t index[64] = {};
+    std::uint8_t prev[3] = { 0, 0, 0 };
+    unsigned run = 0;
+    unsigned const r = image.bgra ? 2 : 0, b = 2 - r;
+    for (std::size_t i = 0; i < pixels; ++i)
+    {
+        auto src = image.pixels + i * 4;
+        std::uint8_t px[3] = { src[r], src[1], src[b] };
+        if (px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2])
+        {
+            if (++run == 62)
+            {
+                *p++ = std::uint8_t (0xc0 | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run)
+        {
+            *p++ = std::uint8_t (0xc0 | (run - 1));
+            run = 0;
+        }
+
+        auto packed = std::uint32_t (px[0]) | std::uint32_t (px[1]) << 8
+                    | std::uint32_t (px[2]) << 16 | 0xff000000u;
+        auto slot = (px[0] * 3 + px[1] * 5 + px[2] * 7 + 255 * 11) % 64;
+        if (index[slot] == packed)
+            *p++ = std::uint8_t (slot);
+        else
+        {
+            index[slot] = packed;
+            int dr = std::int8_t (px[0] - prev[0]);
+            int dg = std::int8_t (px[1] - prev[1]);
+            int db = std::int8_t (px[2] - prev[2]);
+            int dr_dg = dr - dg, db_dg = db - dg;
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                *p++ = std::uint8_t (0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+            else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7
+                    && db_dg >= -8 && db_dg <= 7)
+            {
+                *p++ = std::uint8_t (0x80 | (dg + 32));
+                *p++ = std::uint8_t ((dr_dg + 8) << 4 | (db_dg + 8));
+            }
+            else
+            {
+                *p++ = 0xfe;
+                *p++ = px[0];
+                *p++ = px[1];
+                *p++ = px[2];
+            }
+        }
+        std::memcpy (prev, px, 3);
+    }
+    if (run)
+        *p++ = std::uint8_t (0xc0 | (run - 1));
+    static const std::uint8_t padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    std::memcpy (p, padding, 8);
+    out.resize (p + 8 - out.data ());
+}
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -30,6 +30,9 @@
 #include <gsl/span>
 
 #include <utils/winutils.hpp>
+#include "dinput_filter.hpp"
+#include "listeners.hpp"
+#include "profiler.hpp"
 
 #include <array>
 #include <string>
@@ -38,6 +41,7 @@
 #include <algorithm>
 #include <functional>
 #include <fstream>
+#include <atomic>
 
 #include <windows.h>
 #define DIRECTINPUT_VERSION 0x0800
@@ -51,7 +55,7 @@ using namespace std::string_literals;
 extern std::ofstream& log ();
 
 /// Defined in sse-gui.cpp
-extern std::string ssegui_error;
+extern thread_local std::string ssegui_error;
 
 /// Defined in sse-gui.cpp
 extern std::string sseh_error ();
@@ -59,6 +63,15 @@ extern std::string sseh_error ();
 /// Defined in skse.cpp
 extern std::unique_ptr<sseh_api> sseh;
 
+/// Defined in sse-gui.cpp
+extern std::atomic<bool> ssegui_profiling;
+
+/// Defined in trace.cpp
+extern std::atomic<bool> ssegui_tracing;
+extern void trace_keyboard (std::uint8_t const* keys);
+extern void trace_mouse (std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t const*);
+extern void trace_device_data (bool mouse, void const* items, unsigned stride, unsigned count);
+
 //--------------------------------------------------------------------------------------------------
 
 /// All in one holder of DirectInput & Co. fields
@@ -69,22 +82,20 @@ struct input_t
 
     /// DInput buffered and unbuffered
     struct {
-        bool disabled; ///< For the DInput callee (i.e. hijack)
         IDirectInputDevice8A* input;
         LPCDIDATAFORMAT data_format;
         DWORD cooperative_flags;
     } keyboard;
     /// Based on DIMOUSESTATE2
     struct {
-        bool disabled;
         IDirectInputDevice8A* input;
         LPCDIDATAFORMAT data_format;
         DWORD cooperative_flags;
     } mouse;
 
-    bool disable_dinput_key_pressed;
-    unsigned disable_dinput_key;
-    std::vector<void(SSEGUI_CCONV*)(int,int)> disable_listeners;
+    dinput_filter filter;   ///< For the DInput callee (i.e. hijack)
+    typedef listener<void(SSEGUI_CCONV*)(int,int), listener_stats> disable_listener;
+    listener_registry<disable_listener> disable_listeners;
 };
 
 /// One and only one object
@@ -109,18 +120,13 @@ mouse_callback (std::array<std::int32_t, 3> const& axes, gsl::span<std::uint8_t,
 static void
 keyboard_callback (gsl::span<std::uint8_t, 256> const& keys)
 {
-    auto const& disable = keys[di.disable_dinput_key];
-
-    if (std::exchange (di.disable_dinput_key_pressed, disable) && !disable)
+    if (di.filter.keyboard_state (keys.data ()))
     {
-        di.mouse.disabled = !di.mouse.disabled;
-        di.keyboard.disabled = !di.keyboard.disabled;
-
         void dinput_exclusive_mode (int keyboard, int mouse);
-        dinput_exclusive_mode (!di.keyboard.disabled, !di.mouse.disabled);
+        dinput_exclusive_mode (!di.filter.keyboard_disabled, !di.filter.mouse_disabled);
 
-        for (auto const& f: di.disable_listeners)
-            f (!di.keyboard.disabled, !di.mouse.disabled);
+        di.filter.notify (di.disable_listeners.read (),
+                ssegui_profiling.load (std::memory_order_relaxed));
     }
 }
 
@@ -266,22 +272,24 @@ public:
         {
             Expects (cbData == 256);
             auto callee = reinterpret_cast<std::uint8_t*> (lpvData);
+            if (ssegui_tracing.load (std::memory_order_relaxed))
+                trace_keyboard (callee);
             keyboard_callback (gsl::make_span (callee, cbData));
-
-            if (di.keyboard.disabled)
-                std::fill_n (callee, cbData, 0);
+            di.filter.filter_keyboard (callee, cbData);
         }
         else
         {
             Expects (cbData == sizeof (DIMOUSESTATE2));
             auto callee = reinterpret_cast<DIMOUSESTATE2*> (lpvData);
             static_assert (sizeof (callee->rgbButtons) / sizeof (callee->rgbButtons[0]) == 8, "!");
+            if (ssegui_tracing.load (std::memory_order_relaxed))
+                trace_mouse (callee->lX, callee->lY, callee->lZ, callee->rgbButtons);
 
             mouse_callback (
                     { callee->lX, callee->lY, callee->lZ },
                     gsl::make_span (callee->rgbButtons, 8));
 
-            if (di.mouse.disabled)
+            if (di.filter.mouse_disabled)
                 *callee = DIMOUSESTATE2 {};
         }
 
@@ -297,10 +305,12 @@ public:
             auto hres = p->GetDeviceState (raw.size (), raw.data ());
             if (hres == DI_OK)
             {
+                if (ssegui_tracing.load (std::memory_order_relaxed))
+                    trace_keyboard (raw.data ());
                 keyboard_callback (raw);
             }
 
-            if (di.keyboard.disabled)
+            if (di.filter.keyboard_disabled)
             {
                 DWORD dwItems = INFINITE;
                 hres = p->GetDeviceData (sizeof (DIDEVICEOBJECTDATA), nullptr, &dwItems, 0);
@@ -310,7 +320,10 @@ public:
         }
         // Mouse case looks unused
 
-        return p->GetDeviceData (cbObjectData, rgdod, pdwInOut, dwFlags);
+        auto hres = p->GetDeviceData (cbObjectData, rgdod, pdwInOut, dwFlags);
+        if (SUCCEEDED (hres) && rgdod && ssegui_tracing.load (std::memory_order_relaxed))
+            trace_device_data (!Keyboard, rgdod, cbObjectData, *pdwInOut);
+        return hres;
     }
 };
 
@@ -430,20 +443,23 @@ detour_dinput ()
 bool
 keyboard_enable (bool* optional)
 {
-    return !std::exchange (di.keyboard.disabled, optional ? !*optional : di.keyboard.disabled);
+    auto& d = di.filter.keyboard_disabled;
+    return !std::exchange (d, optional ? !*optional : d);
 }
 
 bool
 mouse_enable (bool* optional)
 {
-    return !std::exchange (di.mouse.disabled, optional ? !*optional : di.mouse.disabled);
+    auto& d = di.filter.mouse_disabled;
+    return !std::exchange (d, optional ? !*optional : d);
 }
 
 unsigned
 dinput_disable_key (unsigned* optional)
 {
     Expects (!optional || *optional < 256);
-    return std::exchange (di.disable_dinput_key, optional ? *optional : di.disable_dinput_key);
+    auto& k = di.filter.disable_key;
+    return std::exchange (k, optional ? *optional : k);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -452,10 +468,26 @@ void
 update_disable_listener (void* callback, bool remove)
 {
     Expects (callback);
-    if (update_listener (di.disable_listeners, callback, remove))
+    input_t::disable_listener l = {
+        reinterpret_cast<decltype (input_t::disable_listener::callback)> (callback),
+        std::make_shared<listener_stats> () };
+    l.info->name = module_name (callback) + "!" + hex_string (callback);
+    if (di.disable_listeners.update (l, remove))
         log () << "Disable callback " << callback << (remove ? " removed.":" added.") << std::endl;
 }
 
+/// Profiler statistics of the control listeners, @see ssegui_execute ("stats")
+
+void
+input_stats (nlohmann::json& json)
+{
+    di.disable_listeners.inspect ([&json] (auto const& list) {
+        auto& a = json["control"] = nlohmann::json::array ();
+        for (auto const& l: list)
+            a.push_back (*l.info);
+    });
+}
+
 //--------------------------------------------------------------------------------------------------
 
 void
@@ -0,0 +1,194 @@
+/**
+ * @file input_batch.hpp
+ * @brief Per frame buffer of coalesced input events
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The window thread pushes the input messages as they come, Present takes all of them once per
+ * frame. A motion (mouse move, wheel, relative raw motion) is merged into the last motion of the
+ * same message, unless an edge (click, key, character...) came in between. So a run of moves
+ * between two clicks becomes one event per message, while the edges keep their place. The two
+ * threads may differ, or not, so the buffer is behind a mutex - held for a push_back or a swap,
+ * never contended for long.
+ *
+ * When Present does not come (loading screens, minimized) the buffer stops growing at
+ * #max_events, the newer events are dropped and counted.
+ *
+ * The raw input data behind WM_INPUT is decoded by the caller of input_event(), so the batching
+ * takes plain message parameters, as bench_input_batch makes up.
+ */
+
+#ifndef SSEGUI_INPUT_BATCH_HPP
+#define SSEGUI_INPUT_BATCH_HPP
+
+#include <sse-gui/sse-gui.h>
+#include "message_dispatch.hpp"
+#include "profiler.hpp"
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * The input message as a batch event at @param time, @returns false if it is none. WM_INPUT is
+ * left to @param raw (e, motion), @see input_batch::push()
+ */
+
+template<class Raw>
+inline bool
+input_event (unsigned msg, std::uintptr_t wParam, std::intptr_t lParam, std::uint64_t time,
+        ssegui_input_event& e, bool& motion, Raw&& raw)
+{
+    e = { msg, 1, wParam, lParam, 0, 0, time };
+    motion = false;
+    switch (msg)
+    {
+        case 0x0200: // WM_MOUSEMOVE
+            motion = true;
+            return true;
+        case 0x020A: // WM_MOUSEWHEEL, the delta in the high word
+            motion = true;
+            e.dy = short (wParam >> 16);
+            return true;
+        case 0x020E: // WM_MOUSEHWHEEL
+            motion = true;
+            e.dx = short (wParam >> 16);
+            return true;
+        case 0x00FF: // WM_INPUT
+            return raw (e, motion);
+    }
+    return message_class (msg) & (SSEGUI_MESSAGE_KEYBOARD
+            | SSEGUI_MESSAGE_MOUSE_MOVE | SSEGUI_MESSAGE_MOUSE_BUTTON);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+class input_batch
+{
+    std::mutex mutex_;
+    std::vector<ssegui_input_event> events_;
+    std::array<std::pair<unsigned, std::uint32_t>, 4> motions_;    ///< Message and event index
+    unsigned motion_count_ = 0; ///< Since the last edge
+
+public:
+    static constexpr std::size_t max_events = 4096;
+
+    std::atomic<std::uint64_t> messages { 0 };  ///< Pushed
+    std::atomic<std::uint64_t> events { 0 };    ///< Taken, after coalescing
+    std::atomic<std::uint64_t> batches { 0 };   ///< Taken non-empty
+    std::atomic<std::uint64_t> dropped { 0 };   ///< Over #max_events
+
+    /// Window thread, @param motion tells whether @param e can be merged with others
+
+    void
+    push (ssegui_input_event const& e, bool motion)
+    {
+        relaxed_add (messages);
+        std::lock_guard<std::mutex> lock (mutex_);
+        for (unsigned i = 0; motion && i < motion_count_; ++i)
+        {
+            if (motions_[i].first != e.msg)
+                continue;
+            auto& b = events_[motions_[i].second];
+            b.count += e.count;
+            b.wParam = e.wParam;
+            b.lParam = e.lParam;
+            b.dx += e.dx;
+            b.dy += e.dy;
+            b.time = e.time;
+            return;
+        }
+        if (events_.size () >= max_events)
+        {
+            relaxed_add (dropped);
+            motion_count_ = 0;
+            return;
+        }
+        if (!motion)
+            motion_count_ = 0;
+        else if (motion_count_ < motions_.size ())
+            motions_[motion_count_++] = { e.msg, std::uint32_t (events_.size ()) };
+        events_.push_back (e);
+    }
+
+    /**
+     * Present thread, moves out what got pushed since the last time into @param out, which gets
+     * the storage of the next frame in exchange. @returns whether there is anything.
+     */
+
+    bool
+    take (std::vector<ssegui_input_event>& out)
+    {
+        out.clear ();
+        {
+            std::lock_guard<std::mutex> lock (mutex_);
+            events_.swap (out);
+            motion_count_ = 0;
+        }
+        if (out.empty ())
+            return false;
+        relaxed_add (events, std::uint64_t (out.size ()));
+        relaxed_add (batches);
+        return true;
+    }
+
+    /**
+     * Present thread, takes into @param frame and calls each of @param listeners with it, timed
+     * if @param profile. @returns whether there was anything.
+     */
+
+    template<class List>
+    bool
+    deliver (std::vector<ssegui_input_event>& frame, List const& listeners, bool profile)
+    {
+        if (!take (frame))
+            return false;
+        auto data = frame.data ();
+        int size = int (frame.size ());
+        for (auto const& l: listeners)
+        {
+            cost_timer t (profile ? &l.info->cost : nullptr);
+            l.callback (data, size);
+        }
+        return true;
+    }
+
+    /// Any thread, e.g. when no one listens anymore
+
+    void
+    clear ()
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+        events_.clear ();
+        motion_count_ = 0;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,341 @@
+/**
+ * @file input_trace.hpp
+ * @brief Binary trace of the window messages and the DirectInput states, as the game saw them
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * A trace file starts with #trace_magic and the profiler clock at the start of the recording,
+ * followed by records of a type byte, a size byte, the time in nanoseconds since the start and
+ * that many bytes of payload. All little endian, as on the machines the game runs on:
+ *
+ * * message - uint32 identifier, uint64 wParam, int64 lParam
+ * * keyboard - 32 bytes, a bit per key pressed in the 256 bytes DirectInput state
+ * * mouse - int32 x, y and z axes, a byte with a bit per button pressed
+ * * device data - a device byte (0 keyboard, 1 mouse), up to two buffered items of uint32 offset,
+ *   data, time stamp and sequence each
+ * * dropped - uint64 records lost before this one, as the ring was full
+ *
+ * The recording threads (window, input polling) push fixed size records into a bounded lock-free
+ * ring, Vyukov's multiple producer one, with a sequence per slot. A push is a few atomics and a
+ * 64 bytes copy, it never blocks nor allocates - when the writer is behind the record is dropped
+ * and counted. One writer thread pops them and appends to the file.
+ *
+ * The format and the ring use the standard library only: trace_dump and replay read the files
+ * offline, away from the game.
+ */
+
+#ifndef SSEGUI_INPUT_TRACE_HPP
+#define SSEGUI_INPUT_TRACE_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+/// File signature, the last character being the format version
+static constexpr char trace_magic[8] = { 'S', 'S', 'E', 'G', 'T', 'R', 'C', '1' };
+
+enum class trace_kind : std::uint8_t
+{
+    message = 1,
+    keyboard,
+    mouse,
+    device_data,
+    dropped
+};
+
+struct trace_record
+{
+    std::uint64_t time;         ///< Profiler clock in the ring, since the start in the file
+    trace_kind kind;
+    std::uint8_t size;          ///< Of the payload
+    std::uint8_t data[46];
+};
+
+/// Type and size, then the time
+static constexpr std::size_t trace_header_size = 10;
+
+/// One buffered DIDEVICEOBJECTDATA, without the application data
+struct trace_device_item
+{
+    std::uint32_t offset, data, time, sequence;
+};
+
+struct trace_message
+{
+    unsigned msg;
+    std::uint64_t wParam;
+    std::int64_t lParam;
+};
+
+struct trace_mouse
+{
+    std::int32_t x, y, z;
+    std::uint8_t buttons;       ///< Bit per button
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Appends @param v to the payload of @param r
+template<class T>
+inline void
+trace_put (trace_record& r, T v) noexcept
+{
+    std::memcpy (r.data + r.size, &v, sizeof (T));
+    r.size += sizeof (T);
+}
+
+/// Reads at @param at from the payload of @param r, which must be large enough
+template<class T>
+inline T
+trace_get (trace_record const& r, unsigned at) noexcept
+{
+    T v;
+    std::memcpy (&v, r.data + at, sizeof (T));
+    return v;
+}
+
+inline trace_record
+make_trace_message (std::uint64_t time, unsigned msg, std::uint64_t wParam, std::int64_t lParam)
+{
+    trace_record r = { time, trace_kind::message, 0, {} };
+    trace_put (r, std::uint32_t (msg));
+    trace_put (r, wParam);
+    trace_put (r, lParam);
+    return r;
+}
+
+/// Of the 256 bytes DirectInput keyboard state @param keys
+inline trace_record
+make_trace_keyboard (std::uint64_t time, std::uint8_t const* keys)
+{
+    trace_record r = { time, trace_kind::keyboard, 32, {} };
+    for (unsigned k = 0; k < 256; ++k)
+        r.data[k / 8] |= (keys[k] >> 7) << (k % 8);
+    return r;
+}
+
+/// Of the DIMOUSESTATE2 axes and its 8 @param buttons
+inline trace_record
+make_trace_mouse (std::uint64_t time, std::int32_t x, std::int32_t y, std::int32_t z,
+        std::uint8_t const* buttons)
+{
+    trace_record r = { time, trace_kind::mouse, 0, {} };
+    trace_put (r, x);
+    trace_put (r, y);
+    trace_put (r, z);
+    std::uint8_t pressed = 0;
+    for (unsigned b = 0; b < 8; ++b)
+        pressed |= (buttons[b] >> 7) << b;
+    trace_put (r, pressed);
+    return r;
+}
+
+/// Of at most two @param items
+inline trace_record
+make_trace_device_data (std::uint64_t time, bool mouse, trace_device_item const* items,
+        unsigned count)
+{
+    trace_record r = { time, trace_kind::device_data, 0, {} };
+    trace_put (r, std::uint8_t (mouse));
+    for (unsigned i = 0; i < std::min (count, 2u); ++i)
+    {
+        trace_put (r, items[i].offset);
+        trace_put (r, items[i].data);
+        trace_put (r, items[i].time);
+        trace_put (r, items[i].sequence);
+    }
+    return r;
+}
+
+inline trace_record
+make_trace_dropped (std::uint64_t time, std::uint64_t count)
+{
+    trace_record r = { time, trace_kind::dropped, 0, {} };
+    trace_put (r, count);
+    return r;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+inline trace_message
+read_trace_message (trace_record const& r) noexcept
+{
+    return { trace_get<std::uint32_t> (r, 0),
+             trace_get<std::uint64_t> (r, 4),
+             trace_get<std::int64_t> (r, 12) };
+}
+
+/// Whether key @param k was pressed in a keyboard record
+inline bool
+trace_key (trace_record const& r, unsigned k) noexcept
+{
+    return (r.data[k / 8] >> (k % 8)) & 1;
+}
+
+inline trace_mouse
+read_trace_mouse (trace_record const& r) noexcept
+{
+    return { trace_get<std::int32_t> (r, 0),
+             trace_get<std::int32_t> (r, 4),
+             trace_get<std::int32_t> (r, 8),
+             r.data[12] };
+}
+
+/// Of a device data record, @returns the count of @param items, at most two
+inline unsigned
+read_trace_device_data (trace_record const& r, bool& mouse, trace_device_item* items) noexcept
+{
+    mouse = r.data[0];
+    unsigned n = r.size ? std::min ((r.size - 1u) / 16u, 2u) : 0;
+    for (unsigned i = 0; i < n; ++i)
+        items[i] = { trace_get<std::uint32_t> (r, 1 + i * 16),
+                     trace_get<std::uint32_t> (r, 5 + i * 16),
+                     trace_get<std::uint32_t> (r, 9 + i * 16),
+                     trace_get<std::uint32_t> (r, 13 + i * 16) };
+    return n;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Appends @param r as stored in the file to @param out
+inline void
+trace_encode (trace_record const& r, std::vector<std::uint8_t>& out)
+{
+    auto at = out.size ();
+    out.resize (at + trace_header_size + r.size);
+    out[at] = std::uint8_t (r.kind);
+    out[at + 1] = r.size;
+    std::memcpy (&out[at + 2], &r.time, sizeof (r.time));
+    std::memcpy (&out[at + trace_header_size], r.data, r.size);
+}
+
+/**
+ * Reads a whole trace file @param f into @param records, @param start receives the profiler
+ * clock at its start. @returns false if it is not a trace, or is cut short - all complete
+ * records are read still.
+ */
+
+inline bool
+trace_load (std::FILE* f, std::vector<trace_record>& records, std::uint64_t& start)
+{
+    char magic[sizeof (trace_magic)];
+    if (std::fread (magic, 1, sizeof (magic), f) != sizeof (magic)
+            || std::memcmp (magic, trace_magic, sizeof (magic))
+            || std::fread (&start, sizeof (start), 1, f) != 1)
+        return false;
+
+    std::uint8_t header[trace_header_size];
+    while (std::fread (header, 1, sizeof (header), f) == sizeof (header))
+    {
+        trace_record r = {};
+        r.kind = trace_kind (header[0]);
+        r.size = header[1];
+        std::memcpy (&r.time, header + 2, sizeof (r.time));
+        if (r.size > sizeof (r.data) || std::fread (r.data, 1, r.size, f) != r.size)
+            return false;
+        records.push_back (r);
+    }
+    return std::feof (f);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Bounded, many threads push, one pops. @param Slots is a power of two.
+
+template<unsigned Slots>
+class trace_ring
+{
+    static_assert (Slots && !(Slots & (Slots - 1)), "power of two");
+
+    struct alignas (64) slot
+    {
+        std::atomic<std::uint64_t> sequence;
+        trace_record record;
+    };
+
+    std::unique_ptr<slot[]> slots_;
+    alignas (64) std::atomic<std::uint64_t> head_ { 0 };  ///< Next to push
+    alignas (64) std::uint64_t tail_ = 0;                 ///< Next to pop
+
+public:
+    alignas (64) std::atomic<std::uint64_t> pushed { 0 };
+    std::atomic<std::uint64_t> dropped { 0 };   ///< While full
+
+    trace_ring () : slots_ (new slot[Slots])
+    {
+        for (unsigned i = 0; i < Slots; ++i)
+            slots_[i].sequence.store (i, std::memory_order_relaxed);
+    }
+
+    /// Any thread, @returns false if full, the record is dropped then
+    bool
+    push (trace_record const& r) noexcept
+    {
+        auto pos = head_.load (std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& s = slots_[pos & (Slots - 1)];
+            auto diff = std::int64_t (s.sequence.load (std::memory_order_acquire) - pos);
+            if (!diff)
+            {
+                if (head_.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed))
+                {
+                    s.record = r;
+                    s.sequence.store (pos + 1, std::memory_order_release);
+                    pushed.fetch_add (1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                dropped.fetch_add (1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+                pos = head_.load (std::memory_order_relaxed);
+        }
+    }
+
+    /// The one consumer thread, @returns false if empty
+    bool
+    pop (trace_record& r) noexcept
+    {
+        auto& s = slots_[tail_ & (Slots - 1)];
+        if (std::int64_t (s.sequence.load (std::memory_order_acquire) - (tail_ + 1)) < 0)
+            return false;
+        r = s.record;
+        s.sequence.store (tail_ + Slots, std::memory_order_release);
+        ++tail_;
+        return true;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,514 @@
+/**
+ * @file layers.cpp
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Public API
+ *
+ * @details
+ * Retained overlay layers: each one is painted into its own texture only when dirty and all of
+ * them are composited onto the back buffer on each Present. The composition draws a full screen
+ * triangle per layer, scissored to the area the layer has ever painted, so an idle layer costs one
+ * small draw call.
+ */
+
+#include <sse-gui/sse-gui.h>
+#include <gsl/gsl_util>
+
+#include <utils/winutils.hpp>
+#include "listeners.hpp"
+#include "profiler.hpp"
+
+#include <mutex>
+#include <string>
+#include <memory>
+#include <vector>
+#include <climits>
+#include <utility>
+#include <algorithm>
+#include <fstream>
+#include <atomic>
+
+#include <windows.h>
+#include <d3d11.h>
+
+//--------------------------------------------------------------------------------------------------
+
+using namespace std::string_literals;
+
+/// Opened from within skse.cpp
+extern std::ofstream& log ();
+
+/// Defined in sse-gui.cpp
+extern thread_local std::string ssegui_error;
+
+/// Defined in sse-gui.cpp
+extern std::atomic<bool> ssegui_profiling;
+
+/// Defined in shaders.cpp
+extern ID3DBlob* compile_shader (std::string const& source, const char* entry, const char* target);
+
+//--------------------------------------------------------------------------------------------------
+
+static ssegui_rect const no_rect = { 0, 0, 0, 0 };
+static ssegui_rect const all_rect = { 0, 0, INT_MAX, INT_MAX };
+
+static inline bool
+empty (ssegui_rect const& r)
+{
+    return r.left >= r.right || r.top >= r.bottom;
+}
+
+/// Bounding rectangle of both
+static inline ssegui_rect
+merge (ssegui_rect const& a, ssegui_rect const& b)
+{
+    if (empty (a)) return b;
+    if (empty (b)) return a;
+    return { std::min (a.left, b.left), std::min (a.top, b.top),
+             std::max (a.right, b.right), std::max (a.bottom, b.bottom) };
+}
+
+static inline ssegui_rect
+clip (ssegui_rect const& r, UINT width, UINT height)
+{
+    ssegui_rect c = { std::max (r.left, 0), std::max (r.top, 0),
+        std::min (r.right, int (width)), std::min (r.bottom, int (height)) };
+    return empty (c) ? no_rect : c;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Bookkeeping of each layer, the D3D objects are touched only by the render thread
+
+struct layer_info : listener_stats
+{
+    std::atomic<int> z;
+    std::atomic<float> opacity;
+    std::atomic<bool> visible;
+
+    std::mutex mutex;
+    ssegui_rect dirty;          ///< Guarded by the mutex
+
+    ssegui_rect content;        ///< Painted so far, composited on each frame
+    UINT width, height;
+    ID3D11Texture2D* texture;
+    ID3D11RenderTargetView* target;
+    ID3D11ShaderResourceView* view;
+
+    layer_info ()
+        : z (0), opacity (1), visible (true), dirty (all_rect), content (no_rect)
+        , width (0), height (0), texture (nullptr), target (nullptr), view (nullptr) {}
+
+    ~layer_info () { release (); }
+
+    void
+    release ()
+    {
+        if (view) std::exchange (view, nullptr)->Release ();
+        if (target) std::exchange (target, nullptr)->Release ();
+        if (texture) std::exchange (texture, nullptr)->Release ();
+        width = height = 0;
+    }
+};
+
+/// All in one holder of the layers fields
+struct layers_t
+{
+    typedef listener<void(SSEGUI_CCONV*)(void*,void*,ssegui_rect const*), layer_info> layer;
+    listener_registry<layer> list;
+
+    bool failed;                ///< Do not retry creating the shaders each frame
+    ID3D11VertexShader* vertex_shader;
+    ID3D11PixelShader* composite_shader;
+    ID3D11PixelShader* clear_shader;
+    ID3D11BlendState* premultiplied;
+    ID3D11BlendState* overwrite;
+    ID3D11RasterizerState* scissored;
+    ID3D11Buffer* constants;
+
+    std::vector<layer const*> order; ///< Render thread only, reused every frame
+};
+
+/// One and only one object
+static layers_t layers = {};
+
+//--------------------------------------------------------------------------------------------------
+
+static const char* shader_source = R"(
+cbuffer layer : register(b0)
+{
+    float opacity;
+};
+
+Texture2D content : register(t0);
+
+float4 vs_main (uint id : SV_VertexID) : SV_Position
+{
+    float2 uv = float2 ((id << 1) & 2, id & 2);
+    return float4 (uv * float2 (2, -2) + float2 (-1, 1), 0, 1);
+}
+
+float4 ps_composite (float4 position : SV_Position) : SV_Target
+{
+    return content.Load (int3 (position.xy, 0)) * opacity;
+}
+
+float4 ps_clear (float4 position : SV_Position) : SV_Target
+{
+    return 0;
+}
+)";
+
+static void
+release_objects ()
+{
+    IUnknown** objects[] = {
+        (IUnknown**) &layers.vertex_shader, (IUnknown**) &layers.composite_shader,
+        (IUnknown**) &layers.clear_shader, (IUnknown**) &layers.premultiplied,
+        (IUnknown**) &layers.overwrite, (IUnknown**) &layers.scissored,
+        (IUnknown**) &layers.constants };
+    for (auto o: objects)
+        if (*o) std::exchange (*o, nullptr)->Release ();
+}
+
+/// Shaders & states, once for the tracked device
+
+static bool
+setup_layers (ID3D11Device* device)
+{
+    if (layers.vertex_shader)
+        return true;
+    if (layers.failed)
+        return false;
+    layers.failed = true;
+
+    ID3DBlob* vs = compile_shader (shader_source, "vs_main", "vs_5_0");
+    ID3DBlob* composite = vs ? compile_shader (shader_source, "ps_composite", "ps_5_0") : nullptr;
+    ID3DBlob* clear = composite ? compile_shader (shader_source, "ps_clear", "ps_5_0") : nullptr;
+    auto release_blobs = gsl::finally ([&] {
+        for (auto b: { vs, composite, clear })
+            if (b) b->Release ();
+    });
+    if (!clear)
+    {
+        log () << "Layers shaders: " << ssegui_error << std::endl;
+        return false;
+    }
+
+    D3D11_BLEND_DESC blend = {};
+    blend.RenderTarget[0].BlendEnable = TRUE;
+    blend.RenderTarget[0].SrcBlend = blend.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+    blend.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+    blend.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+    blend.RenderTarget[0].BlendOp = blend.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    blend.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+    D3D11_BLEND_DESC blend_off = blend;
+    blend_off.RenderTarget[0].BlendEnable = FALSE;
+
+    D3D11_RASTERIZER_DESC raster = {};
+    raster.FillMode = D3D11_FILL_SOLID;
+    raster.CullMode = D3D11_CULL_NONE;
+    raster.ScissorEnable = TRUE;
+
+    D3D11_BUFFER_DESC constants = {};
+    constants.ByteWidth = 16;
+    constants.Usage = D3D11_USAGE_DEFAULT;
+    constants.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+    if (device->CreateVertexShader (vs->GetBufferPointer (), vs->GetBufferSize (), nullptr,
+                &layers.vertex_shader) != S_OK
+        || device->CreatePixelShader (composite->GetBufferPointer (),
+                composite->GetBufferSize (), nullptr, &layers.composite_shader) != S_OK
+        || device->CreatePixelShader (clear->GetBufferPointer (), clear->GetBufferSize (),
+                nullptr, &layers.clear_shader) != S_OK
+        || device->CreateBlendState (&blend, &layers.premultiplied) != S_OK
+        || device->CreateBlendState (&blend_off, &layers.overwrite) != S_OK
+        || device->CreateRasterizerState (&raster, &layers.scissored) != S_OK
+        || device->CreateBuffer (&constants, nullptr, &layers.constants) != S_OK)
+    {
+        log () << "Layers setup failed." << std::endl;
+        release_objects ();
+        return false;
+    }
+
+    layers.failed = false;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// (Re)creates the texture when the back buffer size changes
+
+static bool
+layer_texture (ID3D11Device* device, layer_info& info, UINT width, UINT height)
+{
+    if (info.texture && info.width == width && info.height == height)
+        return true;
+    info.release ();
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = width;
+    desc.Height = height;
+    desc.MipLevels = desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+    if (device->CreateTexture2D (&desc, nullptr, &info.texture) != S_OK
+            || device->CreateRenderTargetView (info.texture, nullptr, &info.target) != S_OK
+            || device->CreateShaderResourceView (info.texture, nullptr, &info.view) != S_OK)
+    {
+        info.release ();
+        return false;
+    }
+
+    info.width = width;
+    info.height = height;
+    info.content = no_rect;
+    std::lock_guard<std::mutex> lock (info.mutex);
+    info.dirty = all_rect;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Common state for painting into a layer and compositing it
+
+static void
+bind_pipeline (ID3D11DeviceContext* context, UINT width, UINT height)
+{
+    D3D11_VIEWPORT viewport = { 0, 0, float (width), float (height), 0, 1 };
+    context->RSSetViewports (1, &viewport);
+    context->RSSetState (layers.scissored);
+    context->IASetInputLayout (nullptr);
+    context->IASetPrimitiveTopology (D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    context->VSSetShader (layers.vertex_shader, nullptr, 0);
+    context->GSSetShader (nullptr, nullptr, 0);
+    context->HSSetShader (nullptr, nullptr, 0);
+    context->DSSetShader (nullptr, nullptr, 0);
+}
+
+static void
+set_scissor (ID3D11DeviceContext* context, ssegui_rect const& r)
+{
+    D3D11_RECT rect = { r.left, r.top, r.right, r.bottom };
+    context->RSSetScissorRects (1, &rect);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Render thread, whether there is any layer, so chain_present() can save its state
+
+bool
+any_layers ()
+{
+    return !layers.list.read ().empty ();
+}
+
+/// Render thread, the tracked device is replaced: the layers get repainted on the new one
+
+void
+layers_device_reset ()
+{
+    release_objects ();
+    layers.failed = false;
+    layers.list.inspect ([] (auto const& list) {
+        for (auto const& l: list)
+            l.info->release (); // Recreated and fully dirty on the next composite
+    });
+}
+
+/// Any thread, unlike #any_layers()
+
+bool
+layers_registered ()
+{
+    bool any = false;
+    layers.list.inspect ([&any] (auto const& l) { any = !l.empty (); });
+    return any;
+}
+
+/// Render thread, repaint the dirty layers and composite all onto @param back_buffer
+
+void
+composite_layers (ID3D11Device* device, ID3D11DeviceContext* context,
+        ID3D11RenderTargetView* back_buffer, UINT width, UINT height)
+{
+    if (!setup_layers (device))
+        return;
+
+    bool profile = ssegui_profiling.load (std::memory_order_relaxed);
+    auto list = layers.list.read ();
+
+    layers.order.clear ();
+    for (auto const& l: list)
+        if (l.info->visible.load (std::memory_order_relaxed))
+            layers.order.push_back (&l);
+    std::stable_sort (layers.order.begin (), layers.order.end (), [] (auto a, auto b) {
+        return a->info->z.load (std::memory_order_relaxed)
+             < b->info->z.load (std::memory_order_relaxed);
+    });
+
+    for (auto l: layers.order)
+    {
+        auto& info = *l->info;
+        if (!layer_texture (device, info, width, height))
+            continue;
+
+        ssegui_rect dirty;
+        {
+            std::lock_guard<std::mutex> lock (info.mutex);
+            dirty = clip (std::exchange (info.dirty, no_rect), width, height);
+        }
+        if (empty (dirty))
+            continue;
+        info.content = merge (info.content, dirty);
+
+        // The dirty part is cleared by drawing, ClearRenderTargetView does not respect scissors
+        bind_pipeline (context, width, height);
+        set_scissor (context, dirty);
+        context->OMSetRenderTargets (1, &info.target, nullptr);
+        context->OMSetBlendState (layers.overwrite, nullptr, 0xffffffff);
+        context->PSSetShader (layers.clear_shader, nullptr, 0);
+        context->Draw (3, 0);
+
+        cost_timer t (profile ? &info.cost : nullptr);
+        l->callback (context, info.target, &dirty);
+    }
+
+    bind_pipeline (context, width, height);
+    context->OMSetRenderTargets (1, &back_buffer, nullptr);
+    context->OMSetBlendState (layers.premultiplied, nullptr, 0xffffffff);
+    context->PSSetShader (layers.composite_shader, nullptr, 0);
+    context->PSSetConstantBuffers (0, 1, &layers.constants);
+
+    for (auto l: layers.order)
+    {
+        auto& info = *l->info;
+        float opacity[4] = { info.opacity.load (std::memory_order_relaxed) };
+        if (!info.view || empty (info.content) || opacity[0] <= 0)
+            continue;
+        context->UpdateSubresource (layers.constants, 0, nullptr, opacity, 0, 0);
+        context->PSSetShaderResources (0, 1, &info.view);
+        set_scissor (context, info.content);
+        context->Draw (3, 0);
+    }
+
+    ID3D11ShaderResourceView* none = nullptr;
+    context->PSSetShaderResources (0, 1, &none);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+void
+update_layer_listener (void* callback, bool remove)
+{
+    Expects (callback);
+    layers_t::layer l = {
+        reinterpret_cast<decltype (layers_t::layer::callback)> (callback),
+        std::make_shared<layer_info> () };
+    l.info->name = module_name (callback) + "!" + hex_string (callback);
+    if (layers.list.update (l, remove))
+    {
+        log () << "Layer callback " << callback << (remove ? " removed.":" added.") << std::endl;
+        extern void sync_hooks ();
+        sync_hooks ();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Bookkeeping of an already registered layer, or nullptr
+
+static std::shared_ptr<layer_info>
+find_layer_info (void* callback)
+{
+    auto f = reinterpret_cast<decltype (layers_t::layer::callback)> (callback);
+    std::shared_ptr<layer_info> info;
+    layers.list.inspect ([f, &info] (auto const& list) {
+        auto it = std::find_if (list.cbegin (), list.cend (),
+                [f] (auto const& l) { return l.callback == f; });
+        if (it != list.cend ())
+            info = it->info;
+    });
+    if (!info)
+        ssegui_error = "No such layer "s + hex_string (callback);
+    return info;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @see #ssegui_layer_state()
+
+bool
+layer_state (void* callback, ssegui_layer const* set, ssegui_layer* get)
+{
+    ssegui_error.clear ();
+    auto info = find_layer_info (callback);
+    if (!info)
+        return false;
+
+    if (get)
+    {
+        get->z = info->z.load ();
+        get->opacity = info->opacity.load ();
+        get->visible = info->visible.load ();
+    }
+    if (set)
+    {
+        info->z = set->z;
+        info->opacity = std::min (std::max (set->opacity, 0.f), 1.f);
+        info->visible = set->visible != 0;
+    }
+    return true;
+}
+
+/// @see #ssegui_layer_invalidate()
+
+bool
+layer_invalidate (void* callback, ssegui_rect const* rect)
+{
+    ssegui_error.clear ();
+    auto info = find_layer_info (callback);
+    if (!info)
+        return false;
+
+    std::lock_guard<std::mutex> lock (info->mutex);
+    info->dirty = rect ? merge (info->dirty, *rect) : all_rect;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Profiler statistics of the layers paint, @see ssegui_execute ("stats")
+
+void
+layer_stats (nlohmann::json& json)
+{
+    layers.list.inspect ([&json] (auto const& list) {
+        auto& a = json["layer"] = nlohmann::json::array ();
+        for (auto const& l: list)
+            a.push_back (static_cast<listener_stats const&> (*l.info));
+    });
+}
+
+//--------------------------------------------------------------------------------------------------
+
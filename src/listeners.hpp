@@ -0,0 +1,236 @@
+/**
+ * @file listeners.hpp
+ * @brief Copy-on-write registry of listener callbacks
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The render, message and control listeners are dispatched from the game threads (Present, the
+ * window procedure and DInput), while the plugins may register or remove them from any thread.
+ * Hence, the registry publishes immutable snapshots: the dispatching thread pays one acquire load
+ * per dispatch, while the writers serialize among themselves, copy the current array, publish
+ * the new one and retire the old. Retired arrays are freed by the dispatching thread once it
+ * leaves the outermost dispatch (quiescent state), so a listener can safely remove itself, or
+ * others, while being called.
+ *
+ * There is only one dispatching thread per registry. Nested dispatches on it (e.g. a window
+ * message sent from within a message listener) are fine.
+ *
+ * The list type is a std::vector by default. Others, deriving from it, may keep an index of their
+ * content, rebuilt by list_changed() on each publish - e.g. the per message table of the message
+ * listeners, @see message_dispatch.hpp.
+ *
+ * The callbacks are only compared and copied, so bench_listeners registers plain function pointers.
+ */
+
+#ifndef SSEGUI_LISTENERS_HPP
+#define SSEGUI_LISTENERS_HPP
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Nothing to rebuild on plain lists
+template<class T>
+inline void
+list_changed (std::vector<T>&) noexcept
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+
+template<class T, class List = std::vector<T>>
+class listener_registry
+{
+public:
+    typedef T value_type;
+    typedef List list_type;
+
+private:
+    struct snapshot
+    {
+        list_type list;
+        snapshot* retired_next;
+    };
+
+    std::atomic<snapshot*> current_;
+    std::atomic<snapshot*> retired_;
+    std::mutex writers_;
+    unsigned depth_; ///< Touched only by the dispatching thread
+
+    void
+    retire (snapshot* s) noexcept
+    {
+        s->retired_next = retired_.load (std::memory_order_relaxed);
+        while (!retired_.compare_exchange_weak (s->retired_next, s,
+                    std::memory_order_release, std::memory_order_relaxed))
+            ;
+    }
+
+    static void
+    free_chain (snapshot* s) noexcept
+    {
+        while (s)
+            delete std::exchange (s, s->retired_next);
+    }
+
+    /// Generic copy, change and publish for all writers (sort of RCU)
+    template<class Change>
+    bool
+    publish (Change&& change)
+    {
+        std::lock_guard<std::mutex> lock (writers_);
+        auto old = current_.load (std::memory_order_relaxed);
+        std::unique_ptr<snapshot> next (new snapshot { old->list, nullptr });
+        if (!change (next->list))
+            return false;
+        list_changed (next->list);
+        current_.store (next.release (), std::memory_order_release);
+        retire (old);
+        return true;
+    }
+
+public:
+    listener_registry ()
+        : current_ (new snapshot {}), retired_ (nullptr), depth_ (0) {}
+
+    ~listener_registry ()
+    {
+        free_chain (retired_.load (std::memory_order_acquire));
+        delete current_.load (std::memory_order_acquire);
+    }
+
+    listener_registry (listener_registry const&) = delete;
+    listener_registry& operator= (listener_registry const&) = delete;
+
+    /// RAII scope of one dispatch on the dispatching thread, the list is valid until destroyed.
+
+    class reader
+    {
+        listener_registry& r;
+        list_type const& l;
+    public:
+        explicit reader (listener_registry& nr)
+            : r (nr), l ((++nr.depth_, nr.current_.load (std::memory_order_acquire)->list)) {}
+        ~reader () { if (!--r.depth_) r.quiescent (); }
+        reader (reader const&) = delete;
+        reader& operator= (reader const&) = delete;
+
+        list_type const& list () const noexcept { return l; }
+        typename list_type::const_iterator begin () const noexcept { return l.cbegin (); }
+        typename list_type::const_iterator end () const noexcept { return l.cend (); }
+        bool empty () const noexcept { return l.empty (); }
+    };
+
+    /// Start a dispatch scope, e.g. `for (auto const& f: registry.read ()) f ();`
+
+    reader
+    read () noexcept
+    {
+        return reader (*this);
+    }
+
+    /// Called by the dispatching thread when it no longer holds any list (see #reader).
+
+    void
+    quiescent () noexcept
+    {
+        if (retired_.load (std::memory_order_relaxed))
+            free_chain (retired_.exchange (nullptr, std::memory_order_acquire));
+    }
+
+    /// Append, unless already there. Safe from any thread.
+
+    bool
+    insert (T const& v)
+    {
+        return publish ([&v] (list_type& l) {
+            if (std::find (l.cbegin (), l.cend (), v) != l.cend ())
+                return false;
+            l.push_back (v);
+            return true;
+        });
+    }
+
+    /// Safe from any thread.
+
+    bool
+    erase (T const& v)
+    {
+        return publish ([&v] (list_type& l) {
+            auto n = std::remove (l.begin (), l.end (), v);
+            if (n == l.end ())
+                return false;
+            l.erase (n, l.end ());
+            return true;
+        });
+    }
+
+    /// Same semantic as the generic #update_listener() helper.
+
+    bool
+    update (T const& v, bool remove)
+    {
+        return remove ? erase (v) : insert (v);
+    }
+
+    /// Arbitrary change, @param change returns true to publish the modified copy.
+
+    template<class Change>
+    bool
+    modify (Change&& change)
+    {
+        return publish (std::forward<Change> (change));
+    }
+
+    /// Access from non-dispatching threads, blocks only the writers.
+
+    template<class Visit>
+    void
+    inspect (Visit&& visit)
+    {
+        std::lock_guard<std::mutex> lock (writers_);
+        visit (static_cast<list_type const&> (current_.load (std::memory_order_relaxed)->list));
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Callback with own bookkeeping, which is shared across the copy-on-write snapshots.
+
+template<class F, class Info>
+struct listener
+{
+    F callback;
+    std::shared_ptr<Info> info;
+
+    bool operator== (listener const& other) const noexcept { return callback == other.callback; }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
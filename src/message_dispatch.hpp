@@ -0,0 +1,282 @@
+/**
+ * @file message_dispatch.hpp
+ * @brief Per window message table of the listeners subscribed to it
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * The list of message listeners keeps, next to the listeners, which of them to call for each
+ * system message (below WM_USER). It is rebuilt whenever the list is published by the registry,
+ * so the window procedure only indexes it - no per listener test on each message. The messages
+ * from WM_USER on share one bucket, the listeners of SSEGUI_MESSAGE_OTHER, merged with the few
+ * explicit subscriptions to such messages.
+ *
+ * The listeners are kept ordered by priority, higher first, then by registration. A listener may
+ * stop the dispatch of a message, the ones after it are not called then.
+ *
+ * The messages held back from the game (not forwarded to the original window procedure) live in
+ * the same snapshot, so they can change at any time too.
+ *
+ * The listener type T is an #ordered_listener, whose `info` is a #message_info. Does not depend
+ * on Windows, deliver_message() is the core of the window procedure, which calls it with the
+ * actual callback.
+ */
+
+#ifndef SSEGUI_MESSAGE_DISPATCH_HPP
+#define SSEGUI_MESSAGE_DISPATCH_HPP
+
+#include <sse-gui/sse-gui.h>
+#include "listeners.hpp"
+#include "profiler.hpp"
+
+#include <atomic>
+#include <bitset>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Class of a window message, one of the SSEGUI_MESSAGE_* constants
+
+constexpr int
+message_class (unsigned msg) noexcept
+{
+    if (msg >= 0x0100 && msg <= 0x0109)     // WM_KEYDOWN - WM_UNICHAR
+        return SSEGUI_MESSAGE_KEYBOARD;
+    if (msg == 0x0200 || msg == 0x02A1 || msg == 0x02A3) // WM_MOUSEMOVE, HOVER, LEAVE
+        return SSEGUI_MESSAGE_MOUSE_MOVE;
+    if (msg >= 0x0201 && msg <= 0x020E)     // WM_LBUTTONDOWN - WM_MOUSEHWHEEL
+        return SSEGUI_MESSAGE_MOUSE_BUTTON;
+    if (msg == 0x00FE || msg == 0x00FF)     // WM_INPUT_DEVICE_CHANGE, WM_INPUT
+        return SSEGUI_MESSAGE_RAW_INPUT;
+    if ((msg >= 0x0006 && msg <= 0x0008) || msg == 0x001C) // WM_ACTIVATE - WM_KILLFOCUS
+        return SSEGUI_MESSAGE_FOCUS;
+    if (msg == 0x0002 || msg == 0x0003 || msg == 0x0005 || msg == 0x0010
+            || msg == 0x0046 || msg == 0x0047 || msg == 0x007E
+            || msg == 0x0214 || msg == 0x0231 || msg == 0x0232)
+        return SSEGUI_MESSAGE_WINDOW;
+    if ((msg >= 0x010D && msg <= 0x010F) || (msg >= 0x0280 && msg <= 0x0291))
+        return SSEGUI_MESSAGE_IME;
+    return SSEGUI_MESSAGE_OTHER;
+}
+
+/// What a message listener subscribed to, changed only by the registry writers
+
+struct message_filter
+{
+    int classes = SSEGUI_MESSAGE_ALL;
+    std::vector<unsigned> messages;     ///< Sorted, besides the classes
+
+    bool
+    accepts (unsigned msg) const noexcept
+    {
+        return (classes & message_class (msg))
+            || std::binary_search (messages.cbegin (), messages.cend (), msg);
+    }
+};
+
+struct message_info : listener_stats
+{
+    message_filter filter;      ///< By the registry writers
+    std::atomic<std::uint64_t> stopped { 0 };  ///< Only by the window thread
+};
+
+inline void
+to_json (nlohmann::json& j, message_info const& info)
+{
+    j = static_cast<listener_stats const&> (info);
+    j["classes"] = info.filter.classes;
+    j["messages"] = info.filter.messages;
+    j["stopped"] = info.stopped.load (std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Copied in each snapshot, so these fields are immutable while dispatching
+
+template<class F, class Info>
+struct ordered_listener : listener<F, Info>
+{
+    int priority;               ///< Higher first
+    std::uint64_t sequence;     ///< Of registration, earlier first among the same priority
+    bool consumes;              ///< Its result tells whether to stop, @see #SSEGUI_MESSAGE_PASS
+};
+
+//--------------------------------------------------------------------------------------------------
+
+template<class T>
+class message_table : public std::vector<T>
+{
+public:
+    static constexpr unsigned table_size = 0x0400; ///< WM_USER, the rest share one bucket
+
+private:
+    std::vector<std::uint32_t> offsets_;    ///< Into indices_, per message and one past
+    std::vector<std::uint16_t> indices_;    ///< Of the listeners, in their order
+    std::vector<std::pair<unsigned, std::uint16_t>> high_;  ///< Explicit, from table_size on
+    std::bitset<table_size> blocked_;
+    std::vector<unsigned> blocked_high_;    ///< Sorted
+
+public:
+    /// Sorts the listeners and rebuilds the table, @see list_changed()
+
+    void
+    index ()
+    {
+        std::sort (this->begin (), this->end (), [] (T const& a, T const& b) {
+            return a.priority != b.priority ? a.priority > b.priority : a.sequence < b.sequence;
+        });
+
+        offsets_.clear ();
+        indices_.clear ();
+        high_.clear ();
+        if (this->empty ())
+            return;
+
+        auto const& self = *this;
+        offsets_.resize (table_size + 2);
+        for (unsigned m = 0; m <= table_size; ++m)
+        {
+            offsets_[m] = std::uint32_t (indices_.size ());
+            for (std::size_t i = 0; i < self.size (); ++i)
+            {
+                auto const& f = self[i].info->filter;
+                if (m < table_size ? f.accepts (m) : (f.classes & SSEGUI_MESSAGE_OTHER))
+                    indices_.push_back (std::uint16_t (i));
+            }
+        }
+        offsets_[table_size + 1] = std::uint32_t (indices_.size ());
+
+        for (std::size_t i = 0; i < self.size (); ++i)
+        {
+            auto const& f = self[i].info->filter;
+            if (f.classes & SSEGUI_MESSAGE_OTHER)
+                continue; // In the bucket already
+            for (auto m: f.messages)
+                if (m >= table_size)
+                    high_.emplace_back (m, std::uint16_t (i));
+        }
+        std::sort (high_.begin (), high_.end ());
+    }
+
+    /**
+     * Calls @param visit with each listener subscribed to @param msg, in the list order, until it
+     * returns true. @returns whether it did, i.e. the dispatch was stopped.
+     */
+
+    template<class Visit>
+    bool
+    dispatch (unsigned msg, Visit&& visit) const
+    {
+        if (offsets_.empty ())
+            return false;
+        auto const& self = *this;
+        auto m = std::min (msg, table_size);
+        auto b = indices_.data () + offsets_[m], e = indices_.data () + offsets_[m + 1];
+        if (msg >= table_size && !high_.empty ())
+        {
+            auto key = std::make_pair (msg, std::uint16_t (0));
+            auto h = std::lower_bound (high_.cbegin (), high_.cend (), key);
+            for (; h != high_.cend () && h->first == msg; ++h)
+            {
+                for (; b != e && *b < h->second; ++b)
+                    if (visit (self[*b]))
+                        return true;
+                if (visit (self[h->second]))
+                    return true;
+            }
+        }
+        for (; b != e; ++b)
+            if (visit (self[*b]))
+                return true;
+        return false;
+    }
+
+    /// Whether @param msg is held back from the game
+
+    bool
+    blocked (unsigned msg) const noexcept
+    {
+        return msg < table_size ? blocked_[msg]
+            : std::binary_search (blocked_high_.cbegin (), blocked_high_.cend (), msg);
+    }
+
+    bool
+    any_blocked () const noexcept
+    {
+        return blocked_.any () || !blocked_high_.empty ();
+    }
+
+    void
+    block (std::vector<unsigned> const& messages)
+    {
+        blocked_.reset ();
+        blocked_high_.clear ();
+        for (auto m: messages)
+            if (m < table_size)
+                blocked_.set (m);
+            else
+                blocked_high_.push_back (m);
+        std::sort (blocked_high_.begin (), blocked_high_.end ());
+    }
+};
+
+template<class T>
+inline void
+list_changed (message_table<T>& table)
+{
+    table.index ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Calls @param call with each listener of @param list subscribed to @param msg, timed if
+ * @param profile, until a consuming one returns #SSEGUI_MESSAGE_STOP or #SSEGUI_MESSAGE_CONSUME.
+ * @returns whether the message goes on to the game - neither consumed nor blocked.
+ */
+
+template<class List, class Call>
+bool
+deliver_message (List const& list, unsigned msg, bool profile, Call&& call)
+{
+    bool forward = true;
+    list.dispatch (msg, [&] (auto const& l) {
+        std::intptr_t result;
+        {
+            cost_timer t (profile ? &l.info->cost : nullptr);
+            result = call (l);
+        }
+        if (!l.consumes || (result != SSEGUI_MESSAGE_STOP && result != SSEGUI_MESSAGE_CONSUME))
+            return false;
+        relaxed_add (l.info->stopped);
+        forward = result == SSEGUI_MESSAGE_STOP;
+        return true;
+    });
+    return forward && !list.blocked (msg);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,190 @@
+/**
+ * @file parameters.cpp
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Public API
+ *
+ * @details
+ * The single registry behind #ssegui_parameter() and the handle based functions. The render
+ * thread publishes the SSEGUI owned values as they change, plugins read them from any thread.
+ * @see parameters.hpp
+ */
+
+#include <sse-gui/sse-gui.h>
+#include "parameters.hpp"
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+//--------------------------------------------------------------------------------------------------
+
+using namespace std::string_literals;
+
+/// Defined in sse-gui.cpp
+extern thread_local std::string ssegui_error;
+
+/// Defined in render.cpp
+extern void* deferred_render_context ();
+
+//--------------------------------------------------------------------------------------------------
+
+static parameter_registry<256> parameters;
+
+static_assert (parameter_pointer == SSEGUI_PARAMETER_POINTER
+            && parameter_integer == SSEGUI_PARAMETER_INTEGER
+            && parameter_real == SSEGUI_PARAMETER_REAL, "Parameter type mismatch");
+
+//--------------------------------------------------------------------------------------------------
+
+/// Any thread, @param pointer nullptr makes it unavailable
+
+void
+publish_pointer (builtin_parameter handle, void const* pointer)
+{
+    parameters.set_pointer (handle, pointer);
+}
+
+void
+publish_integer (builtin_parameter handle, std::int64_t value)
+{
+    parameters.set_integer (handle, value);
+}
+
+void
+withdraw_parameter (builtin_parameter handle)
+{
+    parameters.set (handle, 0, false);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @see #ssegui_parameter_handle()
+
+int
+parameter_handle (const char* name, int type)
+{
+    ssegui_error.clear ();
+    if (!name)
+    {
+        ssegui_error = __func__ + " null name"s;
+        return 0;
+    }
+    auto h = parameters.intern (name, type);
+    if (!h)
+        ssegui_error = __func__ + " unknown, mistyped or out of handles "s + name;
+    return h;
+}
+
+/// @see #ssegui_parameter_get(), lock-free and leaves #ssegui_last_error() alone
+
+bool
+parameter_get (int handle, void* value)
+{
+    auto s = parameters.slot (handle);
+    std::uint64_t bits;
+    if (!s || !value || !parameters.get (handle, bits))
+        return false;
+    switch (s->type)
+    {
+        case parameter_pointer:
+            *reinterpret_cast<void**> (value) = reinterpret_cast<void*> (std::uintptr_t (bits));
+            break;
+        case parameter_integer:
+            *reinterpret_cast<long long*> (value) = (long long) bits;
+            break;
+        case parameter_real:
+            std::memcpy (value, &bits, sizeof (double));
+            break;
+    }
+    return true;
+}
+
+/// @see #ssegui_parameter_set()
+
+bool
+parameter_set (int handle, void const* value)
+{
+    ssegui_error.clear ();
+    auto s = parameters.slot (handle);
+    if (!s || handle < builtin_parameters)
+    {
+        ssegui_error = __func__ + " invalid or read-only handle "s + std::to_string (handle);
+        return false;
+    }
+    if (!value)
+        return parameters.set (handle, 0, false);
+    switch (s->type)
+    {
+        case parameter_pointer:
+            parameters.set_pointer (handle, *reinterpret_cast<void* const*> (value));
+            break;
+        case parameter_integer:
+            parameters.set_integer (handle, *reinterpret_cast<long long const*> (value));
+            break;
+        case parameter_real:
+            parameters.set_real (handle, *reinterpret_cast<double const*> (value));
+            break;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @see #ssegui_parameter(), by name as before, plus the plugin defined ones
+
+bool
+parameter_by_name (std::string const& name, void* value)
+{
+    if (name == "ID3D11DeviceContext")
+    {
+        if (auto deferred = deferred_render_context ())
+        {
+            *reinterpret_cast<void**> (value) = deferred;
+            return true;
+        }
+    }
+    else if (name == "BackBufferSize")
+    {
+        std::uint64_t rtv, width, height;
+        if (!parameters.get (param_back_buffer_rtv, rtv)
+                || !parameters.get (param_back_buffer_width, width)
+                || !parameters.get (param_back_buffer_height, height))
+            return false;
+        auto size = reinterpret_cast<std::uint32_t*> (value);
+        size[0] = std::uint32_t (width);
+        size[1] = std::uint32_t (height);
+        return true;
+    }
+
+    auto h = parameters.intern (name, 0);
+    if (parameter_get (h, value))
+        return true;
+    if (h && h < param_back_buffer_rtv)
+    {
+        // These always were there, null until the game made its device
+        *reinterpret_cast<void**> (value) = nullptr;
+        return true;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+
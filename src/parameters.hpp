@@ -0,0 +1,183 @@
+/**
+ * @file parameters.hpp
+ * @brief Interned, typed parameters read without locking
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each name is interned once, under a lock, into a handle - the index of its slot in a fixed
+ * array, so slots never move. A slot holds 64 bits (pointer, integer or double) in one atomic,
+ * so reading it is a single load, and writing it from any thread never tears. Whether there is
+ * a value at all is a separate flag, loaded first (see #parameter_slot).
+ *
+ * The first handles are the SSEGUI owned ones (#builtin_parameter), which plugins cannot write.
+ */
+
+#ifndef SSEGUI_PARAMETERS_HPP
+#define SSEGUI_PARAMETERS_HPP
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <unordered_map>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Handles of the SSEGUI owned parameters, in the order of #builtin_parameter_names
+enum builtin_parameter : int
+{
+    param_device = 1,
+    param_context,
+    param_chain,
+    param_window,
+    param_back_buffer_rtv,
+    param_back_buffer_width,
+    param_back_buffer_height,
+    param_font_atlas,
+    builtin_parameters
+};
+
+/// Types, the same as the SSEGUI_PARAMETER_* constants
+enum parameter_type : int
+{
+    parameter_pointer = 1,
+    parameter_integer,
+    parameter_real
+};
+
+struct builtin_parameter_name
+{
+    const char* name;
+    parameter_type type;
+};
+
+constexpr builtin_parameter_name builtin_parameter_names[builtin_parameters - 1] = {
+    { "ID3D11Device",           parameter_pointer },
+    { "ID3D11DeviceContext",    parameter_pointer },
+    { "IDXGISwapChain",         parameter_pointer },
+    { "window",                 parameter_pointer },
+    { "BackBufferRTV",          parameter_pointer },
+    { "BackBufferWidth",        parameter_integer },
+    { "BackBufferHeight",       parameter_integer },
+    { "FontAtlas",              parameter_pointer },
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Value and whether there is one, never torn
+struct parameter_slot
+{
+    std::atomic<std::uint64_t> bits { 0 };
+    std::atomic<bool> available { false };
+    parameter_type type = parameter_pointer;   ///< Immutable once interned
+};
+
+template<unsigned Capacity>
+class parameter_registry
+{
+    std::array<parameter_slot, Capacity> slots_;
+    std::atomic<int> count_ { 1 };              ///< Handle zero is invalid
+    std::mutex mutex_;                          ///< Of the interning
+    std::unordered_map<std::string, int> names_;
+
+public:
+    parameter_registry ()
+    {
+        for (auto const& b: builtin_parameter_names)
+            intern (b.name, b.type);
+    }
+
+    parameter_registry (parameter_registry const&) = delete;
+    parameter_registry& operator= (parameter_registry const&) = delete;
+
+    static constexpr unsigned capacity () noexcept { return Capacity; }
+    int size () const noexcept { return count_.load (std::memory_order_acquire); }
+
+    /**
+     * Handle of @param name, created with @param type if zero and not known yet.
+     *
+     * @returns zero if there is no such, if the type differs, or if the registry is full
+     */
+    int
+    intern (std::string const& name, int type)
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+        auto it = names_.find (name);
+        if (it != names_.end ())
+            return !type || type == slots_[it->second].type ? it->second : 0;
+        auto h = count_.load (std::memory_order_relaxed);
+        if (!type || type < parameter_pointer || type > parameter_real || h == int (Capacity))
+            return 0;
+        slots_[h].type = parameter_type (type);
+        names_.emplace (name, h);
+        count_.store (h + 1, std::memory_order_release);
+        return h;
+    }
+
+    /// Lock-free, nullptr if @param handle is not an interned one
+    parameter_slot const*
+    slot (int handle) const noexcept
+    {
+        return handle > 0 && handle < size () ? &slots_[handle] : nullptr;
+    }
+
+    /// Lock-free, @returns false if @param handle has no value
+    bool
+    get (int handle, std::uint64_t& bits) const noexcept
+    {
+        auto s = slot (handle);
+        if (!s || !s->available.load (std::memory_order_acquire))
+            return false;
+        bits = s->bits.load (std::memory_order_acquire);
+        return true;
+    }
+
+    /// Any thread, @param available false clears the value
+    bool
+    set (int handle, std::uint64_t bits, bool available = true) noexcept
+    {
+        if (handle <= 0 || handle >= size ())
+            return false;
+        auto& s = slots_[handle];
+        s.bits.store (bits, std::memory_order_release);
+        s.available.store (available, std::memory_order_release);
+        return true;
+    }
+
+    void set_pointer (int h, void const* p) noexcept { set (h, std::uintptr_t (p), p != nullptr); }
+    void set_integer (int h, std::int64_t v) noexcept { set (h, std::uint64_t (v)); }
+
+    void
+    set_real (int h, double v) noexcept
+    {
+        std::uint64_t bits;
+        std::memcpy (&bits, &v, sizeof (bits));
+        set (h, bits);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,215 @@
+/**
+ * @file pipeline_state.hpp
+ * @brief Save and restore of the D3D11 context state around the render listeners
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Covers what an overlay usually touches: input assembler, the shaders of all stages with the
+ * vertex and pixel shader constant buffers, pixel shader resources and samplers, rasterizer and
+ * output merger, each with all of its slots. Compute shaders and stream output are left alone.
+ *
+ * The D3D11 types come from a traits type (see d3d11_traits in render.cpp), so the same code runs
+ * against a counting mock context too.
+ */
+
+#ifndef SSEGUI_PIPELINE_STATE_HPP
+#define SSEGUI_PIPELINE_STATE_HPP
+
+#include <array>
+
+//--------------------------------------------------------------------------------------------------
+
+template<class T>
+class pipeline_state
+{
+    template<class U, std::size_t N> using refs = std::array<U*, N>;
+
+    // All the slots D3D11 has, a listener may bind any of them
+    static constexpr unsigned max_viewports = 16;           // D3D11_VIEWPORT_AND_SCISSORRECT_*
+    static constexpr unsigned max_targets = 8;              // D3D11_SIMULTANEOUS_RENDER_TARGET_*
+    static constexpr unsigned max_vertex_buffers = 32;      // D3D11_IA_VERTEX_INPUT_RESOURCE_*
+    static constexpr unsigned max_constant_buffers = 14;    // D3D11_COMMONSHADER_CONSTANT_BUFFER_*
+    static constexpr unsigned max_resources = 128;          // D3D11_COMMONSHADER_INPUT_RESOURCE_*
+    static constexpr unsigned max_samplers = 16;            // D3D11_COMMONSHADER_SAMPLER_*
+    static constexpr unsigned max_instances = 256;
+
+    template<class Shader>
+    struct shader_stage
+    {
+        Shader* shader;
+        refs<typename T::class_instance, max_instances> instances;
+        unsigned count;
+    };
+
+    struct
+    {
+        typename T::input_layout* layout;
+        refs<typename T::buffer, max_vertex_buffers> vertex_buffers;
+        std::array<unsigned, max_vertex_buffers> strides, offsets;
+        typename T::buffer* index_buffer;
+        typename T::format index_format;
+        unsigned index_offset;
+        typename T::topology topology;
+    } ia;
+
+    shader_stage<typename T::vertex_shader> vs;
+    shader_stage<typename T::pixel_shader> ps;
+    shader_stage<typename T::geometry_shader> gs;
+    shader_stage<typename T::hull_shader> hs;
+    shader_stage<typename T::domain_shader> ds;
+    refs<typename T::buffer, max_constant_buffers> vs_constants, ps_constants;
+    refs<typename T::shader_resource_view, max_resources> ps_resources;
+    refs<typename T::sampler_state, max_samplers> ps_samplers;
+
+    struct
+    {
+        typename T::rasterizer_state* state;
+        std::array<typename T::viewport, max_viewports> viewports;
+        unsigned viewport_count;
+        std::array<typename T::rect, max_viewports> scissors;
+        unsigned scissor_count;
+    } rs;
+
+    struct
+    {
+        refs<typename T::render_target_view, max_targets> targets;
+        typename T::depth_stencil_view* depth;
+        typename T::blend_state* blend;
+        float blend_factor[4];
+        unsigned sample_mask;
+        typename T::depth_stencil_state* depth_state;
+        unsigned stencil_ref;
+    } om;
+
+    bool captured_ = false;
+
+    template<class U> static inline void
+    release (U* p)
+    {
+        if (p) p->Release ();
+    }
+
+    template<class U, std::size_t N> static inline void
+    release (refs<U, N>& a, std::size_t n = N)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+            release (a[i]);
+    }
+
+    template<class Shader>
+    static void
+    release (shader_stage<Shader>& s)
+    {
+        release (s.shader);
+        release (s.instances, s.count);
+    }
+
+public:
+    bool captured () const noexcept { return captured_; }
+
+    /// Takes a reference to all the state objects, until #restore()
+    void
+    capture (typename T::context* c)
+    {
+        if (captured_)
+            return;
+        captured_ = true;
+
+        c->IAGetInputLayout (&ia.layout);
+        c->IAGetVertexBuffers (0, max_vertex_buffers,
+                ia.vertex_buffers.data (), ia.strides.data (), ia.offsets.data ());
+        c->IAGetIndexBuffer (&ia.index_buffer, &ia.index_format, &ia.index_offset);
+        c->IAGetPrimitiveTopology (&ia.topology);
+
+        vs.count = ps.count = gs.count = hs.count = ds.count = max_instances;
+        c->VSGetShader (&vs.shader, vs.instances.data (), &vs.count);
+        c->PSGetShader (&ps.shader, ps.instances.data (), &ps.count);
+        c->GSGetShader (&gs.shader, gs.instances.data (), &gs.count);
+        c->HSGetShader (&hs.shader, hs.instances.data (), &hs.count);
+        c->DSGetShader (&ds.shader, ds.instances.data (), &ds.count);
+        c->VSGetConstantBuffers (0, max_constant_buffers, vs_constants.data ());
+        c->PSGetConstantBuffers (0, max_constant_buffers, ps_constants.data ());
+        c->PSGetShaderResources (0, max_resources, ps_resources.data ());
+        c->PSGetSamplers (0, max_samplers, ps_samplers.data ());
+
+        c->RSGetState (&rs.state);
+        rs.viewport_count = rs.scissor_count = max_viewports;
+        c->RSGetViewports (&rs.viewport_count, rs.viewports.data ());
+        c->RSGetScissorRects (&rs.scissor_count, rs.scissors.data ());
+
+        c->OMGetRenderTargets (max_targets, om.targets.data (), &om.depth);
+        c->OMGetBlendState (&om.blend, om.blend_factor, &om.sample_mask);
+        c->OMGetDepthStencilState (&om.depth_state, &om.stencil_ref);
+    }
+
+    /// Sets back what was captured and releases it
+    void
+    restore (typename T::context* c)
+    {
+        if (!captured_)
+            return;
+        captured_ = false;
+
+        c->IASetInputLayout (ia.layout);
+        c->IASetVertexBuffers (0, max_vertex_buffers,
+                ia.vertex_buffers.data (), ia.strides.data (), ia.offsets.data ());
+        c->IASetIndexBuffer (ia.index_buffer, ia.index_format, ia.index_offset);
+        c->IASetPrimitiveTopology (ia.topology);
+
+        c->VSSetShader (vs.shader, vs.instances.data (), vs.count);
+        c->PSSetShader (ps.shader, ps.instances.data (), ps.count);
+        c->GSSetShader (gs.shader, gs.instances.data (), gs.count);
+        c->HSSetShader (hs.shader, hs.instances.data (), hs.count);
+        c->DSSetShader (ds.shader, ds.instances.data (), ds.count);
+        c->VSSetConstantBuffers (0, max_constant_buffers, vs_constants.data ());
+        c->PSSetConstantBuffers (0, max_constant_buffers, ps_constants.data ());
+        c->PSSetShaderResources (0, max_resources, ps_resources.data ());
+        c->PSSetSamplers (0, max_samplers, ps_samplers.data ());
+
+        c->RSSetState (rs.state);
+        c->RSSetViewports (rs.viewport_count, rs.viewports.data ());
+        c->RSSetScissorRects (rs.scissor_count, rs.scissors.data ());
+
+        c->OMSetRenderTargets (max_targets, om.targets.data (), om.depth);
+        c->OMSetBlendState (om.blend, om.blend_factor, om.sample_mask);
+        c->OMSetDepthStencilState (om.depth_state, om.stencil_ref);
+
+        release (ia.layout);
+        release (ia.vertex_buffers);
+        release (ia.index_buffer);
+        release (vs); release (ps); release (gs); release (hs); release (ds);
+        release (vs_constants);
+        release (ps_constants);
+        release (ps_resources);
+        release (ps_samplers);
+        release (rs.state);
+        release (om.targets);
+        release (om.depth);
+        release (om.blend);
+        release (om.depth_state);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,94 @@
+/**
+ * @file profiler.hpp
+ * @brief CPU cost bookkeeping of the listener callbacks
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each listener owns a #listener_stats, the dispatching code wraps each call in a #cost_timer
+ * which does nothing when given nullptr - that is the only overhead when profiling is disabled.
+ */
+
+#ifndef SSEGUI_PROFILER_HPP
+#define SSEGUI_PROFILER_HPP
+
+#include "histogram.hpp"
+#include <nlohmann/json.hpp>
+
+#include <chrono>
+#include <string>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Monotonic & high resolution (QueryPerformanceCounter under Windows)
+typedef std::chrono::steady_clock profiler_clock;
+
+/// Nanoseconds since some fixed point in time
+inline std::uint64_t
+profiler_now () noexcept
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds> (profiler_clock::now ().time_since_epoch ()).count ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+struct listener_stats
+{
+    std::string name;           ///< Something human readable, like the module hosting the callback
+    duration_histogram cost;    ///< Time spent in each call
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Scoped measurement of one call
+
+class cost_timer
+{
+    duration_histogram* h;
+    std::uint64_t t0;
+public:
+    explicit cost_timer (duration_histogram* nh) noexcept
+        : h (nh), t0 (nh ? profiler_now () : 0) {}
+    ~cost_timer () { if (h) h->record (profiler_now () - t0); }
+    cost_timer (cost_timer const&) = delete;
+    cost_timer& operator= (cost_timer const&) = delete;
+};
+
+//--------------------------------------------------------------------------------------------------
+
+inline void
+to_json (nlohmann::json& j, listener_stats const& s)
+{
+    j = nlohmann::json {
+        { "name",  s.name },
+        { "calls", s.cost.count () },
+        { "mean",  s.cost.mean () },
+        { "p50",   s.cost.quantile (.50) },
+        { "p99",   s.cost.quantile (.99) },
+        { "max",   s.cost.maximum () }
+    };
+}
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
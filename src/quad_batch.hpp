@@ -0,0 +1,298 @@
+/**
+ * @file quad_batch.hpp
+ * @brief Sorting of the submitted quads into the fewest draw calls and their upload ring
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Each quad gets a 64 bit key of its layer, texture and flags, and a stable radix sort over the
+ * key bytes which actually differ puts together the quads of the same draw call. Usually only one
+ * or two bytes differ (the texture), so the sort is a couple of linear passes. The textures are
+ * numbered in order of first use, hence the draws of a layer follow the submission order as much
+ * as possible.
+ *
+ * The vertices go into a ring of a dynamic buffer: appended with no-overwrite maps, discarded only
+ * when wrapping around, so the driver never has to wait for the GPU or rename the buffer more than
+ * once per wrap.
+ *
+ * The vertex buffer maps and the draw calls go through the Backend of #quad_batch::flush(), so
+ * bench_quad_batch counts them instead of drawing.
+ */
+
+#ifndef SSEGUI_QUAD_BATCH_HPP
+#define SSEGUI_QUAD_BATCH_HPP
+
+#include <sse-gui/sse-gui.h>
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+//--------------------------------------------------------------------------------------------------
+
+/// As fed into the input assembler, four per quad: top left, top right, bottom left, bottom right
+struct quad_vertex
+{
+    float x, y;
+    float u, v;
+    std::uint32_t color;
+};
+
+/// One draw call over consecutive quads of the same layer, texture and flags
+struct quad_draw
+{
+    int layer;
+    void* texture;
+    int flags;
+    std::uint32_t first, count;     ///< Quads in the sorted order
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Sub-allocation of a dynamic buffer holding @param capacity quads
+
+class quad_ring
+{
+    std::uint32_t capacity_, head_;
+    bool fresh_;
+
+public:
+    explicit quad_ring (std::uint32_t capacity) noexcept
+        : capacity_ (capacity), head_ (0), fresh_ (true) {}
+
+    std::uint32_t capacity () const noexcept { return capacity_; }
+
+    /// Once the buffer is recreated, it must be discarded on the first map
+    void reset () noexcept { head_ = 0; fresh_ = true; }
+
+    /**
+     * Room for @param count quads, at most the capacity.
+     *
+     * @param[out] first quad of the room
+     * @returns true if the buffer must be mapped with discard, no-overwrite otherwise
+     */
+    bool
+    reserve (std::uint32_t count, std::uint32_t& first) noexcept
+    {
+        bool discard = std::exchange (fresh_, false);
+        if (head_ + count > capacity_)
+        {
+            head_ = 0;
+            discard = true;
+        }
+        first = head_;
+        head_ += count;
+        return discard;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Quads submitted for one frame. Not synchronized, the user should lock around it.
+
+class quad_batch
+{
+    std::vector<ssegui_quad> quads_;
+    std::vector<std::uint64_t> keys_, keys_scratch_;
+    std::vector<std::uint32_t> order_, order_scratch_;
+    std::unordered_map<void*, std::uint32_t> textures_;
+    std::vector<quad_draw> draws_;
+
+    /// Stable LSD radix sort of order_ by keys_, skipping the bytes equal in all keys
+    void
+    radix_sort ()
+    {
+        auto n = keys_.size ();
+        if (std::is_sorted (keys_.cbegin (), keys_.cend ())) // E.g. a single plugin and texture
+            return;
+
+        std::uint64_t any = 0, all = ~std::uint64_t (0);
+        for (auto k: keys_)
+        {
+            any |= k;
+            all &= k;
+        }
+        auto differ = any ^ all;
+
+        keys_scratch_.resize (n);
+        order_scratch_.resize (n);
+        for (unsigned shift = 0; shift < 64; shift += 8)
+        {
+            if (!((differ >> shift) & 0xff))
+                continue;
+
+            std::uint32_t offsets[257] = {};
+            for (auto k: keys_)
+                ++offsets[((k >> shift) & 0xff) + 1];
+            for (unsigned i = 1; i < 257; ++i)
+                offsets[i] += offsets[i - 1];
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                auto j = offsets[(keys_[i] >> shift) & 0xff]++;
+                keys_scratch_[j] = keys_[i];
+                order_scratch_[j] = order_[i];
+            }
+            keys_.swap (keys_scratch_);
+            order_.swap (order_scratch_);
+        }
+    }
+
+public:
+    std::size_t size () const noexcept { return quads_.size (); }
+    bool empty () const noexcept { return quads_.empty (); }
+    std::vector<quad_draw> const& draws () const noexcept { return draws_; }
+
+    /// Keeps the memory for the next frame
+    void
+    clear () noexcept
+    {
+        quads_.clear ();
+        draws_.clear ();
+    }
+
+    void
+    add (ssegui_quad const* quads, std::size_t count)
+    {
+        quads_.insert (quads_.end (), quads, quads + count);
+    }
+
+    void
+    swap (quad_batch& other) noexcept
+    {
+        quads_.swap (other.quads_);
+        draws_.swap (other.draws_);
+    }
+
+    /// Orders the quads by layer, texture and flags, then splits them in #draws()
+    void
+    sort ()
+    {
+        auto n = quads_.size ();
+        keys_.resize (n);
+        order_.resize (n);
+        textures_.clear ();
+
+        // Relative to the lowest layer, so usually only the lowest key byte of the layer differs
+        int lowest = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            lowest = !i || quads_[i].layer < lowest ? quads_[i].layer : lowest;
+
+        void* last = nullptr;
+        std::uint32_t last_id = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            auto const& q = quads_[i];
+            if (q.texture != last || !i) // Runs of the same texture are the common case
+            {
+                last = q.texture;
+                auto it = textures_.find (q.texture);
+                if (it == textures_.end ()) // emplace() would allocate a node even if found
+                    it = textures_.emplace (q.texture, std::uint32_t (textures_.size ())).first;
+                last_id = it->second;
+            }
+            keys_[i] = (std::uint64_t (std::uint32_t (q.layer) - std::uint32_t (lowest)) << 32)
+                     | (std::uint64_t (last_id & 0xffffff) << 8)
+                     | std::uint8_t (q.flags);
+            order_[i] = std::uint32_t (i);
+        }
+        radix_sort ();
+
+        draws_.clear ();
+        for (std::uint32_t i = 0; i < n; ++i)
+        {
+            if (!i || keys_[i] != keys_[i - 1])
+            {
+                auto const& q = quads_[order_[i]];
+                draws_.push_back (quad_draw { q.layer, q.texture, q.flags, i, 0 });
+            }
+            ++draws_.back ().count;
+        }
+    }
+
+    /// Vertices of @param count sorted quads from @param first onwards
+    void
+    write (std::uint32_t first, std::uint32_t count, quad_vertex* out) const noexcept
+    {
+        for (auto i = first; i < first + count; ++i, out += 4)
+        {
+            auto const& q = quads_[order_[i]];
+            out[0] = { q.x0, q.y0, q.u0, q.v0, q.color };
+            out[1] = { q.x1, q.y0, q.u1, q.v0, q.color };
+            out[2] = { q.x0, q.y1, q.u0, q.v1, q.color };
+            out[3] = { q.x1, q.y1, q.u1, q.v1, q.color };
+        }
+    }
+
+    /**
+     * Uploads the sorted quads through @param ring and issues the draws.
+     *
+     * Draws are split only where the ring wraps, which happens within a frame only when it has
+     * more quads than the ring capacity. The @param backend is something like:
+     *
+     *  quad_vertex* map (bool discard);    // The whole buffer, nullptr on error
+     *  void unmap ();
+     *  void draw (quad_draw const&, std::uint32_t ring_first);
+     *
+     * @returns false if mapping failed
+     */
+    template<class Backend>
+    bool
+    flush (quad_ring& ring, Backend& backend) const
+    {
+        auto draw = draws_.cbegin ();
+        std::uint32_t done = 0; // Of the current draw
+        for (std::uint32_t q = 0, n = std::uint32_t (quads_.size ()); q < n; )
+        {
+            std::uint32_t first, count = std::min (n - q, ring.capacity ());
+            bool discard = ring.reserve (count, first);
+            quad_vertex* vertices = backend.map (discard);
+            if (!vertices)
+                return false;
+            write (q, count, vertices + first * 4);
+            backend.unmap ();
+
+            for (auto left = count; left; )
+            {
+                quad_draw d = *draw;
+                d.first += done;
+                d.count = std::min (d.count - done, left);
+                backend.draw (d, first + (d.first - q));
+                left -= d.count;
+                done += d.count;
+                if (done == draw->count)
+                {
+                    ++draw;
+                    done = 0;
+                }
+            }
+            q += count;
+        }
+        return true;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,387 @@
+/**
+ * @file quads.cpp
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Public API
+ *
+ * @details
+ * Batched quad renderer: plugins queue quads from anywhere and on each Present they are sorted and
+ * drawn with as few calls as possible. The quads queued so far are swapped out under the lock, so
+ * the sorting and the upload do not block the submitting threads. @see quad_batch.hpp
+ */
+
+#include <sse-gui/sse-gui.h>
+#include <gsl/gsl_util>
+
+#include <utils/winutils.hpp>
+#include "quad_batch.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <fstream>
+#include <cstddef>
+
+#include <windows.h>
+#include <d3d11.h>
+
+//--------------------------------------------------------------------------------------------------
+
+using namespace std::string_literals;
+
+/// Opened from within skse.cpp
+extern std::ofstream& log ();
+
+/// Defined in sse-gui.cpp
+extern thread_local std::string ssegui_error;
+
+/// Defined in shaders.cpp
+extern ID3DBlob* compile_shader (std::string const& source, const char* entry, const char* target);
+
+//--------------------------------------------------------------------------------------------------
+
+constexpr std::uint32_t ring_quads = 16384;     ///< About 1.3MB of vertices
+constexpr std::size_t max_queued = 1 << 20;     ///< When nothing draws them, e.g. no rendering
+
+/// All in one holder of the quad renderer fields
+struct quads_t
+{
+    std::mutex mutex;
+    quad_batch queued;                  ///< Guarded by the mutex
+    std::atomic<std::size_t> count;     ///< Of the queued quads, to check without locking
+    quad_batch drawn;                   ///< Render thread only, swapped with the queued
+
+    quad_ring ring { ring_quads };
+    bool failed;                        ///< Do not retry creating the objects each frame
+    ID3D11VertexShader* vertex_shader;
+    ID3D11PixelShader* pixel_shaders[3];///< Solid color, textured and distance field
+    ID3D11InputLayout* input_layout;
+    ID3D11BlendState* premultiplied;
+    ID3D11SamplerState* sampler;
+    ID3D11RasterizerState* rasterizer;
+    ID3D11Buffer* vertices;
+    ID3D11Buffer* indices;
+    ID3D11Buffer* constants;
+};
+
+/// One and only one object
+static quads_t quads = {};
+
+//--------------------------------------------------------------------------------------------------
+
+static const char* shader_source = R"(
+cbuffer screen : register(b0)
+{
+    float2 pixel_to_ndc;
+};
+
+Texture2D content : register(t0);
+SamplerState linear_clamp : register(s0);
+
+struct vertex
+{
+    float4 position : SV_Position;
+    float2 uv : TEXCOORD;
+    float4 color : COLOR;
+};
+
+vertex vs_main (float2 position : POSITION, float2 uv : TEXCOORD, float4 color : COLOR)
+{
+    vertex v;
+    v.position = float4 (position * pixel_to_ndc + float2 (-1, 1), 0, 1);
+    v.uv = uv;
+    v.color = color;
+    return v;
+}
+
+float4 ps_color (vertex v) : SV_Target
+{
+    return v.color;
+}
+
+float4 ps_texture (vertex v) : SV_Target
+{
+    return content.Sample (linear_clamp, v.uv) * v.color;
+}
+
+float4 ps_sdf (vertex v) : SV_Target
+{
+    float d = content.Sample (linear_clamp, v.uv).r;
+    float w = fwidth (d) * .5;
+    return v.color * smoothstep (.5 - w, .5 + w, d);
+}
+)";
+
+//--------------------------------------------------------------------------------------------------
+
+static void
+release_objects ()
+{
+    IUnknown** objects[] = {
+        (IUnknown**) &quads.vertex_shader, (IUnknown**) &quads.pixel_shaders[0],
+        (IUnknown**) &quads.pixel_shaders[1], (IUnknown**) &quads.pixel_shaders[2],
+        (IUnknown**) &quads.input_layout, (IUnknown**) &quads.premultiplied,
+        (IUnknown**) &quads.sampler, (IUnknown**) &quads.rasterizer,
+        (IUnknown**) &quads.vertices, (IUnknown**) &quads.indices,
+        (IUnknown**) &quads.constants };
+    for (auto o: objects)
+        if (*o) std::exchange (*o, nullptr)->Release ();
+}
+
+/// Shaders, states and buffers, once for the tracked device
+
+static bool
+setup_quads (ID3D11Device* device)
+{
+    if (quads.vertex_shader)
+        return true;
+    if (quads.failed)
+        return false;
+    quads.failed = true;
+
+    ID3DBlob* blobs[4] = {};
+    auto release_blobs = gsl::finally ([&] {
+        for (auto b: blobs)
+            if (b) b->Release ();
+    });
+    const char* entries[4] = { "vs_main", "ps_color", "ps_texture", "ps_sdf" };
+    for (int i = 0; i < 4; ++i)
+        if (!(blobs[i] = compile_shader (shader_source, entries[i], i ? "ps_5_0" : "vs_5_0")))
+        {
+            log () << "Quads shaders: " << ssegui_error << std::endl;
+            return false;
+        }
+
+    D3D11_INPUT_ELEMENT_DESC layout[] = {
+        { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof (quad_vertex, x),
+            D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof (quad_vertex, u),
+            D3D11_INPUT_PER_VERTEX_DATA, 0 },
+        { "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof (quad_vertex, color),
+            D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    };
+
+    D3D11_BLEND_DESC blend = {};
+    blend.RenderTarget[0].BlendEnable = TRUE;
+    blend.RenderTarget[0].SrcBlend = blend.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+    blend.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+    blend.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+    blend.RenderTarget[0].BlendOp = blend.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+    blend.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+    D3D11_SAMPLER_DESC sampler = {};
+    sampler.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+    sampler.AddressU = sampler.AddressV = sampler.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+    sampler.MaxLOD = D3D11_FLOAT32_MAX;
+
+    D3D11_RASTERIZER_DESC raster = {};
+    raster.FillMode = D3D11_FILL_SOLID;
+    raster.CullMode = D3D11_CULL_NONE;
+
+    D3D11_BUFFER_DESC vertices = {};
+    vertices.ByteWidth = ring_quads * 4 * sizeof (quad_vertex);
+    vertices.Usage = D3D11_USAGE_DYNAMIC;
+    vertices.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    vertices.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    // The same two triangles for each quad, the draws offset them by the base vertex
+    std::vector<std::uint32_t> index_data (ring_quads * 6);
+    for (std::uint32_t q = 0, *p = index_data.data (); q < ring_quads; ++q, p += 6)
+    {
+        std::uint32_t v = q * 4;
+        p[0] = v; p[1] = v + 1; p[2] = v + 2;
+        p[3] = v + 2; p[4] = v + 1; p[5] = v + 3;
+    }
+    D3D11_BUFFER_DESC indices = {};
+    indices.ByteWidth = UINT (index_data.size () * sizeof (std::uint32_t));
+    indices.Usage = D3D11_USAGE_IMMUTABLE;
+    indices.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    D3D11_SUBRESOURCE_DATA index_init = { index_data.data (), 0, 0 };
+
+    D3D11_BUFFER_DESC constants = {};
+    constants.ByteWidth = 16;
+    constants.Usage = D3D11_USAGE_DEFAULT;
+    constants.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+    bool ok = device->CreateVertexShader (blobs[0]->GetBufferPointer (),
+            blobs[0]->GetBufferSize (), nullptr, &quads.vertex_shader) == S_OK;
+    for (int i = 0; ok && i < 3; ++i)
+        ok = device->CreatePixelShader (blobs[i+1]->GetBufferPointer (),
+                blobs[i+1]->GetBufferSize (), nullptr, &quads.pixel_shaders[i]) == S_OK;
+    ok = ok
+        && device->CreateInputLayout (layout, UINT (std::size (layout)),
+                blobs[0]->GetBufferPointer (), blobs[0]->GetBufferSize (),
+                &quads.input_layout) == S_OK
+        && device->CreateBlendState (&blend, &quads.premultiplied) == S_OK
+        && device->CreateSamplerState (&sampler, &quads.sampler) == S_OK
+        && device->CreateRasterizerState (&raster, &quads.rasterizer) == S_OK
+        && device->CreateBuffer (&vertices, nullptr, &quads.vertices) == S_OK
+        && device->CreateBuffer (&indices, &index_init, &quads.indices) == S_OK
+        && device->CreateBuffer (&constants, nullptr, &quads.constants) == S_OK;
+    if (!ok)
+    {
+        log () << "Quads setup failed." << std::endl;
+        release_objects ();
+        return false;
+    }
+
+    quads.ring.reset ();
+    quads.failed = false;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// The D3D11 side of quad_batch::flush()
+
+struct d3d11_quads
+{
+    ID3D11DeviceContext* context;
+    int flags;
+    void* texture;
+
+    quad_vertex*
+    map (bool discard)
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        if (context->Map (quads.vertices, 0,
+                    discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE,
+                    0, &mapped) != S_OK)
+            return nullptr;
+        return static_cast<quad_vertex*> (mapped.pData);
+    }
+
+    void
+    unmap ()
+    {
+        context->Unmap (quads.vertices, 0);
+    }
+
+    void
+    draw (quad_draw const& d, std::uint32_t ring_first)
+    {
+        if (flags != d.flags || texture != d.texture)
+        {
+            int shader = !d.texture ? 0 : d.flags & SSEGUI_QUAD_SDF ? 2 : 1;
+            auto view = static_cast<ID3D11ShaderResourceView*> (d.texture);
+            context->PSSetShader (quads.pixel_shaders[shader], nullptr, 0);
+            context->PSSetShaderResources (0, 1, &view);
+            flags = d.flags;
+            texture = d.texture;
+        }
+        context->DrawIndexed (d.count * 6, 0, INT (ring_first * 4));
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Render thread, whether anything was queued, so chain_present() can save its state
+
+bool
+any_quads ()
+{
+    return quads.count.load (std::memory_order_relaxed) != 0;
+}
+
+/// Render thread, the tracked device is replaced
+
+void
+quads_device_reset ()
+{
+    release_objects ();
+    quads.failed = false;
+    quads.ring.reset ();
+}
+
+/// Render thread, draw all queued quads onto @param back_buffer, or drop them if none
+
+void
+draw_quads (ID3D11Device* device, ID3D11DeviceContext* context,
+        ID3D11RenderTargetView* back_buffer, UINT width, UINT height)
+{
+    {
+        std::lock_guard<std::mutex> lock (quads.mutex);
+        quads.drawn.swap (quads.queued);
+        quads.queued.clear ();
+        quads.count = 0;
+    }
+    if (!back_buffer || quads.drawn.empty () || !setup_quads (device))
+        return;
+    quads.drawn.sort ();
+
+    float constants[4] = { 2.f / width, -2.f / height };
+    context->UpdateSubresource (quads.constants, 0, nullptr, constants, 0, 0);
+
+    UINT stride = sizeof (quad_vertex), offset = 0;
+    D3D11_VIEWPORT viewport = { 0, 0, float (width), float (height), 0, 1 };
+    context->RSSetViewports (1, &viewport);
+    context->RSSetState (quads.rasterizer);
+    context->IASetInputLayout (quads.input_layout);
+    context->IASetPrimitiveTopology (D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    context->IASetVertexBuffers (0, 1, &quads.vertices, &stride, &offset);
+    context->IASetIndexBuffer (quads.indices, DXGI_FORMAT_R32_UINT, 0);
+    context->VSSetShader (quads.vertex_shader, nullptr, 0);
+    context->VSSetConstantBuffers (0, 1, &quads.constants);
+    context->GSSetShader (nullptr, nullptr, 0);
+    context->HSSetShader (nullptr, nullptr, 0);
+    context->DSSetShader (nullptr, nullptr, 0);
+    context->PSSetSamplers (0, 1, &quads.sampler);
+    context->OMSetRenderTargets (1, &back_buffer, nullptr);
+    context->OMSetBlendState (quads.premultiplied, nullptr, 0xffffffff);
+
+    d3d11_quads backend = { context, -1, nullptr };
+    if (!quads.drawn.flush (quads.ring, backend))
+        log () << "Unable to map the quads vertex buffer." << std::endl;
+
+    ID3D11ShaderResourceView* none = nullptr;
+    context->PSSetShaderResources (0, 1, &none);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @see #ssegui_quads()
+
+bool
+queue_quads (ssegui_quad const* q, std::size_t count)
+{
+    ssegui_error.clear ();
+    if (!q && count)
+    {
+        ssegui_error = __func__ + " no quads"s;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock (quads.mutex);
+    if (quads.queued.size () + count > max_queued)
+    {
+        ssegui_error = __func__ + " too many quads queued"s;
+        return false;
+    }
+    quads.queued.add (q, count);
+    quads.count = quads.queued.size ();
+    extern void wake_present ();
+    wake_present ();
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -31,13 +31,30 @@
 #include <gsl/span>
 
 #include <utils/winutils.hpp>
+#include "listeners.hpp"
+#include "message_dispatch.hpp"
+#include "input_batch.hpp"
+#include "profiler.hpp"
+#include "scheduler.hpp"
+#include "deferred.hpp"
+#include "pipeline_state.hpp"
+#include "gpu_timer.hpp"
+#include "frame_pacing.hpp"
+#include "frame_limiter.hpp"
+#include "parameters.hpp"
 
 #include <string>
 #include <memory>
 #include <vector>
 #include <map>
+#include <array>
+#include <unordered_map>
 #include <algorithm>
 #include <fstream>
+#include <atomic>
+#include <cstdlib>
+#include <iterator>
+#include <mutex>
 
 #include <windows.h>
 #include <dwmapi.h>
@@ -53,7 +70,7 @@ using namespace std::string_literals;
 extern std::ofstream& log ();
 
 /// Defined in sse-gui.cpp
-extern std::string ssegui_error;
+extern thread_local std::string ssegui_error;
 
 /// Defined in sse-gui.cpp
 extern std::string sseh_error ();
@@ -61,6 +78,203 @@ extern std::string sseh_error ();
 /// Defined in skse.cpp
 extern std::unique_ptr<sseh_api> sseh;
 
+/// Defined in parameters.cpp
+extern void publish_pointer (builtin_parameter, void const*);
+extern void publish_integer (builtin_parameter, std::int64_t);
+extern void withdraw_parameter (builtin_parameter);
+
+/// Defined in sse-gui.cpp
+extern std::atomic<bool> ssegui_profiling;
+
+/// Defined in trace.cpp
+extern std::atomic<bool> ssegui_tracing;
+extern void trace_message (unsigned msg, std::uintptr_t wParam, std::intptr_t lParam);
+
+/// Deferred contexts of the tracked device, @see deferred.hpp
+struct d3d11_backend
+{
+    typedef ID3D11DeviceContext context;
+    typedef ID3D11CommandList command_list;
+
+    ID3D11Device* device;
+    ID3D11DeviceContext* immediate;
+
+    context*
+    create_context ()
+    {
+        ID3D11DeviceContext* c = nullptr;
+        if (device && device->CreateDeferredContext (0, &c) != S_OK)
+            c = nullptr;
+        return c;
+    }
+
+    command_list*
+    finish (context* c)
+    {
+        ID3D11CommandList* l = nullptr;
+        if (c->FinishCommandList (FALSE, &l) != S_OK)
+            l = nullptr;
+        return l;
+    }
+
+    void execute (command_list* l) { immediate->ExecuteCommandList (l, TRUE); }
+
+    static void release (IUnknown* p) { p->Release (); }
+};
+
+/// Timestamp queries on the immediate context, @see gpu_timer.hpp
+struct d3d11_query_backend
+{
+    typedef ID3D11Query query;
+
+    ID3D11Device* device;
+    ID3D11DeviceContext* immediate;
+
+    query*
+    create (bool disjoint)
+    {
+        D3D11_QUERY_DESC desc = {
+            disjoint ? D3D11_QUERY_TIMESTAMP_DISJOINT : D3D11_QUERY_TIMESTAMP, 0 };
+        ID3D11Query* q = nullptr;
+        if (device->CreateQuery (&desc, &q) != S_OK)
+            q = nullptr;
+        return q;
+    }
+
+    void begin (query* q) { immediate->Begin (q); }
+    void end (query* q) { immediate->End (q); }
+
+    bool
+    ready (query* q, std::uint64_t& frequency, bool& disjoint)
+    {
+        D3D11_QUERY_DATA_TIMESTAMP_DISJOINT data;
+        if (immediate->GetData (q, &data, sizeof (data), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            return false;
+        frequency = data.Frequency;
+        disjoint = data.Disjoint != FALSE;
+        return true;
+    }
+
+    bool
+    ready (query* q, std::uint64_t& ticks)
+    {
+        UINT64 data;
+        if (immediate->GetData (q, &data, sizeof (data), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            return false;
+        ticks = data;
+        return true;
+    }
+
+    static void release (IUnknown* p) { p->Release (); }
+};
+
+/// D3D11 types for the shared state save/restore, @see pipeline_state.hpp
+struct d3d11_traits
+{
+    typedef ID3D11DeviceContext context;
+    typedef ID3D11Buffer buffer;
+    typedef ID3D11InputLayout input_layout;
+    typedef ID3D11VertexShader vertex_shader;
+    typedef ID3D11PixelShader pixel_shader;
+    typedef ID3D11GeometryShader geometry_shader;
+    typedef ID3D11HullShader hull_shader;
+    typedef ID3D11DomainShader domain_shader;
+    typedef ID3D11ClassInstance class_instance;
+    typedef ID3D11ShaderResourceView shader_resource_view;
+    typedef ID3D11SamplerState sampler_state;
+    typedef ID3D11RasterizerState rasterizer_state;
+    typedef ID3D11RenderTargetView render_target_view;
+    typedef ID3D11DepthStencilView depth_stencil_view;
+    typedef ID3D11BlendState blend_state;
+    typedef ID3D11DepthStencilState depth_stencil_state;
+    typedef D3D11_VIEWPORT viewport;
+    typedef D3D11_RECT rect;
+    typedef DXGI_FORMAT format;
+    typedef D3D11_PRIMITIVE_TOPOLOGY topology;
+};
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+/// Clock of the frame limiter, sleeping on a high resolution timer if the OS has one (1803+)
+struct waitable_clock
+{
+    HANDLE timer = nullptr;     ///< Created on the first sleep
+
+    std::uint64_t now () { return profiler_now (); }
+    void relax () { YieldProcessor (); }
+
+    void
+    sleep (std::uint64_t ns)
+    {
+        if (!timer)
+        {
+            timer = ::CreateWaitableTimerExW (nullptr, nullptr,
+                    CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+            if (!timer)
+                timer = ::CreateWaitableTimerExW (nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+            if (!timer)
+            {
+                ::Sleep (DWORD (ns / 1000000));
+                return;
+            }
+        }
+        LARGE_INTEGER due;
+        due.QuadPart = -LONGLONG (ns / 100); // Relative, in 100ns units
+        if (::SetWaitableTimer (timer, &due, 0, nullptr, nullptr, FALSE))
+            ::WaitForSingleObject (timer, INFINITE);
+    }
+
+    ~waitable_clock ()
+    {
+        if (timer)
+            ::CloseHandle (timer);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+/// Bookkeeping of each render listener
+struct render_info : listener_stats
+{
+    std::atomic<int> flags;
+    budget_state budget;
+    deferred_slot<d3d11_backend> deferred;
+    duration_histogram gpu;     ///< GPU time of each call, while profiling
+
+    render_info () : flags (0) {}
+};
+
+/// Set only on the worker threads, while calling a deferred listener
+static thread_local ID3D11DeviceContext* deferred_context = nullptr;
+
+static void
+to_json (nlohmann::json& j, render_info const& info)
+{
+    j = static_cast<listener_stats const&> (info);
+    j["flags"] = info.flags.load (std::memory_order_relaxed);
+    j["budget"] = info.budget;
+    j["gpu"] = {
+        { "calls", info.gpu.count () },
+        { "mean",  info.gpu.mean () },
+        { "p50",   info.gpu.quantile (.50) },
+        { "p99",   info.gpu.quantile (.99) },
+        { "max",   info.gpu.maximum () }
+    };
+}
+
+/// Detours of one IDXGISwapChain implementation - there may be more, e.g. wrappers of it
+struct chain_detours
+{
+    std::uintptr_t present;     ///< The original Present, as found in the virtual tables
+    std::string present_name;   ///< Of its detour, to enable or disable it
+    HRESULT (WINAPI *present_orig) (IDXGISwapChain*, UINT, UINT);
+    HRESULT (WINAPI *resize_buffers_orig) (IDXGISwapChain*, UINT, UINT, UINT, DXGI_FORMAT, UINT);
+    HRESULT (WINAPI *resize_target_orig) (IDXGISwapChain*, const DXGI_MODE_DESC*);
+    HRESULT (WINAPI *fullscreen_orig) (IDXGISwapChain*, BOOL, IDXGIOutput*);
+};
+
 /// All in one holder of DirectX & Co. fields
 struct render_t
 {
@@ -69,7 +283,13 @@ struct render_t
     IDXGISwapChain*         chain;
     HWND                    window;
     LRESULT (CALLBACK *window_proc_orig) (HWND, UINT, WPARAM, LPARAM);
-    HRESULT (WINAPI *chain_present_orig) (IDXGISwapChain*, UINT, UINT);
+
+    std::mutex hooks_mutex;                 ///< Serializes the changes of the detours below
+    std::array<chain_detours, 4> detours;   ///< Appended only, the first is the game one
+    std::atomic<unsigned> detour_count;
+
+    ID3D11RenderTargetView* back_buffer;    ///< Render thread only, released on ResizeBuffers
+    UINT back_buffer_size[2];
 
     PFN_D3D11_CREATE_DEVICE_AND_SWAP_CHAIN create_device_orig;
 
@@ -79,13 +299,52 @@ struct render_t
         ID3D11Device* device;
         ID3D11DeviceContext* context;
         HWND window;
+        unsigned version;       ///< Of the devices when created, i.e. bigger is newer
     };
-    std::vector<device_record> device_history;
-
-    std::vector<void(SSEGUI_CCONV*)(IDXGISwapChain*,UINT,UINT)> render_listeners;
-    std::vector<LRESULT(SSEGUI_CCONV*)(HWND,UINT,WPARAM,LPARAM)> message_listeners;
+    std::mutex devices_mutex;
+    std::unordered_map<IDXGISwapChain*, device_record> devices; ///< Live ones, by the mutex
+    std::atomic<unsigned> devices_version;  ///< Bumped on each new device
+    IDXGISwapChain* foreign_chain;          ///< Render thread, last seen not to be ours...
+    unsigned foreign_version;               ///< ...as of this version of the devices
+
+    typedef listener<void(SSEGUI_CCONV*)(IDXGISwapChain*,UINT,UINT), render_info>
+        render_listener;
+    typedef ordered_listener<LRESULT(SSEGUI_CCONV*)(HWND,UINT,WPARAM,LPARAM), message_info>
+        message_listener;
+    listener_registry<render_listener> render_listeners;
+    listener_registry<message_listener, message_table<message_listener>> message_listeners;
+    std::atomic<std::uint64_t> message_sequence;    ///< Registrations so far
+    std::map<std::string, int> message_priorities;  ///< By module, set once by the settings
+    typedef listener<void(SSEGUI_CCONV*)(ssegui_input_event const*,int), listener_stats>
+        batch_listener;
+    listener_registry<batch_listener> batch_listeners;
+    std::atomic<bool> batching;                     ///< Whether any batch listener
+    input_batch batch;
+    std::vector<ssegui_input_event> batch_frame;    ///< Render thread only
+    typedef listener<void(SSEGUI_CCONV*)(ssegui_resize_event const*), listener_stats>
+        resize_listener;
+    listener_registry<resize_listener> resize_listeners;  ///< Dispatched from copies, see below
+    std::recursive_mutex resize_mutex;  ///< Serializes them, a listener may resize again
+    typedef listener<void(SSEGUI_CCONV*)(IDXGISwapChain*,UINT,UINT), listener_stats>
+        post_present_listener;
+    listener_registry<post_present_listener> post_present_listeners;
+    frame_scheduler scheduler;
+    deferred_renderer<d3d11_backend> deferred;
+    pipeline_state<d3d11_traits> saved_state;
+    gpu_timer<d3d11_query_backend, std::shared_ptr<render_info>> gpu;   ///< Render thread only
+    frame_pacing pacing;
+    frame_limiter<waitable_clock> limiter;
+    bool limit_before_input;            ///< Wait after Present, not before, @see settings.json
+    unsigned max_frame_latency;         ///< Zero leaves the driver default
     bool enable_rendering;
     bool enable_messaging;
+    std::atomic<bool> present_hooked;   ///< Changed only by sync_hooks()
+    bool window_subclassed;             ///< Ditto
+    std::atomic<unsigned> idle_frames;  ///< Presents in a row with nothing to do
+    bool clip_cursor;           ///< Last requested through clip_cursor()
+
+    unsigned stats_interval;    ///< Seconds between dumping the profiler stats in the log
+    std::uint64_t stats_next;   ///< When to dump them next time
 };
 
 /// One and only one object
@@ -121,42 +380,719 @@ find_top_window_callback (HWND hwnd, LPARAM lParam)
    WM_IME_NOTIFY, WM_GETTEXT, WM_ACTIVATEAPP, WM_QUERYOPEN, WM_SETFOCUS, WM_SYSCOMMAND,
    WM_GETMINMAXINFO, 144, WM_DESTROY, WM_NCDESTROY
 
-   The ones we block are the one found when dinput is switched to non exclusive mode.
+   The ones we block by default (settings.json "window") are the one found when dinput is
+   switched to non exclusive mode: the mouse buttons and wheels, WM_KEYDOWN, WM_KEYUP, WM_CHAR.
 */
 
+/// The WM_INPUT part of input_event(), the handle being in @param e lParam
+
+static bool
+raw_input_event (ssegui_input_event& e, bool& motion)
+{
+    RAWINPUT raw;
+    UINT size = sizeof (raw);
+    if (::GetRawInputData ((HRAWINPUT) e.lParam, RID_INPUT, &raw, &size,
+                sizeof (RAWINPUTHEADER)) == UINT (-1))
+        return false; // E.g. HID data bigger than that
+    if (raw.header.dwType == RIM_TYPEMOUSE)
+    {
+        auto const& m = raw.data.mouse;
+        e.wParam = m.usButtonFlags;
+        e.lParam = short (m.usButtonData);
+        e.dx = m.lLastX;
+        e.dy = m.lLastY;
+        motion = !m.usButtonFlags && !(m.usFlags & MOUSE_MOVE_ABSOLUTE);
+        return true;
+    }
+    if (raw.header.dwType == RIM_TYPEKEYBOARD)
+    {
+        e.wParam = raw.data.keyboard.VKey;
+        e.lParam = raw.data.keyboard.Flags;
+        return true;
+    }
+    return false;
+}
+
 static LRESULT CALLBACK
 window_proc (HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
-    if (dx.enable_messaging)
-        for (auto const& f: dx.message_listeners)
-            f (hWnd, msg, wParam, lParam);
+    if (ssegui_tracing.load (std::memory_order_relaxed))
+        trace_message (msg, wParam, lParam);
+
+    if (dx.enable_messaging && dx.batching.load (std::memory_order_relaxed))
+    {
+        ssegui_input_event e;
+        bool motion;
+        if (input_event (msg, wParam, lParam, profiler_now (), e, motion, raw_input_event))
+            dx.batch.push (e, motion);
+    }
+
+    auto listeners = dx.message_listeners.read ();
+    auto const& list = listeners.list ();
+    bool forward = !dx.enable_messaging ? !list.blocked (msg)
+        : deliver_message (list, msg, ssegui_profiling.load (std::memory_order_relaxed),
+                [&] (auto const& l) { return l.callback (hWnd, msg, wParam, lParam); });
+    if (!forward)
+        return 0;
+
+    return ::CallWindowProc (dx.window_proc_orig, hWnd, msg, wParam, lParam);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Periodically, and only while profiling, the same as ssegui_execute ("stats")
+
+static void
+log_stats ()
+{
+    auto now = profiler_now ();
+    if (now < dx.stats_next)
+        return;
+    bool armed = dx.stats_next;
+    dx.stats_next = now + dx.stats_interval * std::uint64_t (1000000000);
+    if (armed)
+    {
+        extern std::string listener_stats_json ();
+        log () << "Listener stats: " << listener_stats_json () << std::endl;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Kick off the deferred listeners for the next frame, @see deferred.hpp
+
+template<class List>
+static void
+record_deferred (List const& listeners,
+        IDXGISwapChain* pSwapChain, UINT SyncInterval, UINT Flags, bool profile)
+{
+    for (auto const& l: listeners)
+    {
+        if (!(l.info->flags.load (std::memory_order_relaxed) & SSEGUI_RENDER_DEFERRED))
+            continue;
+        auto info = l.info;
+        auto f = l.callback;
+        dx.deferred.record (info, info->deferred, [=] (ID3D11DeviceContext* context) {
+            cost_timer t (profile ? &info->cost : nullptr);
+            deferred_context = context;
+            f (pSwapChain, SyncInterval, Flags);
+            deferred_context = nullptr;
+        });
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Keep a view of the current back buffer, so listeners do not create their own on each frame
+
+static void
+cache_back_buffer ()
+{
+    ID3D11Texture2D* texture = nullptr;
+    if (dx.chain->GetBuffer (0, IID_PPV_ARGS (&texture)) != S_OK)
+        return;
+
+    D3D11_TEXTURE2D_DESC desc;
+    texture->GetDesc (&desc);
+    if (dx.device->CreateRenderTargetView (texture, nullptr, &dx.back_buffer) != S_OK)
+        dx.back_buffer = nullptr;
+    else
+    {
+        dx.back_buffer_size[0] = desc.Width;
+        dx.back_buffer_size[1] = desc.Height;
+        publish_integer (param_back_buffer_width, desc.Width);
+        publish_integer (param_back_buffer_height, desc.Height);
+        publish_pointer (param_back_buffer_rtv, dx.back_buffer);
+    }
+    texture->Release ();
+}
+
+/// Before the buffers go away, withdrawing the view from the plugins first
+
+static void
+release_back_buffer ()
+{
+    withdraw_parameter (param_back_buffer_rtv);
+    withdraw_parameter (param_back_buffer_width);
+    withdraw_parameter (param_back_buffer_height);
+    if (dx.back_buffer)
+        std::exchange (dx.back_buffer, nullptr)->Release ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Any thread, the detours through which @param chain methods get called
 
-    for (UINT i: {
-            WM_LBUTTONDOWN, WM_LBUTTONDBLCLK, WM_RBUTTONDOWN, WM_RBUTTONDBLCLK,
-            WM_MBUTTONDOWN, WM_MBUTTONDBLCLK, WM_XBUTTONDOWN, WM_XBUTTONDBLCLK,
-            WM_LBUTTONUP, WM_RBUTTONUP, WM_MBUTTONUP, WM_XBUTTONUP,
-            WM_MOUSEWHEEL, 0x020E, /*WM_MOUSEHWHEEL*/
-            WM_KEYDOWN, WM_KEYUP, WM_CHAR,
-        })
+static chain_detours const&
+detours_of (IDXGISwapChain* chain)
+{
+    auto present = (*(std::uintptr_t**) chain)[8];
+    auto n = dx.detour_count.load (std::memory_order_acquire);
+    for (unsigned i = 1; i < n; ++i)
+        if (dx.detours[i].present == present)
+            return dx.detours[i];
+    return dx.detours[0]; // Also when another mod replaced the virtual table entry
+}
+
+/// Presents in a row with nothing to do before unhooking, so that sporadic work does not flap it
+static constexpr unsigned idle_presents = 60;
+
+/// Any thread, whether chain_present() has anything to do
+static bool
+present_needed ()
+{
+    if (ssegui_profiling.load (std::memory_order_relaxed))
+        return true; // Frame pacing and GPU times
+    extern bool capture_busy ();
+    extern bool frame_alloc_busy ();
+    if (capture_busy () || dx.limiter.enabled () || dx.batching.load () || frame_alloc_busy ())
+        return true;
+    if (!dx.enable_rendering)
+        return false;
+
+    extern bool layers_registered ();
+    extern bool any_quads ();
+    bool listeners = false;
+    dx.render_listeners.inspect ([&listeners] (auto const& l) { listeners = !l.empty (); });
+    dx.post_present_listeners.inspect ([&listeners] (auto const& l) {
+        listeners = listeners || !l.empty ();
+    });
+    return listeners || layers_registered () || any_quads ();
+}
+
+/// Any thread, whether window_proc() has anything to do
+static bool
+window_proc_needed ()
+{
+    bool listeners = false, blocked = false;
+    dx.message_listeners.inspect ([&listeners, &blocked] (auto const& l) {
+        listeners = !l.empty ();
+        blocked = l.any_blocked ();
+    });
+    listeners = listeners || dx.batching.load ();
+    return (dx.enable_messaging && listeners) || blocked || ssegui_tracing.load ();
+}
+
+/**
+ * Hooks Present and subclasses the window only while there is something to do, so that without
+ * subscribers the game pays nothing, not even the trampoline. Safe from any thread, including
+ * the render thread from within chain_present() - the original Present remains callable.
+ */
+
+void
+sync_hooks ()
+{
+    std::lock_guard<std::mutex> lock (dx.hooks_mutex);
+    auto detours = dx.detour_count.load (std::memory_order_relaxed);
+    if (!detours)
+        return; // Not set up yet, setup_window() calls back
+
+    bool present = present_needed ();
+    if (present != dx.present_hooked.load (std::memory_order_relaxed))
     {
-        if (i == msg)
+        bool ok = sseh->profile ("SSEGUI");
+        for (unsigned i = 0; ok && i < detours; ++i)
         {
-            return 0;
+            auto name = dx.detours[i].present_name.c_str ();
+            ok = present ? sseh->enable (name) : sseh->disable (name);
         }
+        if (ok && sseh->apply ())
+        {
+            dx.idle_frames.store (0, std::memory_order_relaxed);
+            dx.present_hooked.store (present, std::memory_order_relaxed);
+            log () << "IDXGISwapChain.Present" << (present ? " hooked." : " unhooked.")
+                   << std::endl;
+        }
+        else
+            log () << "Unable to " << (present ? "hook " : "unhook ")
+                   << "IDXGISwapChain.Present: " << sseh_error () << std::endl;
     }
 
-    return ::CallWindowProc (dx.window_proc_orig, hWnd, msg, wParam, lParam);
+    bool subclass = window_proc_needed ();
+    if (subclass != dx.window_subclassed && dx.window)
+    {
+        if (subclass)
+            dx.window_proc_orig = (WNDPROC) ::SetWindowLongPtr (
+                    dx.window, GWLP_WNDPROC, (LONG_PTR) window_proc);
+        // Another subclass over ours would be cut off, better keep ours then
+        else if (::GetWindowLongPtr (dx.window, GWLP_WNDPROC) == (LONG_PTR) window_proc)
+            ::SetWindowLongPtr (dx.window, GWLP_WNDPROC, (LONG_PTR) dx.window_proc_orig);
+        else
+            return;
+        dx.window_subclassed = subclass;
+        log () << "Window " << (subclass ? "subclassed." : "no longer subclassed.") << std::endl;
+    }
+}
+
+/// Any thread, work was queued for the next Present which may not be hooked
+
+void
+wake_present ()
+{
+    if (!dx.present_hooked.load (std::memory_order_relaxed))
+        sync_hooks ();
 }
 
 //--------------------------------------------------------------------------------------------------
 
+/// Reads back the GPU times of earlier frames and starts timing this one, never waiting the GPU
+
+static void
+gpu_frame_begin ()
+{
+    auto& b = dx.gpu.backend ();
+    if (b.device != dx.device || b.immediate != dx.context)
+    {
+        dx.gpu.release (); // Queries of another device
+        b.device = dx.device;
+        b.immediate = dx.context;
+    }
+    dx.gpu.collect ([] (std::shared_ptr<render_info> const& info, std::uint64_t ns) {
+        info->gpu.record (ns);
+    });
+    dx.gpu.begin_frame ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+static bool track_chain (IDXGISwapChain*);
+
 static HRESULT WINAPI
 chain_present (IDXGISwapChain* pSwapChain, UINT SyncInterval, UINT Flags)
 {
+    if (!track_chain (pSwapChain))
+        return detours_of (pSwapChain).present_orig (pSwapChain, SyncInterval, Flags);
+
+    dx.pacing.enter (profiler_now ());
+    bool busy = ssegui_profiling.load (std::memory_order_relaxed);
+    if (dx.batching.load (std::memory_order_relaxed))
+    {
+        busy = true;
+        dx.batch.deliver (dx.batch_frame, dx.batch_listeners.read (),
+                ssegui_profiling.load (std::memory_order_relaxed));
+    }
+
     if (dx.enable_rendering)
-        for (auto const& f: dx.render_listeners)
-            f (pSwapChain, SyncInterval, Flags);
-    return dx.chain_present_orig (pSwapChain, SyncInterval, Flags);
+    {
+        if (!dx.back_buffer)
+            cache_back_buffer ();
+
+        extern void font_frame (ID3D11Device*, ID3D11DeviceContext*);
+        font_frame (dx.device, dx.context);
+        extern void upload_frame_begin (ID3D11Device*, ID3D11DeviceContext*);
+        upload_frame_begin (dx.device, dx.context);
+
+        bool profile = ssegui_profiling.load (std::memory_order_relaxed);
+        bool any_deferred = false;
+        dx.deferred.sync ();
+        dx.scheduler.begin_frame ();
+        if (profile)
+            gpu_frame_begin ();
+
+        auto listeners = dx.render_listeners.read ();
+        busy = busy || !listeners.empty ();
+        bool shared_state = std::any_of (listeners.begin (), listeners.end (), [] (auto const& l) {
+            return l.info->flags.load (std::memory_order_relaxed) & SSEGUI_RENDER_SHARED_STATE;
+        });
+
+        for (auto const& l: listeners)
+        {
+            if (l.info->flags.load (std::memory_order_relaxed) & SSEGUI_RENDER_DEFERRED)
+            {
+                int query = profile ? dx.gpu.start (l.info) : -1;
+                dx.deferred.execute (l.info->deferred);
+                dx.gpu.stop (query);
+                any_deferred = true;
+                continue;
+            }
+
+            auto& budget = l.info->budget;
+            bool timed = profile || budget.limited ();
+            auto t0 = timed ? profiler_now () : 0;
+            if (!dx.scheduler.admit (budget, t0))
+                continue;
+
+            if (shared_state)
+                dx.saved_state.capture (dx.context); // Once, before the first immediate listener
+
+            int query = profile ? dx.gpu.start (l.info) : -1;
+            l.callback (pSwapChain, SyncInterval, Flags);
+            dx.gpu.stop (query);
+
+            if (timed)
+            {
+                auto t1 = profiler_now ();
+                if (profile) l.info->cost.record (t1 - t0);
+                dx.scheduler.account (budget, t1 - t0, t1);
+            }
+        }
+
+        if (profile)
+            dx.gpu.end_frame ();
+
+        extern bool any_layers ();
+        bool layers = any_layers ();
+        busy = busy || layers;
+        if (dx.back_buffer && layers)
+        {
+            extern void composite_layers (ID3D11Device*, ID3D11DeviceContext*,
+                    ID3D11RenderTargetView*, UINT, UINT);
+            dx.saved_state.capture (dx.context);
+            composite_layers (dx.device, dx.context, dx.back_buffer,
+                    dx.back_buffer_size[0], dx.back_buffer_size[1]);
+        }
+
+        extern bool any_quads ();
+        if (any_quads ())
+        {
+            busy = true;
+            extern void draw_quads (ID3D11Device*, ID3D11DeviceContext*,
+                    ID3D11RenderTargetView*, UINT, UINT);
+            if (dx.back_buffer)
+                dx.saved_state.capture (dx.context);
+            draw_quads (dx.device, dx.context, dx.back_buffer,
+                    dx.back_buffer_size[0], dx.back_buffer_size[1]);
+        }
+
+        extern void upload_frame_end ();
+        upload_frame_end ();
+
+        dx.saved_state.restore (dx.context);
+        if (any_deferred)
+            record_deferred (listeners.list (), pSwapChain, SyncInterval, Flags, profile);
+        if (profile && dx.stats_interval)
+            log_stats ();
+    }
+
+    // Last, so that everything drawn is in
+    extern bool capture_present (IDXGISwapChain*, ID3D11Device*, ID3D11DeviceContext*);
+    busy = capture_present (pSwapChain, dx.device, dx.context) || busy;
+    busy = busy || dx.limiter.enabled ();
+
+    extern bool frame_alloc_busy ();
+    extern void frame_alloc_next ();
+    busy = busy || frame_alloc_busy ();
+    frame_alloc_next ();
+
+    // E.g. the last quads got drawn, nothing else to do
+    if (busy)
+        dx.idle_frames.store (0, std::memory_order_relaxed);
+    else if (dx.idle_frames.fetch_add (1, std::memory_order_relaxed) + 1 == idle_presents)
+        sync_hooks ();
+
+    dx.pacing.call (profiler_now ());
+    if (!dx.limit_before_input)
+        dx.limiter.wait (); // Counts as blocked in Present
+    HRESULT hres = detours_of (pSwapChain).present_orig (pSwapChain, SyncInterval, Flags);
+    dx.pacing.exit (profiler_now ());
+
+    // Off the critical path: the GPU works on the frame just presented meanwhile
+    if (dx.enable_rendering)
+    {
+        bool profile = ssegui_profiling.load (std::memory_order_relaxed);
+        auto listeners = dx.post_present_listeners.read ();
+        if (!listeners.empty ())
+            dx.idle_frames.store (0, std::memory_order_relaxed);
+        for (auto const& l: listeners)
+        {
+            cost_timer t (profile ? &l.info->cost : nullptr);
+            l.callback (pSwapChain, SyncInterval, Flags);
+        }
+    }
+
+    // The game samples input right after, so it is fresher when the frame gets drawn
+    if (dx.limit_before_input)
+        dx.limiter.wait ();
+    return hres;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Before and after each size or mode change, @see #ssegui_resize_listener()
+///
+/// Any thread may resize, while a registry has only one dispatching thread. Resizes are rare, so
+/// a copy of the list is dispatched instead of a snapshot, one thread after another. As nothing
+/// holds a snapshot then, the writer frees the retired ones itself, @see update_resize_listener()
+
+static void
+notify_resize (ssegui_resize_event& event)
+{
+    std::lock_guard<std::recursive_mutex> lock (dx.resize_mutex);
+    std::vector<render_t::resize_listener> listeners;
+    dx.resize_listeners.inspect ([&listeners] (auto const& list) {
+        listeners.assign (list.begin (), list.end ());
+    });
+    bool profile = ssegui_profiling.load (std::memory_order_relaxed);
+    for (auto const& l: listeners)
+    {
+        cost_timer t (profile ? &l.info->cost : nullptr);
+        l.callback (&event);
+    }
+}
+
+/// Fills in the actual size and mode, then notifies
+
+static HRESULT
+notify_resized (ssegui_resize_event& event, HRESULT result)
+{
+    DXGI_SWAP_CHAIN_DESC desc;
+    if (dx.chain->GetDesc (&desc) == S_OK)
+    {
+        event.width = desc.BufferDesc.Width;
+        event.height = desc.BufferDesc.Height;
+    }
+    BOOL fullscreen = FALSE;
+    if (dx.chain->GetFullscreenState (&fullscreen, nullptr) == S_OK)
+        event.fullscreen = fullscreen;
+
+    event.after = 1;
+    event.result = result;
+    notify_resize (event);
+
+    if (dx.clip_cursor)
+    {
+        extern bool clip_cursor (bool);
+        ::ClipCursor (nullptr);
+        clip_cursor (true); // Only if still in fullscreen
+    }
+    return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// All references to the buffers must be gone, before they can be resized
+
+static HRESULT WINAPI
+chain_resize_buffers (IDXGISwapChain* pSwapChain,
+        UINT BufferCount, UINT Width, UINT Height, DXGI_FORMAT NewFormat, UINT SwapChainFlags)
+{
+    auto const& d = detours_of (pSwapChain);
+    if (pSwapChain != dx.chain)
+        return d.resize_buffers_orig (
+                pSwapChain, BufferCount, Width, Height, NewFormat, SwapChainFlags);
+
+    BOOL fullscreen = FALSE;
+    pSwapChain->GetFullscreenState (&fullscreen, nullptr);
+    ssegui_resize_event event = { SSEGUI_RESIZE_BUFFERS, 0, S_OK, Width, Height, fullscreen };
+    notify_resize (event);
+
+    release_back_buffer ();
+    return notify_resized (event, d.resize_buffers_orig (
+                pSwapChain, BufferCount, Width, Height, NewFormat, SwapChainFlags));
+}
+
+static HRESULT WINAPI
+chain_resize_target (IDXGISwapChain* pSwapChain, const DXGI_MODE_DESC* pNewTargetParameters)
+{
+    auto const& d = detours_of (pSwapChain);
+    if (pSwapChain != dx.chain || !pNewTargetParameters)
+        return d.resize_target_orig (pSwapChain, pNewTargetParameters);
+
+    BOOL fullscreen = FALSE;
+    pSwapChain->GetFullscreenState (&fullscreen, nullptr);
+    ssegui_resize_event event = { SSEGUI_RESIZE_TARGET, 0, S_OK,
+        pNewTargetParameters->Width, pNewTargetParameters->Height, fullscreen };
+    notify_resize (event);
+
+    return notify_resized (event,
+            d.resize_target_orig (pSwapChain, pNewTargetParameters));
+}
+
+static HRESULT WINAPI
+chain_fullscreen (IDXGISwapChain* pSwapChain, BOOL Fullscreen, IDXGIOutput* pTarget)
+{
+    auto const& d = detours_of (pSwapChain);
+    if (pSwapChain != dx.chain)
+        return d.fullscreen_orig (pSwapChain, Fullscreen, pTarget);
+
+    ssegui_resize_event event = { SSEGUI_FULLSCREEN_STATE, 0, S_OK, 0, 0, Fullscreen };
+    notify_resize (event);
+
+    return notify_resized (event, d.fullscreen_orig (pSwapChain, Fullscreen, pTarget));
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Detours the methods of @param chain, unless its implementation already is.
+ *
+ * Detours patch the code of the implementation, so any chain of the same one calls them. A new
+ * chain from another implementation (e.g. a wrapper) needs its own detours and trampolines.
+ */
+
+static bool
+hook_chain (IDXGISwapChain* chain)
+{
+    std::lock_guard<std::mutex> lock (dx.hooks_mutex);
+    auto vtable = *(std::uintptr_t**) chain;
+    auto n = dx.detour_count.load (std::memory_order_relaxed);
+    for (unsigned i = 0; i < n; ++i)
+        if (dx.detours[i].present == vtable[8])
+            return true;
+    if (n == dx.detours.size ())
+    {
+        ssegui_error = __func__ + " too many IDXGISwapChain implementations"s;
+        return false;
+    }
+    if (!sseh->profile ("SSEGUI"))
+    {
+        ssegui_error = __func__ + " SSEH/SSEGUI profile "s + sseh_error ();
+        return false;
+    }
+
+    /*
+    IUnknown: QueryInterface, AddRef, Release = 2,
+    IDXGIObject: SetPrivateData, SetPrivateDataInterface, GetPrivateData, GetParent = 6,
+    IDXGIDeviceSubObject: GetDevice = 7,
+    IDXGISwapChain: Present, GetBuffer, SetFullscreenState, GetFullscreenState, GetDesc = 12,
+                    ResizeBuffers, ResizeTarget, GetContainingOutput, GetFrameStatistics = 16,
+                    GetLastPresentCount = 17
+    */
+    auto& d = dx.detours[n];
+    auto suffix = n ? "#" + std::to_string (n) : ""s;
+    d.present = vtable[8];
+    d.present_name = "IDXGISwapChain.Present" + suffix;
+    struct { unsigned index; std::string name; void* detour; void** original; } const hooks[] = {
+        { 8, d.present_name,
+            (void*) &chain_present, (void**) &d.present_orig },
+        { 10, "IDXGISwapChain.SetFullscreenState" + suffix,
+            (void*) &chain_fullscreen, (void**) &d.fullscreen_orig },
+        { 13, "IDXGISwapChain.ResizeBuffers" + suffix,
+            (void*) &chain_resize_buffers, (void**) &d.resize_buffers_orig },
+        { 14, "IDXGISwapChain.ResizeTarget" + suffix,
+            (void*) &chain_resize_target, (void**) &d.resize_target_orig },
+    };
+    for (auto const& h: hooks)
+    {
+        sseh->map_name (h.name.c_str (), vtable[h.index]);
+        if (!sseh->detour (h.name.c_str (), h.detour, h.original))
+        {
+            ssegui_error = __func__ + " detouring "s + h.name + " "s + sseh_error ();
+            return false;
+        }
+    }
+    // The trampolines must be found as soon as the detours are live
+    dx.detour_count.store (n + 1, std::memory_order_release);
+
+    // Stay in line with the others, e.g. all unhooked
+    if (!dx.present_hooked.load (std::memory_order_relaxed))
+        sseh->disable (d.present_name.c_str ());
+    if (!sseh->apply ())
+    {
+        ssegui_error = __func__ + " applying detours "s + sseh_error ();
+        return false;
+    }
+
+    log () << "IDXGISwapChain implementation " << hex_string (vtable[8]) << " hooked." << std::endl;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// What #ssegui_parameter() and #ssegui_parameter_get() hand out of the current device
+
+static void
+publish_devices ()
+{
+    publish_pointer (param_device, dx.device);
+    publish_pointer (param_context, dx.context);
+    publish_pointer (param_chain, dx.chain);
+    publish_pointer (param_window, dx.window);
+}
+
+/// Fewer frames queued ahead of the GPU, less latency, but less slack for uneven frames
+
+static void
+apply_frame_latency ()
+{
+    if (!dx.max_frame_latency || !dx.device)
+        return;
+    IDXGIDevice1* device = nullptr;
+    if (dx.device->QueryInterface (IID_PPV_ARGS (&device)) != S_OK)
+    {
+        log () << "Unable to query IDXGIDevice1 of the device." << std::endl;
+        return;
+    }
+    if (device->SetMaximumFrameLatency (dx.max_frame_latency) != S_OK)
+        log () << "Unable to set maximum frame latency of " << dx.max_frame_latency << '.'
+               << std::endl;
+    device->Release ();
+}
+
+/// Render thread, moves everything over to the device and chain of @param r
+
+static void
+switch_device (render_t::device_record const& r)
+{
+    log () << "Switching to chain " << r.chain << " and device " << r.device << '.' << std::endl;
+
+    // Plugins release what they made with the old device, SSEGUI too
+    ssegui_resize_event event = { SSEGUI_DEVICE_CHANGE, 0, S_OK, 0, 0, FALSE };
+    notify_resize (event);
+
+    dx.deferred.sync ();
+    dx.render_listeners.inspect ([] (auto const& list) {
+        for (auto const& l: list)
+            dx.deferred.reset (l.info->deferred);
+    });
+    dx.gpu.release ();
+    release_back_buffer ();
+
+    extern void font_device_reset ();
+    extern void upload_device_reset ();
+    extern void layers_device_reset ();
+    extern void quads_device_reset ();
+    extern void capture_device_reset ();
+    font_device_reset ();
+    upload_device_reset ();
+    layers_device_reset ();
+    quads_device_reset ();
+    capture_device_reset ();
+
+    dx.chain = r.chain;
+    dx.device = r.device;
+    dx.context = r.context;
+    dx.deferred.backend () = { dx.device, dx.context };
+    publish_devices ();
+    apply_frame_latency ();
+
+    notify_resized (event, S_OK);
+}
+
+/**
+ * Render thread, whether @param chain is the one to draw on, switching to it if it is a newer one
+ * of the game window. Other chains, e.g. of tools windows, are left alone.
+ */
+
+static bool
+track_chain (IDXGISwapChain* chain)
+{
+    if (chain == dx.chain)
+        return true;
+
+    auto version = dx.devices_version.load (std::memory_order_acquire);
+    if (chain == dx.foreign_chain && version == dx.foreign_version)
+        return false;
+
+    render_t::device_record r;
+    {
+        std::lock_guard<std::mutex> lock (dx.devices_mutex);
+        auto it = dx.devices.find (chain);
+        auto current = dx.devices.find (dx.chain);
+        if (it == dx.devices.end () || it->second.window != dx.window
+                || (current != dx.devices.end () && current->second.version > it->second.version))
+        {
+            dx.foreign_chain = chain;
+            dx.foreign_version = version;
+            return false;
+        }
+        r = it->second;
+        if (current != dx.devices.end ())
+            dx.devices.erase (current); // Replaced, hence stale
+    }
+
+    switch_device (r);
+    return true;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -175,22 +1111,22 @@ setup_window ()
            << " Named window: " << named_window << std::endl;
 
     bool device_selected = false;
-    if (dx.device_history.size ())
     {
-        for (auto const& r: dx.device_history)
+        // The newest, if the game recreated it already
+        std::lock_guard<std::mutex> lock (dx.devices_mutex);
+        unsigned newest = 0;
+        for (auto const& d: dx.devices)
         {
+            auto const& r = d.second;
             if (top_window && top_window == r.window
-                    && named_window && named_window == r.window)
+                    && named_window && named_window == r.window && r.version > newest)
             {
-                if (r.context && r.device && r.chain)
-                {
-                    dx.window = r.window;
-                    dx.chain = r.chain;
-                    dx.context = r.context;
-                    dx.device = r.device;
-                    device_selected = true;
-                    break;
-                }
+                dx.window = r.window;
+                dx.chain = r.chain;
+                dx.context = r.context;
+                dx.device = r.device;
+                newest = r.version;
+                device_selected = true;
             }
         }
     }
@@ -204,33 +1140,16 @@ setup_window ()
     extern bool clip_cursor (bool);
     clip_cursor (true);
 
-    /*
-    IUnknown: QueryInterface, AddRef, Release = 2,
-    IDXGIObject: SetPrivateData, SetPrivateDataInterface, GetPrivateData, GetParent = 6,
-    IDXGIDeviceSubObject: GetDevice = 7,
-    IDXGISwapChain: Present, GetBuffer, SetFullscreenState, GetFullscreenState, GetDesc = 12,
-                    ResizeBuffers, ResizeTarget, GetContainingOutput, GetFrameStatistics = 16,
-                    GetLastPresentCount = 17
-    */
-    if (!sseh->profile ("SSEGUI"))
-    {
-        ssegui_error = __func__ + " SSEH/SSEGUI profile "s + sseh_error ();
-        return false;
-    }
-    auto d3d11present = (*(std::uintptr_t**) dx.chain)[8];
-    auto present_name = "IDXGISwapChain.Present";
-    sseh->map_name (present_name, d3d11present);
-    if (!sseh->detour (present_name, (void*) &chain_present, (void**) &dx.chain_present_orig)
-            || !sseh->apply ())
-    {
-        ssegui_error = __func__ + " detouring "s + present_name + " "s + sseh_error ();
-        return false;
-    }
+    dx.deferred.backend () = { dx.device, dx.context };
+    publish_devices ();
+    apply_frame_latency ();
 
-    dx.window_proc_orig = (WNDPROC) ::SetWindowLongPtr (
-            dx.window, GWLP_WNDPROC, (LONG_PTR) window_proc);
+    dx.present_hooked = true;
+    if (!hook_chain (dx.chain))
+        return false;
+    log () << "IDXGISwapChain hooked." << std::endl;
 
-    log () << present_name << " hooked and window subclassed." << std::endl;
+    sync_hooks ();
     return true;
 }
 
@@ -259,9 +1178,19 @@ create_device (
     if (ppImmediateContext) r.context = *ppImmediateContext;
     if (r.window && r.chain && r.device && r.context)
     {
-        dx.device_history.push_back (r);
+        std::lock_guard<std::mutex> lock (dx.devices_mutex);
+        // Destroyed windows took their chains along
+        for (auto it = dx.devices.begin (); it != dx.devices.end (); )
+            it = ::IsWindow (it->second.window) ? std::next (it) : dx.devices.erase (it);
+        r.version = dx.devices_version.load (std::memory_order_relaxed) + 1;
+        dx.devices[r.chain] = r;
+        dx.devices_version.store (r.version, std::memory_order_release);
     }
 
+    // Already set up: the next Present of it switches over, if it is the game window one
+    if (r.chain && r.window && r.window == dx.window && !hook_chain (r.chain))
+        log () << ssegui_error << std::endl;
+
     log () << "New DX11 device and chain "
            << "(Window: "  << r.window
            << " Chain: "   << r.chain
@@ -296,20 +1225,12 @@ detour_create_device ()
 
 //--------------------------------------------------------------------------------------------------
 
-bool
-render_parameter (std::string const& name, void* value)
-{
-    if (name == "ID3D11Device")
-        *((ID3D11Device**) value) = dx.device;
-    else if (name == "ID3D11DeviceContext")
-        *((ID3D11DeviceContext**) value) = dx.context;
-    else if (name == "IDXGISwapChain")
-        *((IDXGISwapChain**) value) = dx.chain;
-    else if (name == "window")
-        *((HWND*) value) = dx.window;
-    else
-        return false;
-    return true;
+/// Any thread, the deferred context of the listener being recorded on it, if any
+
+void*
+deferred_render_context ()
+{
+    return deferred_context;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -317,33 +1238,396 @@ render_parameter (std::string const& name, void* value)
 bool
 enable_rendering (bool* optional)
 {
-    return std::exchange (dx.enable_rendering, optional ? *optional : dx.enable_rendering);
+    auto old = std::exchange (dx.enable_rendering, optional ? *optional : dx.enable_rendering);
+    if (old != dx.enable_rendering)
+        sync_hooks ();
+    return old;
 }
 
 bool
 enable_messaging (bool* optional)
 {
-    return std::exchange (dx.enable_messaging, optional ? *optional : dx.enable_messaging);
+    auto old = std::exchange (dx.enable_messaging, optional ? *optional : dx.enable_messaging);
+    if (old != dx.enable_messaging)
+        sync_hooks ();
+    return old;
+}
+
+/// Zero picks the count of worker threads for the deferred listeners by the hardware
+
+unsigned
+render_deferred_threads (unsigned* optional)
+{
+    auto n = dx.deferred.threads ();
+    if (optional)
+        dx.deferred.threads (*optional);
+    return n;
+}
+
+/// Frames per second at most, zero for no limit, takes effect on the next Present
+
+double
+frame_rate_limit (double* optional)
+{
+    auto interval = dx.limiter.interval ();
+    if (optional)
+    {
+        dx.limiter.limit (*optional);
+        sync_hooks ();
+    }
+    return interval ? 1e9 / interval : 0;
+}
+
+/// Whether the frame limiter waits after Present, right before the game samples the input
+
+bool
+limit_before_input (bool* optional)
+{
+    return std::exchange (dx.limit_before_input, optional ? *optional : dx.limit_before_input);
+}
+
+/// Zero leaves the driver default, otherwise applied on each device as it gets tracked
+
+unsigned
+max_frame_latency (unsigned* optional)
+{
+    return std::exchange (dx.max_frame_latency, optional ? *optional : dx.max_frame_latency);
+}
+
+/// Zero disables the periodic logging of the profiler stats
+
+unsigned
+stats_log_interval (unsigned* optional)
+{
+    dx.stats_next = 0;
+    return std::exchange (dx.stats_interval, optional ? *optional : dx.stats_interval);
 }
 
 //--------------------------------------------------------------------------------------------------
 
-/// void* as too lazy to type the type when needed.
+/// void* as too lazy to type the type when needed. Safe to call from any thread.
 
 void
 update_render_listener (void* callback, bool remove)
 {
     Expects (callback);
-    if (update_listener (dx.render_listeners, callback, remove))
+    render_t::render_listener l = {
+        reinterpret_cast<decltype (render_t::render_listener::callback)> (callback),
+        std::make_shared<render_info> () };
+    l.info->name = module_name (callback) + "!" + hex_string (callback);
+    if (dx.render_listeners.update (l, remove))
+    {
         log () << "Render callback " << callback << (remove ? " removed.":" added.") << std::endl;
+        sync_hooks ();
+    }
+}
+
+void
+update_post_present_listener (void* callback, bool remove)
+{
+    Expects (callback);
+    render_t::post_present_listener l = {
+        reinterpret_cast<decltype (render_t::post_present_listener::callback)> (callback),
+        std::make_shared<listener_stats> () };
+    l.info->name = module_name (callback) + "!" + hex_string (callback);
+    if (dx.post_present_listeners.update (l, remove))
+    {
+        log () << "Post-Present callback " << callback << (remove ? " removed.":" added.")
+               << std::endl;
+        sync_hooks ();
+    }
 }
 
 void
 update_message_listener (void* callback, bool remove)
 {
     Expects (callback);
-    if (update_listener (dx.message_listeners, callback, remove))
+    auto module = module_name (callback);
+    auto p = dx.message_priorities.find (module);
+    render_t::message_listener l = {
+        { reinterpret_cast<decltype (render_t::message_listener::callback)> (callback),
+          std::make_shared<message_info> () },
+        p != dx.message_priorities.end () ? p->second : 0,
+        dx.message_sequence.fetch_add (1, std::memory_order_relaxed),
+        false };
+    l.info->name = module + "!" + hex_string (callback);
+    if (dx.message_listeners.update (l, remove))
+    {
         log () << "Message callback " << callback << (remove ? " removed.":" added.") << std::endl;
+        sync_hooks ();
+    }
+}
+
+void
+update_batch_listener (void* callback, bool remove)
+{
+    Expects (callback);
+    render_t::batch_listener l = {
+        reinterpret_cast<decltype (render_t::batch_listener::callback)> (callback),
+        std::make_shared<listener_stats> () };
+    l.info->name = module_name (callback) + "!" + hex_string (callback);
+    if (dx.batch_listeners.update (l, remove))
+    {
+        log () << "Input batch callback " << callback << (remove ? " removed.":" added.")
+               << std::endl;
+        bool any = false;
+        dx.batch_listeners.inspect ([&any] (auto const& list) { any = !list.empty (); });
+        if (!any)
+            dx.batch.clear ();
+        dx.batching = any;
+        sync_hooks ();
+    }
+}
+
+void
+update_resize_listener (void* callback, bool remove)
+{
+    Expects (callback);
+    render_t::resize_listener l = {
+        reinterpret_cast<decltype (render_t::resize_listener::callback)> (callback),
+        std::make_shared<listener_stats> () };
+    l.info->name = module_name (callback) + "!" + hex_string (callback);
+    bool changed = dx.resize_listeners.update (l, remove);
+    dx.resize_listeners.quiescent (); // No thread ever reads them, see notify_resize()
+    if (changed)
+        log () << "Resize callback " << callback << (remove ? " removed.":" added.") << std::endl;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Bookkeeping of an already registered render listener, or nullptr
+
+static std::shared_ptr<render_info>
+find_render_info (void* callback)
+{
+    auto f = reinterpret_cast<decltype (render_t::render_listener::callback)> (callback);
+    std::shared_ptr<render_info> info;
+    dx.render_listeners.inspect ([f, &info] (auto const& list) {
+        auto it = std::find_if (list.cbegin (), list.cend (),
+                [f] (auto const& l) { return l.callback == f; });
+        if (it != list.cend ())
+            info = it->info;
+    });
+    if (!info)
+        ssegui_error = "No such render listener "s + hex_string (callback);
+    return info;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @see #ssegui_render_budget()
+
+bool
+render_budget (void* callback, ssegui_budget const* set, ssegui_budget* get)
+{
+    ssegui_error.clear ();
+    auto info = find_render_info (callback);
+    if (!info)
+        return false;
+
+    auto& b = info->budget;
+    if (set)
+    {
+        b.set (std::uint64_t (std::max (set->budget, 0.f) * 1e6),
+               set->min_rate > 0 ? std::uint64_t (1e9 / set->min_rate) : 0);
+        log () << "Render callback " << callback << " budget " << set->budget << "ms at least "
+               << set->min_rate << "Hz." << std::endl;
+    }
+    if (get)
+    {
+        auto interval = b.min_interval.load (std::memory_order_relaxed);
+        get->budget = b.budget.load (std::memory_order_relaxed) * 1e-6f;
+        get->min_rate = interval ? float (1e9 / interval) : 0.f;
+        get->cost = b.cost.load (std::memory_order_relaxed) * 1e-6f;
+        get->skip_ratio = float (b.skip_ratio ());
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @see #ssegui_render_flags()
+
+bool
+render_flags (void* callback, int* flags)
+{
+    Expects (flags);
+    ssegui_error.clear ();
+    auto info = find_render_info (callback);
+    if (!info)
+        return false;
+
+    if (*flags < 0)
+        *flags = info->flags.load ();
+    else
+    {
+        int set = *flags;
+        *flags = info->flags.exchange (set);
+        log () << "Render callback " << callback << " flags " << set << '.' << std::endl;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @see #ssegui_message_filter()
+
+bool
+message_filter (void* callback, int classes, unsigned const* messages, int count)
+{
+    ssegui_error.clear ();
+    if ((classes & ~SSEGUI_MESSAGE_ALL) || count < 0 || (count && !messages))
+    {
+        ssegui_error = __func__ + " invalid argument"s;
+        return false;
+    }
+
+    std::vector<unsigned> explicit_messages (messages, messages + count);
+    std::sort (explicit_messages.begin (), explicit_messages.end ());
+    explicit_messages.erase (std::unique (explicit_messages.begin (), explicit_messages.end ()),
+            explicit_messages.end ());
+
+    auto f = reinterpret_cast<decltype (render_t::message_listener::callback)> (callback);
+    bool found = dx.message_listeners.modify ([&] (auto& list) {
+        auto it = std::find_if (list.begin (), list.end (),
+                [f] (auto const& l) { return l.callback == f; });
+        if (it == list.end ())
+            return false;
+        it->info->filter.classes = classes;
+        it->info->filter.messages = std::move (explicit_messages);
+        return true;
+    });
+    if (!found)
+    {
+        ssegui_error = "No such message listener "s + hex_string (callback);
+        return false;
+    }
+    log () << "Message callback " << callback << " classes " << classes << " and " << count
+           << " more messages." << std::endl;
+    return true;
+}
+
+/// @see #ssegui_message_priority()
+
+bool
+message_priority (void* callback, int priority, bool consumes)
+{
+    ssegui_error.clear ();
+    auto f = reinterpret_cast<decltype (render_t::message_listener::callback)> (callback);
+    auto p = dx.message_priorities.find (module_name (callback));
+    if (p != dx.message_priorities.end ())
+        priority = p->second;
+    bool found = dx.message_listeners.modify ([&] (auto& list) {
+        auto it = std::find_if (list.begin (), list.end (),
+                [f] (auto const& l) { return l.callback == f; });
+        if (it == list.end ())
+            return false;
+        it->priority = priority;
+        it->consumes = consumes;
+        return true;
+    });
+    if (!found)
+    {
+        ssegui_error = "No such message listener "s + hex_string (callback);
+        return false;
+    }
+    log () << "Message callback " << callback << " priority " << priority
+           << (consumes ? " consuming." : ".") << std::endl;
+    return true;
+}
+
+/// Overrides of the message listener priorities by module name (e.g. "plugin.dll")
+
+void
+message_priorities (std::map<std::string, int> const& priorities)
+{
+    dx.message_priorities = priorities;
+}
+
+/// Window messages not forwarded to the game, by name (e.g. "WM_KEYDOWN") or number
+
+void
+block_messages (std::vector<std::string> const& messages)
+{
+    constexpr unsigned named = message_table<render_t::message_listener>::table_size;
+    std::vector<unsigned> ids;
+    for (auto const& m: messages)
+    {
+        unsigned id = 0;
+        while (id < named && m != window_message_text (id))
+            ++id;
+        if (id == named)
+        {
+            char* end = nullptr;
+            auto n = std::strtoul (m.c_str (), &end, 0);
+            if (m.empty () || *end)
+            {
+                log () << "Unknown window message " << m << " not blocked." << std::endl;
+                continue;
+            }
+            id = unsigned (n);
+        }
+        ids.push_back (id);
+    }
+
+    dx.message_listeners.modify ([&ids] (auto& list) {
+        list.block (ids);
+        return true;
+    });
+    log () << "Blocking " << ids.size () << " window messages." << std::endl;
+    sync_hooks ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Profiler statistics of the render, message and resize listeners, @see ssegui_execute ("stats")
+
+void
+render_stats (nlohmann::json& json)
+{
+    dx.render_listeners.inspect ([&json] (auto const& list) {
+        auto& a = json["render"] = nlohmann::json::array ();
+        for (auto const& l: list)
+            a.push_back (*l.info);
+    });
+    dx.post_present_listeners.inspect ([&json] (auto const& list) {
+        auto& a = json["post present"] = nlohmann::json::array ();
+        for (auto const& l: list)
+            a.push_back (*l.info);
+    });
+    json["present"] = dx.pacing;
+    json["limiter"] = dx.limiter;
+    json["gpu"] = {
+        { "timed",    dx.gpu.timed.load () },
+        { "skipped",  dx.gpu.skipped.load () },
+        { "disjoint", dx.gpu.disjoint.load () },
+        { "lost",     dx.gpu.lost.load () }
+    };
+    dx.message_listeners.inspect ([&json] (auto const& list) {
+        auto& a = json["message"] = nlohmann::json::array ();
+        for (auto const& l: list)
+        {
+            a.push_back (*l.info);
+            a.back ()["priority"] = l.priority;
+            a.back ()["consumes"] = l.consumes;
+        }
+    });
+    dx.resize_listeners.inspect ([&json] (auto const& list) {
+        auto& a = json["resize"] = nlohmann::json::array ();
+        for (auto const& l: list)
+            a.push_back (*l.info);
+    });
+    dx.batch_listeners.inspect ([&json] (auto const& list) {
+        auto& j = json["input batch"] = {
+            { "messages", dx.batch.messages.load () },
+            { "events",   dx.batch.events.load () },
+            { "batches",  dx.batch.batches.load () },
+            { "dropped",  dx.batch.dropped.load () },
+            { "listeners", nlohmann::json::array () }
+        };
+        for (auto const& l: list)
+            j["listeners"].push_back (*l.info);
+    });
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -352,6 +1636,7 @@ bool
 clip_cursor (bool clip)
 {
     Expects (dx.window);
+    dx.clip_cursor = clip;
 
     if (!clip)
     {
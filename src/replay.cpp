@@ -0,0 +1,502 @@
+/**
+ * @file replay.cpp
+ * @brief Replays an input trace through the dispatch core, without the game
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Tools
+ *
+ * @details
+ * A trace recorded with #ssegui_execute ("trace"), or a synthetic one, is fed in time order to
+ * what the window procedure and the DirectInput devices of the plugin run: deliver_message(),
+ * input_event() into the #input_batch and the #dinput_filter. Meanwhile a Present cadence at a
+ * fixed rate delivers the input batches and calls the render listeners. Each plugin registers,
+ * as through the API, a message listener with a typical subscription, a batch listener, a render
+ * listener and a control listener. The first plugin is a UI: on top, consuming the keyboard and
+ * the mouse buttons while the disable key has the game input off.
+ *
+ * The window, DXGI and DirectInput ends are stand-ins: the original window procedure and Present
+ * only count what reaches them, the devices hand over the recorded states. Raw input data is not
+ * in the traces, so WM_INPUT replays as a relative mouse motion. Everything runs on one thread,
+ * as fast as it can, so the times are of the dispatch, the stand-ins and trivial plugins.
+ *
+ * Usage: replay [trace|-] [plugins] [fps] [profile]
+ */
+
+#include "message_dispatch.hpp"
+#include "dinput_filter.hpp"
+#include "input_batch.hpp"
+#include "input_trace.hpp"
+#include "listeners.hpp"
+#include "histogram.hpp"
+#include "profiler.hpp"
+
+#include <array>
+#include <random>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+#if defined(__GNUC__)
+#   define NOINLINE __attribute__ ((noinline))
+#else
+#   define NOINLINE __declspec (noinline)
+#endif
+
+// Win32, DXGI and DirectInput stand-ins
+
+typedef void* HWND;
+
+struct IDXGISwapChain
+{
+    std::uint64_t presents = 0;
+    NOINLINE long Present (unsigned, unsigned) { ++presents; return 0; }
+};
+
+struct DIMOUSESTATE2
+{
+    std::int32_t lX, lY, lZ;
+    std::uint8_t rgbButtons[8];
+};
+
+/// What reached the game
+struct game_t
+{
+    std::uint64_t messages = 0;
+    std::uint64_t keys = 0;         ///< Pressed, summed over the keyboard states read
+    std::int64_t x = 0, y = 0;      ///< Mouse motion read
+    std::uint64_t items = 0;        ///< Buffered device data read
+    std::uint64_t flushed = 0;      ///< Buffered device data while the keyboard is disabled
+    std::uint64_t mode_switches = 0;
+};
+
+static game_t game;
+
+/// The original window procedure
+NOINLINE static std::intptr_t
+call_window_proc (HWND, unsigned, std::uintptr_t, std::intptr_t)
+{
+    ++game.messages;
+    return 0;
+}
+
+/// No GetRawInputData
+static bool
+raw_input_event (ssegui_input_event& e, bool& motion)
+{
+    e.wParam = 0;
+    e.lParam = 0;
+    motion = true;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+typedef ordered_listener<std::intptr_t (SSEGUI_CCONV*) (HWND, unsigned, std::uintptr_t,
+                                                        std::intptr_t), message_info>
+    message_listener;
+typedef listener<void (SSEGUI_CCONV*) (ssegui_input_event const*, int), listener_stats>
+    batch_listener;
+typedef listener<void (SSEGUI_CCONV*) (IDXGISwapChain*, unsigned, unsigned), listener_stats>
+    render_listener;
+typedef listener<void (SSEGUI_CCONV*) (int, int), listener_stats> control_listener;
+
+/// The registries of render.cpp and input.cpp, with the same state of the window and devices
+struct core_t
+{
+    listener_registry<message_listener, message_table<message_listener>> message_listeners;
+    listener_registry<batch_listener> batch_listeners;
+    listener_registry<render_listener> render_listeners;
+    listener_registry<control_listener> control_listeners;
+    input_batch batch;
+    std::vector<ssegui_input_event> batch_frame;
+    dinput_filter filter;
+    bool profile = false;
+};
+
+static core_t core;
+
+//--------------------------------------------------------------------------------------------------
+
+/// What a plugin makes of its calls
+struct plugin_state
+{
+    std::uint64_t messages = 0;
+    std::uint64_t events = 0;       ///< In the batches, after merging
+    std::uint64_t merged = 0;       ///< Messages behind the events
+    std::uint64_t frames = 0;
+    std::uint64_t controls = 0;
+};
+
+static constexpr unsigned max_plugins = 32;
+static std::array<plugin_state, max_plugins> plugins;
+
+/// Of the UI, changed by its control listener
+static bool focused = false;
+
+/// What a focused UI consumes
+static constexpr int input_classes = SSEGUI_MESSAGE_KEYBOARD | SSEGUI_MESSAGE_MOUSE_BUTTON;
+
+template<int N>
+static std::intptr_t SSEGUI_CCONV
+on_message (HWND, unsigned msg, std::uintptr_t, std::intptr_t)
+{
+    ++plugins[N].messages;
+    return !N && focused && (message_class (msg) & input_classes) ? SSEGUI_MESSAGE_CONSUME
+                                                                  : SSEGUI_MESSAGE_PASS;
+}
+
+template<int N>
+static void SSEGUI_CCONV
+on_batch (ssegui_input_event const* events, int count)
+{
+    auto& p = plugins[N];
+    for (int i = 0; i < count; ++i)
+        p.merged += events[i].count;
+    p.events += count;
+}
+
+template<int N>
+static void SSEGUI_CCONV
+on_render (IDXGISwapChain*, unsigned, unsigned)
+{
+    ++plugins[N].frames;
+}
+
+template<int N>
+static void SSEGUI_CCONV
+on_control (int keyboard, int)
+{
+    ++plugins[N].controls;
+    if (!N)
+        focused = !keyboard;
+}
+
+template<int... N>
+static void
+register_plugins (unsigned count, std::integer_sequence<int, N...>)
+{
+    static constexpr decltype (&on_message<0>) messages[] = { &on_message<N>... };
+    static constexpr decltype (&on_batch<0>) batches[] = { &on_batch<N>... };
+    static constexpr decltype (&on_render<0>) renders[] = { &on_render<N>... };
+    static constexpr decltype (&on_control<0>) controls[] = { &on_control<N>... };
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        auto info = std::make_shared<message_info> ();
+        info->name = "plugin " + std::to_string (i);
+        switch (i % 8)
+        {
+            case 0: info->filter = { input_classes | SSEGUI_MESSAGE_MOUSE_MOVE, {} }; break;
+            case 1: info->filter = { SSEGUI_MESSAGE_KEYBOARD, {} }; break;
+            case 2: info->filter = { SSEGUI_MESSAGE_FOCUS | SSEGUI_MESSAGE_WINDOW, {} }; break;
+            case 3: info->filter = { SSEGUI_MESSAGE_RAW_INPUT, {} }; break;
+            case 4: info->filter = { SSEGUI_MESSAGE_ALL, {} }; break;
+            case 5: info->filter = { SSEGUI_MESSAGE_IME | SSEGUI_MESSAGE_KEYBOARD, {} }; break;
+            case 6: info->filter = { 0, { 0x0401, 0xC123 } }; break;
+            default: info->filter = { SSEGUI_MESSAGE_FOCUS, { 0x0102 } };
+        }
+        core.message_listeners.insert ({ { messages[i], info }, i ? 0 : 10, i, !i });
+        core.batch_listeners.insert ({ batches[i], std::make_shared<listener_stats> () });
+        core.render_listeners.insert ({ renders[i], std::make_shared<listener_stats> () });
+        core.control_listeners.insert ({ controls[i], std::make_shared<listener_stats> () });
+    }
+
+    // The defaults of settings.json
+    core.message_listeners.modify ([] (auto& list) {
+        list.block ({ 0x201, 0x203, 0x204, 0x206, 0x207, 0x209, 0x20B, 0x20D,
+                      0x202, 0x205, 0x208, 0x20C, 0x20A, 0x20E, 0x100, 0x101, 0x102 });
+        return true;
+    });
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// As window_proc() in render.cpp, tracing aside
+
+static std::intptr_t
+window_proc (HWND hWnd, unsigned msg, std::uintptr_t wParam, std::intptr_t lParam)
+{
+    ssegui_input_event e;
+    bool motion;
+    if (input_event (msg, wParam, lParam, profiler_now (), e, motion, raw_input_event))
+        core.batch.push (e, motion);
+
+    auto listeners = core.message_listeners.read ();
+    if (!deliver_message (listeners.list (), msg, core.profile, [&] (auto const& l) {
+                return l.callback (hWnd, msg, wParam, lParam); }))
+        return 0;
+
+    return call_window_proc (hWnd, msg, wParam, lParam);
+}
+
+/// As the keyboard_callback() of input.cpp
+static void
+keyboard_callback (std::uint8_t const* keys)
+{
+    if (core.filter.keyboard_state (keys))
+    {
+        ++game.mode_switches;
+        core.filter.notify (core.control_listeners.read (), core.profile);
+    }
+}
+
+/// As input_device<true>::GetDeviceState in input.cpp, with the recorded state
+static void
+read_keyboard (trace_record const& r)
+{
+    std::uint8_t keys[256];
+    for (unsigned k = 0; k < 256; ++k)
+        keys[k] = trace_key (r, k) ? 0x80 : 0;
+    keyboard_callback (keys);
+    core.filter.filter_keyboard (keys, sizeof (keys));
+    for (auto k: keys)
+        game.keys += k >> 7;
+}
+
+/// As input_device<false>::GetDeviceState
+static void
+read_mouse (trace_record const& r)
+{
+    auto m = read_trace_mouse (r);
+    DIMOUSESTATE2 state = { m.x, m.y, m.z, {} };
+    for (unsigned b = 0; b < 8; ++b)
+        state.rgbButtons[b] = (m.buttons >> b) & 1 ? 0x80 : 0;
+    if (core.filter.mouse_disabled)
+        state = DIMOUSESTATE2 {};
+    game.x += state.lX;
+    game.y += state.lY;
+}
+
+/// As input_device::GetDeviceData, the keyboard state being read first there too
+static void
+read_device_data (trace_record const& r)
+{
+    bool mouse;
+    trace_device_item items[2];
+    auto n = read_trace_device_data (r, mouse, items);
+    if (!mouse && core.filter.keyboard_disabled)
+        game.flushed += n;
+    else
+        game.items += n;
+}
+
+/// As the input and render parts of chain_present()
+static void
+present (IDXGISwapChain& chain)
+{
+    core.batch.deliver (core.batch_frame, core.batch_listeners.read (), core.profile);
+    for (auto const& l: core.render_listeners.read ())
+    {
+        cost_timer t (core.profile ? &l.info->cost : nullptr);
+        l.callback (&chain, 1, 0);
+    }
+    chain.Present (1, 0);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// A 1000Hz mouse, typing, clicks, the game polling DirectInput each frame, and the UI opened
+/// and closed with the disable key every 10 seconds
+static std::vector<trace_record>
+synthetic_trace (double seconds)
+{
+    constexpr unsigned disable_key = 210;
+    std::mt19937 rng (42);
+    std::uniform_int_distribution<int> motion (-3, 3), chance (0, 999);
+    std::vector<trace_record> trace;
+    std::array<std::uint8_t, 256> keys = {};
+    std::uint8_t buttons[8] = {};
+    std::int32_t dx = 0, dy = 0;
+    std::uint64_t frame = 0, sequence = 0;
+    for (std::uint64_t t = 0; t < std::uint64_t (seconds * 1e9); t += 1000000)
+    {
+        for (; frame <= t; frame += 16666667)
+        {
+            bool toggle = frame % 10000000000 < 16666667 && frame;
+            keys[disable_key] = toggle ? 0x80 : 0;
+            trace.push_back (make_trace_keyboard (frame, keys.data ()));
+            trace.push_back (make_trace_mouse (frame, dx, dy, 0, buttons));
+            dx = dy = 0;
+        }
+
+        trace.push_back (make_trace_message (t, 0x00FF, 0, 0x1234));   // WM_INPUT
+        trace.push_back (make_trace_message (t, 0x0084, 0, 0));        // WM_NCHITTEST
+        trace.push_back (make_trace_message (t, 0x0020, 0, 0));        // WM_SETCURSOR
+        trace.push_back (make_trace_message (t, 0x0200, 0, t & 0xFFFF)); // WM_MOUSEMOVE
+        dx += motion (rng);
+        dy += motion (rng);
+
+        auto c = chance (rng);
+        if (c < 10) // Typing, 10 keys per second
+        {
+            trace_device_item items[2] = { { 0x1E, 0x80, std::uint32_t (t / 1000000), 0 },
+                                           { 0x1E, 0x00, std::uint32_t (t / 1000000), 0 } };
+            items[0].sequence = std::uint32_t (sequence++);
+            items[1].sequence = std::uint32_t (sequence++);
+            trace.push_back (make_trace_message (t, 0x0100, 'A', 0));
+            trace.push_back (make_trace_message (t, 0x0102, 'a', 0));
+            trace.push_back (make_trace_message (t, 0x0101, 'A', 0));
+            trace.push_back (make_trace_device_data (t, false, items, 2));
+        }
+        else if (c < 15)
+        {
+            trace.push_back (make_trace_message (t, 0x0201, 1, 0));
+            trace.push_back (make_trace_message (t, 0x0202, 0, 0));
+        }
+        else if (c < 17)
+            trace.push_back (make_trace_message (t, 0x020A, 120 << 16, 0));
+        else if (c < 77)
+            trace.push_back (make_trace_message (t, 0x0113, 1, 0));    // WM_TIMER
+    }
+    return trace;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    const char* path = argc > 1 ? argv[1] : "-";
+    unsigned count = argc > 2 ? std::min<unsigned> (std::atoi (argv[2]), max_plugins) : 8;
+    double fps = argc > 3 ? std::atof (argv[3]) : 60;
+    core.profile = argc > 4 && std::atoi (argv[4]);
+    if (fps <= 0)
+        fps = 60;
+
+    std::vector<trace_record> trace;
+    if (std::strcmp (path, "-"))
+    {
+        std::uint64_t start;
+        std::FILE* f = std::fopen (path, "rb");
+        bool ok = f && trace_load (f, trace, start);
+        if (f)
+            std::fclose (f);
+        if (!ok && trace.empty ())
+        {
+            std::cerr << "Unable to read the input trace " << path << std::endl;
+            return 1;
+        }
+    }
+    else
+        trace = synthetic_trace (60);
+
+    core.filter.disable_key = 210;
+    register_plugins (count, std::make_integer_sequence<int, max_plugins> ());
+
+    // Each record, with the Presents due before it
+    IDXGISwapChain chain;
+    duration_histogram frame_cost;
+    std::uint64_t messages = 0, states = 0, items = 0, dropped = 0;
+    std::uint64_t message_ns = 0, state_ns = 0, item_ns = 0;
+    std::uint64_t interval = std::uint64_t (1e9 / fps), next = 0;
+    for (auto const& r: trace)
+    {
+        for (; next <= r.time; next += interval)
+        {
+            auto t0 = profiler_now ();
+            present (chain);
+            frame_cost.record (profiler_now () - t0);
+        }
+
+        auto t0 = profiler_now ();
+        switch (r.kind)
+        {
+            case trace_kind::message:
+            {
+                auto m = read_trace_message (r);
+                window_proc (nullptr, m.msg, std::uintptr_t (m.wParam), std::intptr_t (m.lParam));
+                message_ns += profiler_now () - t0;
+                ++messages;
+                break;
+            }
+            case trace_kind::keyboard:
+                read_keyboard (r);
+                state_ns += profiler_now () - t0;
+                ++states;
+                break;
+            case trace_kind::mouse:
+                read_mouse (r);
+                state_ns += profiler_now () - t0;
+                ++states;
+                break;
+            case trace_kind::device_data:
+                read_device_data (r);
+                item_ns += profiler_now () - t0;
+                ++items;
+                break;
+            case trace_kind::dropped:
+                dropped += trace_get<std::uint64_t> (r, 0);
+                break;
+        }
+    }
+    auto t0 = profiler_now ();
+    present (chain);
+    frame_cost.record (profiler_now () - t0);
+
+    // Whatever the trace, the plugins must have seen all of it
+    std::uint64_t consumed = 0;
+    core.message_listeners.inspect ([&consumed] (auto const& list) {
+        for (auto const& l: list)
+            consumed += l.info->stopped.load ();
+    });
+    auto blocked = messages - consumed - game.messages;
+    bool bad = core.batch.dropped.load ();
+    for (unsigned i = 0; i < count; ++i)
+    {
+        auto const& p = plugins[i];
+        bad = bad || p.merged != core.batch.messages.load () || p.frames != chain.presents
+                  || p.controls != game.mode_switches;
+    }
+
+    auto frames = chain.presents;
+    std::cout << "records:                " << trace.size ()
+                                            << (dropped ? " (some dropped while recording)" : "")
+                                            << '\n'
+              << "plugins:                " << count << '\n'
+              << "frames:                 " << frames << '\n'
+              << "messages:               " << messages << '\n'
+              << "  to the game:          " << game.messages << '\n'
+              << "  consumed by the UI:   " << consumed << '\n'
+              << "  blocked:              " << blocked << '\n'
+              << "batched events:         " << core.batch.events.load ()
+                                            << " of " << core.batch.messages.load () << '\n'
+              << "device states:          " << states << '\n'
+              << "  keys seen by the game: " << game.keys << '\n'
+              << "device data records:    " << items << '\n'
+              << "  items flushed:        " << game.flushed << '\n'
+              << "disable key toggles:    " << game.mode_switches << '\n'
+              << "ns per message:         " << (messages ? double (message_ns) / messages : 0.)
+                                            << '\n'
+              << "ns per device state:    " << (states ? double (state_ns) / states : 0.) << '\n'
+              << "ns per device data:     " << (items ? double (item_ns) / items : 0.) << '\n'
+              << "ns per frame mean:      " << frame_cost.mean () << '\n'
+              << "ns per frame p50/p99:   " << frame_cost.quantile (.5) << '/'
+                                            << frame_cost.quantile (.99) << '\n'
+              << "ns per frame max:       " << frame_cost.maximum () << std::endl;
+
+    return bad ? 1 : 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,170 @@
+/**
+ * @file scheduler.hpp
+ * @brief Frame budget scheduling of the render listeners
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * A listener may declare how much CPU time per frame it is allowed to take and how often it must
+ * be called regardless. The scheduler tracks a smoothed cost of each call. Listeners within their
+ * budget run every frame. The ones above it run every Nth frame, where N is the ratio of cost to
+ * budget, so on average they stay within. In between, they are still called on frames where the
+ * other budgeted listeners left enough slack (unused budget), or when the minimum rate is due.
+ *
+ * The smoothed cost starts from the budget, not from the first call, which often does a one-time
+ * setup (shader compiles, texture loads). Likewise, one call moves it by at most a few times its
+ * current value, so a single spike costs a couple of skipped frames, not seconds of them.
+ *
+ * The budget and rate are set from any thread, the rest is touched only by the render thread and
+ * read elsewhere through relaxed atomics.
+ */
+
+#ifndef SSEGUI_SCHEDULER_HPP
+#define SSEGUI_SCHEDULER_HPP
+
+#include "histogram.hpp"
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+//--------------------------------------------------------------------------------------------------
+
+struct budget_state
+{
+    std::atomic<std::uint64_t> budget;          ///< Nanoseconds per frame, zero for unlimited
+    std::atomic<std::uint64_t> min_interval;    ///< Nanoseconds between two calls at most, or zero
+    std::atomic<std::uint64_t> cost;            ///< Smoothed nanoseconds per call, zero for none
+    std::atomic<std::uint64_t> frames;          ///< Since the budget was set
+    std::atomic<std::uint64_t> skips;           ///< Ditto
+
+    std::uint64_t last_run = 0;
+    unsigned waited = 0;
+
+    budget_state () noexcept : budget (0), min_interval (0), cost (0), frames (0), skips (0) {}
+
+    bool limited () const noexcept { return budget.load (std::memory_order_relaxed) != 0; }
+
+    /// Frames every which the listener is called, in average
+    unsigned
+    period () const noexcept
+    {
+        auto b = budget.load (std::memory_order_relaxed);
+        auto c = cost.load (std::memory_order_relaxed);
+        return b && c > b ? unsigned (std::min<std::uint64_t> ((c + b - 1) / b, 1000)) : 1;
+    }
+
+    double
+    skip_ratio () const noexcept
+    {
+        auto f = frames.load (std::memory_order_relaxed);
+        return f ? double (skips.load (std::memory_order_relaxed)) / f : 0.;
+    }
+
+    /// From any thread, also restarts the statistics
+    void
+    set (std::uint64_t budget_ns, std::uint64_t min_interval_ns) noexcept
+    {
+        budget.store (budget_ns, std::memory_order_relaxed);
+        min_interval.store (min_interval_ns, std::memory_order_relaxed);
+        frames.store (0, std::memory_order_relaxed);
+        skips.store (0, std::memory_order_relaxed);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+class frame_scheduler
+{
+    std::int64_t slack_ = 0;
+
+public:
+    /// Of the smoothed cost, one call counts as that many times it at most
+    static constexpr std::uint64_t max_growth = 4;
+
+    /// Before the first listener of each frame
+    void begin_frame () noexcept { slack_ = 0; }
+
+    /// Unused budget so far in this frame
+    std::int64_t slack () const noexcept { return slack_; }
+
+    /// Whether to call the listener in this frame, @param now as in #profiler_now()
+    bool
+    admit (budget_state& s, std::uint64_t now) noexcept
+    {
+        auto budget = std::int64_t (s.budget.load (std::memory_order_relaxed));
+        if (!budget)
+            return true;
+        relaxed_add (s.frames);
+
+        auto cost = std::int64_t (s.cost.load (std::memory_order_relaxed));
+        auto interval = s.min_interval.load (std::memory_order_relaxed);
+
+        bool run = cost <= budget
+            || ++s.waited >= s.period ()
+            || (interval && now - s.last_run >= interval)
+            || cost - budget <= slack_;
+        if (!run)
+        {
+            slack_ += budget;
+            relaxed_add (s.skips);
+        }
+        return run;
+    }
+
+    /// After the admitted listener returned, @param spent nanoseconds in it
+    void
+    account (budget_state& s, std::uint64_t spent, std::uint64_t now) noexcept
+    {
+        auto budget = std::int64_t (s.budget.load (std::memory_order_relaxed));
+        if (!budget)
+            return;
+        slack_ += budget - std::int64_t (spent);
+        s.waited = 0;
+        s.last_run = now;
+        auto c = s.cost.load (std::memory_order_relaxed);
+        if (!c)
+            c = std::uint64_t (budget);
+        spent = std::min (spent, max_growth * std::max (c, std::uint64_t (budget)));
+        c = c - c / 8 + spent / 8; // 1/8 exponential smoothing
+        s.cost.store (c, std::memory_order_relaxed);
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+inline void
+to_json (nlohmann::json& j, budget_state const& s)
+{
+    j = nlohmann::json {
+        { "budget",         s.budget.load (std::memory_order_relaxed) },
+        { "min interval",   s.min_interval.load (std::memory_order_relaxed) },
+        { "cost",           s.cost.load (std::memory_order_relaxed) },
+        { "period",         s.period () },
+        { "skip ratio",     s.skip_ratio () }
+    };
+}
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,92 @@
+/**
+ * @file shaders.cpp
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Run-time compilation of the few shaders SSEGUI draws with. The compiler DLL is part of Windows
+ * since 8.1, so it is loaded on first use instead of being a link time dependency.
+ */
+
+#include <utils/winutils.hpp>
+
+#include <string>
+#include <utility>
+
+#include <windows.h>
+#include <d3d11.h>
+#include <d3dcompiler.h>
+
+//--------------------------------------------------------------------------------------------------
+
+using namespace std::string_literals;
+
+/// Defined in sse-gui.cpp
+extern thread_local std::string ssegui_error;
+
+//--------------------------------------------------------------------------------------------------
+
+/**
+ * Compile HLSL @param source, e.g. for @param target "vs_5_0" or "ps_5_0"
+ *
+ * @returns the bytecode, or nullptr with the compiler output in ssegui_error
+ */
+
+ID3DBlob*
+compile_shader (std::string const& source, const char* entry, const char* target)
+{
+    static pD3DCompile compile = nullptr;
+    if (!compile)
+    {
+        HMODULE dll = ::LoadLibraryA (D3DCOMPILER_DLL_A);
+        if (!dll)
+        {
+            ssegui_error = __func__ + " "s + D3DCOMPILER_DLL_A + " "s
+                + format_utf8message (::GetLastError ());
+            return nullptr;
+        }
+        compile = reinterpret_cast<pD3DCompile> (::GetProcAddress (dll, "D3DCompile"));
+        if (!compile)
+        {
+            ssegui_error = __func__ + " D3DCompile "s + format_utf8message (::GetLastError ());
+            return nullptr;
+        }
+    }
+
+    ID3DBlob* code = nullptr;
+    ID3DBlob* errors = nullptr;
+    HRESULT hres = compile (source.data (), source.size (), "sse-gui", nullptr, nullptr,
+            entry, target, D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, &code, &errors);
+    if (hres != S_OK)
+    {
+        ssegui_error = __func__ + " "s + entry + " "s + hex_string (hres);
+        if (errors)
+            ssegui_error += " "s + static_cast<const char*> (errors->GetBufferPointer ());
+        if (code)
+            std::exchange (code, nullptr)->Release ();
+    }
+    if (errors)
+        errors->Release ();
+    return code;
+}
+
+//--------------------------------------------------------------------------------------------------
+
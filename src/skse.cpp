@@ -41,6 +41,8 @@ typedef std::uint64_t UInt64;
 #include <skse/PluginAPI.h>
 
 #include <vector>
+#include <string>
+#include <map>
 #include <memory>
 #include <chrono>
 #include <fstream>
@@ -238,6 +240,82 @@ load_settings ()
 
         extern unsigned dinput_disable_key (unsigned* optional);
         dinput_disable_key (&disable_key);
+
+        std::vector<std::string> blocked = {
+            "WM_LBUTTONDOWN", "WM_LBUTTONDBLCLK", "WM_RBUTTONDOWN", "WM_RBUTTONDBLCLK",
+            "WM_MBUTTONDOWN", "WM_MBUTTONDBLCLK", "WM_XBUTTONDOWN", "WM_XBUTTONDBLCLK",
+            "WM_LBUTTONUP", "WM_RBUTTONUP", "WM_MBUTTONUP", "WM_XBUTTONUP",
+            "WM_MOUSEWHEEL", "0x020E", "WM_KEYDOWN", "WM_KEYUP", "WM_CHAR" };
+        std::map<std::string, int> priorities;
+        if (json.contains ("window"))
+        {
+            auto& j = json["window"];
+            if (j.contains ("blocked messages"))
+            {
+                blocked.clear ();
+                for (auto const& m: j["blocked messages"])
+                    blocked.push_back (m.is_string () ? m.get<std::string> ()
+                                                      : std::to_string (m.get<unsigned> ()));
+            }
+            priorities = j.value ("message priorities", priorities);
+        }
+
+        extern void block_messages (std::vector<std::string> const&);
+        extern void message_priorities (std::map<std::string, int> const&);
+        block_messages (blocked);
+        message_priorities (priorities);
+
+        bool profile = false;
+        unsigned log_interval = 60;
+        if (json.contains ("profiler"))
+        {
+            auto& j = json["profiler"];
+            profile = j.value ("enabled", profile);
+            log_interval = j.value ("log interval", log_interval);
+        }
+
+        unsigned deferred_threads = 0;
+        if (json.contains ("render"))
+        {
+            auto& j = json["render"];
+            deferred_threads = j.value ("deferred threads", deferred_threads);
+        }
+
+        extern unsigned render_deferred_threads (unsigned* optional);
+        render_deferred_threads (&deferred_threads);
+
+        double fps = 0;
+        bool before_input = false;
+        unsigned frame_latency = 0;
+        if (json.contains ("limiter"))
+        {
+            auto& j = json["limiter"];
+            fps = j.value ("fps", fps);
+            before_input = j.value ("low latency", before_input);
+            frame_latency = j.value ("max frame latency", frame_latency);
+        }
+
+        extern double frame_rate_limit (double* optional);
+        extern bool limit_before_input (bool* optional);
+        extern unsigned max_frame_latency (unsigned* optional);
+        frame_rate_limit (&fps);
+        limit_before_input (&before_input);
+        max_frame_latency (&frame_latency);
+
+        std::string trace;
+        if (json.contains ("trace"))
+            trace = json["trace"].value ("file", trace);
+        if (!trace.empty ())
+        {
+            extern bool trace_start (const char* path);
+            if (!trace_start (trace.c_str ()))
+                log () << "Input trace into " << trace << " failed to start." << std::endl;
+        }
+
+        extern bool enable_profiling (bool* optional);
+        extern unsigned stats_log_interval (unsigned* optional);
+        enable_profiling (&profile);
+        stats_log_interval (&log_interval);
     }
     catch (std::exception const& ex)
     {
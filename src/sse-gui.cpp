@@ -28,6 +28,7 @@
 
 #include <sse-gui/sse-gui.h>
 #include <utils/winutils.hpp>
+#include <nlohmann/json.hpp>
 
 #include <cstring>
 #include <string>
@@ -35,6 +36,7 @@
 #include <locale>
 #include <algorithm>
 #include <fstream>
+#include <atomic>
 
 #include <windows.h>
 
@@ -42,8 +44,12 @@
 
 using namespace std::string_literals;
 
-/// [shared] Supports SSEGUI specific errors in a manner of #GetLastError() and #FormatMessage()
-std::string ssegui_error;
+/// [shared] Supports SSEGUI specific errors in a manner of #GetLastError() and #FormatMessage(),
+/// also in that it is kept per thread
+thread_local std::string ssegui_error;
+
+/// [shared] Whether to measure the CPU cost of each listener call
+std::atomic<bool> ssegui_profiling;
 
 //--------------------------------------------------------------------------------------------------
 
@@ -61,7 +67,46 @@ ssegui_last_error ()
 
 //--------------------------------------------------------------------------------------------------
 
-//--------------------------------------------------------------------------------------------------
+bool
+enable_profiling (bool* optional)
+{
+    if (!optional)
+        return ssegui_profiling.load ();
+    bool old = ssegui_profiling.exchange (*optional);
+    if (old != *optional)
+    {
+        extern void sync_hooks ();
+        sync_hooks ();
+    }
+    return old;
+}
+
+/// [shared] Listener profiler statistics, @see #ssegui_execute()
+
+std::string
+listener_stats_json ()
+{
+    extern void render_stats (nlohmann::json&);
+    extern void input_stats (nlohmann::json&);
+    extern void layer_stats (nlohmann::json&);
+    extern void frame_alloc_stats (nlohmann::json&);
+    extern void upload_stats (nlohmann::json&);
+    extern void capture_stats (nlohmann::json&);
+    extern void trace_stats (nlohmann::json&);
+
+    nlohmann::json json = {
+        { "profiling", ssegui_profiling.load () },
+        { "unit", "ns" }
+    };
+    render_stats (json);
+    layer_stats (json);
+    input_stats (json);
+    frame_alloc_stats (json);
+    upload_stats (json);
+    capture_stats (json);
+    trace_stats (json);
+    return json.dump ();
+}
 
 //--------------------------------------------------------------------------------------------------
 
@@ -150,6 +195,133 @@ ssegui_render_listener (ssegui_render_callback callback, int remove)
     update_render_listener ((void*) callback, !!remove);
 }
 
+SSEGUI_API int SSEGUI_CCONV
+ssegui_present_listener (ssegui_render_callback callback, int phase, int remove)
+{
+    ssegui_error.clear ();
+    if (!callback || (phase != SSEGUI_PRESENT_BEFORE && phase != SSEGUI_PRESENT_AFTER))
+    {
+        ssegui_error = __func__ + " invalid argument"s;
+        return false;
+    }
+    extern void update_render_listener (void* callback, bool remove);
+    extern void update_post_present_listener (void* callback, bool remove);
+    if (phase == SSEGUI_PRESENT_BEFORE)
+        update_render_listener ((void*) callback, !!remove);
+    else
+        update_post_present_listener ((void*) callback, !!remove);
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_render_budget (ssegui_render_callback callback,
+        struct ssegui_budget const* set, struct ssegui_budget* get)
+{
+    extern bool render_budget (void* callback, ssegui_budget const* set, ssegui_budget* get);
+    return render_budget ((void*) callback, set, get);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_render_flags (ssegui_render_callback callback, int* flags)
+{
+    extern bool render_flags (void* callback, int* flags);
+    return render_flags ((void*) callback, flags);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API void SSEGUI_CCONV
+ssegui_resize_listener (ssegui_resize_callback callback, int remove)
+{
+    static_assert (std::is_same<long, HRESULT>::value, "Resize event type mismatch");
+
+    extern void update_resize_listener (void* callback, bool remove);
+    update_resize_listener ((void*) callback, !!remove);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API void SSEGUI_CCONV
+ssegui_layer_listener (ssegui_layer_callback callback, int remove)
+{
+    extern void update_layer_listener (void* callback, bool remove);
+    update_layer_listener ((void*) callback, !!remove);
+}
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_layer_state (ssegui_layer_callback callback,
+        struct ssegui_layer const* set, struct ssegui_layer* get)
+{
+    extern bool layer_state (void* callback, ssegui_layer const* set, ssegui_layer* get);
+    return layer_state ((void*) callback, set, get);
+}
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_layer_invalidate (ssegui_layer_callback callback, struct ssegui_rect const* rect)
+{
+    extern bool layer_invalidate (void* callback, ssegui_rect const* rect);
+    return layer_invalidate ((void*) callback, rect);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_font (const char* face, int weight, int* font)
+{
+    extern bool load_font (const char* face, int weight, int* font);
+    return load_font (face, weight, font);
+}
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_font_glyphs (int font, const char* text, size_t size,
+        size_t* count, struct ssegui_glyph* glyphs)
+{
+    extern bool font_glyphs (int font, const char* text, std::size_t size,
+            std::size_t* count, ssegui_glyph* out);
+    return font_glyphs (font, text, size, count, glyphs);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_quads (const struct ssegui_quad* quads, size_t count)
+{
+    extern bool queue_quads (ssegui_quad const*, std::size_t);
+    return queue_quads (quads, count);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API void* SSEGUI_CCONV
+ssegui_frame_alloc (size_t size, size_t alignment)
+{
+    extern void* frame_allocate (std::size_t, std::size_t);
+    return frame_allocate (size, alignment);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_upload (int kind, const void* data, size_t size, size_t alignment,
+        struct ssegui_upload_range* out)
+{
+    extern bool upload (int, void const*, std::size_t, std::size_t, ssegui_upload_range*);
+    return upload (kind, data, size, alignment, out);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_capture (const char* path, int format, int frames)
+{
+    extern bool capture_frames (const char*, int, int);
+    return capture_frames (path, format, frames);
+}
+
 //--------------------------------------------------------------------------------------------------
 
 SSEGUI_API void SSEGUI_CCONV
@@ -167,11 +339,60 @@ ssegui_message_listener (ssegui_message_callback callback, int remove)
 
 //--------------------------------------------------------------------------------------------------
 
+SSEGUI_API int SSEGUI_CCONV
+ssegui_message_filter (ssegui_message_callback callback,
+        int classes, unsigned const* messages, int count)
+{
+    extern bool message_filter (void*, int, unsigned const*, int);
+    return message_filter ((void*) callback, classes, messages, count);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_message_priority (ssegui_message_callback callback, int priority, int consumes)
+{
+    extern bool message_priority (void*, int, bool);
+    return message_priority ((void*) callback, priority, !!consumes);
+}
+
+//--------------------------------------------------------------------------------------------------
+
+SSEGUI_API void SSEGUI_CCONV
+ssegui_input_batch_listener (ssegui_input_batch_callback callback, int remove)
+{
+    extern void update_batch_listener (void* callback, bool remove);
+    update_batch_listener ((void*) callback, !!remove);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 SSEGUI_API int SSEGUI_CCONV
 ssegui_parameter (const char* name, void* value)
 {
-    extern bool render_parameter (std::string const&, void*);
-    return render_parameter (name, value);
+    extern bool parameter_by_name (std::string const&, void*);
+    return name && value && parameter_by_name (name, value);
+}
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_parameter_handle (const char* name, int type)
+{
+    extern int parameter_handle (const char*, int);
+    return parameter_handle (name, type);
+}
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_parameter_get (int handle, void* value)
+{
+    extern bool parameter_get (int, void*);
+    return parameter_get (handle, value);
+}
+
+SSEGUI_API int SSEGUI_CCONV
+ssegui_parameter_set (int handle, const void* value)
+{
+    extern bool parameter_set (int, void const*);
+    return parameter_set (handle, value);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -188,6 +409,50 @@ ssegui_clip_cursor (int enable)
 SSEGUI_API int SSEGUI_CCONV
 ssegui_execute (const char* command, void* arg)
 {
+    ssegui_error.clear ();
+    if (!command || !arg)
+    {
+        ssegui_error = __func__ + " null argument"s;
+        return false;
+    }
+
+    try
+    {
+        std::string cmd (command);
+
+        if (cmd == "stats")
+        {
+            static thread_local std::string json;
+            json = listener_stats_json ();
+            *reinterpret_cast<const char**> (arg) = json.c_str ();
+            return true;
+        }
+
+        if (cmd == "profile")
+        {
+            auto v = reinterpret_cast<int*> (arg);
+            bool f = *v > 0;
+            *v = enable_profiling (*v < 0 ? nullptr : &f);
+            return true;
+        }
+
+        if (cmd == "trace")
+        {
+            extern bool trace_start (const char* path);
+            extern bool trace_stop ();
+            auto path = reinterpret_cast<const char*> (arg);
+            if (*path)
+                return trace_start (path);
+            trace_stop ();
+            return true;
+        }
+
+        ssegui_error = __func__ + " unknown command "s + cmd;
+    }
+    catch (std::exception const& ex)
+    {
+        ssegui_error = __func__ + " "s + ex.what ();
+    }
     return false;
 }
 
@@ -203,6 +468,25 @@ ssegui_make_api ()
     api.control_key      = ssegui_control_key;
     api.control_listener = ssegui_control_listener;
     api.render_listener  = ssegui_render_listener;
+    api.render_budget    = ssegui_render_budget;
+    api.render_flags     = ssegui_render_flags;
+    api.resize_listener  = ssegui_resize_listener;
+    api.layer_listener   = ssegui_layer_listener;
+    api.layer_state      = ssegui_layer_state;
+    api.layer_invalidate = ssegui_layer_invalidate;
+    api.font             = ssegui_font;
+    api.font_glyphs      = ssegui_font_glyphs;
+    api.quads            = ssegui_quads;
+    api.frame_alloc      = ssegui_frame_alloc;
+    api.upload           = ssegui_upload;
+    api.parameter_handle = ssegui_parameter_handle;
+    api.parameter_get    = ssegui_parameter_get;
+    api.parameter_set    = ssegui_parameter_set;
+    api.capture          = ssegui_capture;
+    api.present_listener = ssegui_present_listener;
+    api.message_filter   = ssegui_message_filter;
+    api.message_priority = ssegui_message_priority;
+    api.input_batch_listener = ssegui_input_batch_listener;
     api.message_listener = ssegui_message_listener;
     api.parameter        = ssegui_parameter;
     api.clip_cursor      = ssegui_clip_cursor;
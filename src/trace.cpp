@@ -0,0 +1,265 @@
+/**
+ * @file trace.cpp
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Recording of the input as the game got it, to reproduce what a player did. The window
+ * procedure and the DirectInput devices push records into a lock-free ring while recording, a
+ * writer thread drains it into the file every few milliseconds. @see input_trace.hpp
+ */
+
+#include <nlohmann/json.hpp>
+
+#include <utils/winutils.hpp>
+#include "input_trace.hpp"
+#include "profiler.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <fstream>
+#include <algorithm>
+
+#include <windows.h>
+
+//--------------------------------------------------------------------------------------------------
+
+using namespace std::string_literals;
+
+/// Opened from within skse.cpp
+extern std::ofstream& log ();
+
+/// Defined in sse-gui.cpp
+extern thread_local std::string ssegui_error;
+
+/// Defined in render.cpp
+extern void sync_hooks ();
+
+/// [shared] Whether the recording threads should push, checked before anything else
+std::atomic<bool> ssegui_tracing { false };
+
+//--------------------------------------------------------------------------------------------------
+
+/// All in one holder of the trace fields
+struct trace_t
+{
+    trace_ring<8192> ring;                      ///< 512KB, a second of 1000Hz input or so
+    std::mutex control;                         ///< Start and stop
+    std::thread writer;
+    std::atomic<bool> stop { false };
+    std::FILE* file = nullptr;
+    std::string path;
+    std::uint64_t start = 0;                    ///< Profiler clock
+    std::atomic<std::uint64_t> records { 0 };   ///< Written
+    std::atomic<std::uint64_t> bytes { 0 };
+    std::atomic<std::uint64_t> failed { 0 };    ///< Writes
+
+    ~trace_t ()
+    {
+        if (writer.joinable ())
+        {
+            stop = true;
+            writer.join ();
+        }
+        if (file)
+            std::fclose (file);
+    }
+};
+
+/// How often the writer drains the ring
+static constexpr auto write_interval = std::chrono::milliseconds (5);
+
+/// One and only one object
+static trace_t trace;
+
+//--------------------------------------------------------------------------------------------------
+
+/// Writer thread, until stopped, then once more for what was pushed in the meantime
+
+static void
+write_trace ()
+{
+    std::vector<std::uint8_t> buffer;
+    auto dropped = trace.ring.dropped.load ();
+    for (bool last = false; !last; )
+    {
+        last = trace.stop.load ();
+        std::uint64_t n = 0;
+        trace_record r;
+        while (trace.ring.pop (r))
+        {
+            if (r.time < trace.start)
+                continue; // From a previous recording
+            r.time -= trace.start;
+            trace_encode (r, buffer);
+            ++n;
+        }
+        auto d = trace.ring.dropped.load ();
+        if (d != dropped)
+        {
+            trace_encode (make_trace_dropped (profiler_now () - trace.start, d - dropped), buffer);
+            dropped = d;
+            ++n;
+        }
+        if (!buffer.empty ())
+        {
+            if (std::fwrite (buffer.data (), 1, buffer.size (), trace.file) == buffer.size ())
+            {
+                trace.records.fetch_add (n, std::memory_order_relaxed);
+                trace.bytes.fetch_add (buffer.size (), std::memory_order_relaxed);
+            }
+            else
+                trace.failed.fetch_add (1, std::memory_order_relaxed);
+            buffer.clear ();
+        }
+        if (!last)
+            std::this_thread::sleep_for (write_interval);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Window thread, @see window_proc()
+
+void
+trace_message (unsigned msg, std::uintptr_t wParam, std::intptr_t lParam)
+{
+    trace.ring.push (make_trace_message (profiler_now (), msg, wParam, lParam));
+}
+
+/// Input thread, of the 256 bytes DirectInput keyboard state
+
+void
+trace_keyboard (std::uint8_t const* keys)
+{
+    trace.ring.push (make_trace_keyboard (profiler_now (), keys));
+}
+
+/// Input thread, of a DIMOUSESTATE2
+
+void
+trace_mouse (std::int32_t x, std::int32_t y, std::int32_t z, std::uint8_t const* buttons)
+{
+    trace.ring.push (make_trace_mouse (profiler_now (), x, y, z, buttons));
+}
+
+/// Input thread, of what IDirectInputDevice8::GetDeviceData returned, @param stride is its size
+
+void
+trace_device_data (bool mouse, void const* items, unsigned stride, unsigned count)
+{
+    if (stride < sizeof (trace_device_item))
+        return; // DIDEVICEOBJECTDATA_DX3 still starts the same, anything less is unknown
+    auto t = profiler_now ();
+    auto p = static_cast<std::uint8_t const*> (items);
+    for (unsigned i = 0; i < count; i += 2)
+    {
+        trace_device_item pair[2];
+        for (unsigned j = 0; j < 2 && i + j < count; ++j)
+            std::memcpy (&pair[j], p + (i + j) * stride, sizeof (trace_device_item));
+        trace.ring.push (make_trace_device_data (t, mouse, pair, std::min (count - i, 2u)));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @returns whether it was recording
+
+bool
+trace_stop ()
+{
+    std::lock_guard<std::mutex> lock (trace.control);
+    if (!trace.file)
+        return false;
+
+    ssegui_tracing.store (false);
+    trace.stop = true;
+    trace.writer.join ();
+    bool ok = !std::fclose (std::exchange (trace.file, nullptr));
+    sync_hooks ();
+    log () << "Input trace into " << trace.path << (ok ? " stopped." : " failed to close.")
+           << std::endl;
+    return true;
+}
+
+/// Stops first if recording, @param path is UTF-8, @see ssegui_execute ("trace")
+
+bool
+trace_start (const char* path)
+{
+    trace_stop ();
+
+    ssegui_error.clear ();
+    std::lock_guard<std::mutex> lock (trace.control);
+    std::wstring wpath;
+    if (!utf8_to_utf16 (path, wpath) || !(trace.file = ::_wfopen (wpath.c_str (), L"wb")))
+    {
+        ssegui_error = __func__ + " unable to open "s + path;
+        return false;
+    }
+
+    trace_record r;
+    while (trace.ring.pop (r))
+        ; // Late pushes of the previous recording
+    trace.start = profiler_now ();
+    if (std::fwrite (trace_magic, sizeof (trace_magic), 1, trace.file) != 1
+            || std::fwrite (&trace.start, sizeof (trace.start), 1, trace.file) != 1)
+    {
+        std::fclose (std::exchange (trace.file, nullptr));
+        ssegui_error = __func__ + " unable to write "s + path;
+        return false;
+    }
+
+    trace.path = path;
+    trace.stop = false;
+    trace.writer = std::thread (write_trace);
+    ssegui_tracing.store (true);
+    sync_hooks ();
+    log () << "Input trace started into " << trace.path << '.' << std::endl;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Recorder statistics, @see ssegui_execute ("stats")
+
+void
+trace_stats (nlohmann::json& json)
+{
+    json["trace"] = {
+        { "recording",  ssegui_tracing.load () },
+        { "pushed",     trace.ring.pushed.load () },
+        { "dropped",    trace.ring.dropped.load () },
+        { "records",    trace.records.load () },
+        { "bytes",      trace.bytes.load () },
+        { "failed",     trace.failed.load () }
+    };
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,170 @@
+/**
+ * @file trace_dump.cpp
+ * @brief Prints an input trace as text, offline
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Tools
+ *
+ * @details
+ * One line per record: the milliseconds since the start, then the message name and parameters,
+ * the keys and buttons held in the DirectInput states (repeated states are not printed again),
+ * the buffered device data, or how many records got dropped. Last, the count of each message.
+ * Usage: trace_dump <file> [-s] (only the summary)
+ */
+
+#include "input_trace.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+//--------------------------------------------------------------------------------------------------
+
+/// Defined in window_messages.cpp
+extern const char* window_message_text (unsigned msg);
+
+static std::string
+hex (std::uint64_t v)
+{
+    char s[24];
+    std::snprintf (s, sizeof (s), "0x%llX", static_cast<unsigned long long> (v));
+    return s;
+}
+
+static void
+print_record (trace_record const& r, trace_record& keyboard, trace_record& mouse)
+{
+    char time[32];
+    std::snprintf (time, sizeof (time), "%12.3f ", r.time * 1e-6);
+    switch (r.kind)
+    {
+        case trace_kind::message:
+        {
+            auto m = read_trace_message (r);
+            std::cout << time << window_message_text (m.msg) << " (" << hex (m.msg) << ") "
+                      << hex (m.wParam) << ' ' << hex (std::uint64_t (m.lParam)) << '\n';
+            break;
+        }
+        case trace_kind::keyboard:
+        {
+            if (!std::memcmp (keyboard.data, r.data, r.size))
+                break;
+            keyboard = r;
+            std::cout << time << "keyboard";
+            for (unsigned k = 0; k < 256; ++k)
+                if (trace_key (r, k))
+                    std::cout << ' ' << hex (k);
+            std::cout << '\n';
+            break;
+        }
+        case trace_kind::mouse:
+        {
+            auto m = read_trace_mouse (r);
+            if (!m.x && !m.y && !m.z && mouse.data[12] == m.buttons)
+                break;
+            mouse = r;
+            std::cout << time << "mouse " << m.x << ' ' << m.y << ' ' << m.z
+                      << " buttons " << hex (m.buttons) << '\n';
+            break;
+        }
+        case trace_kind::device_data:
+        {
+            bool is_mouse;
+            trace_device_item items[2];
+            auto n = read_trace_device_data (r, is_mouse, items);
+            for (unsigned i = 0; i < n; ++i)
+                std::cout << time << (is_mouse ? "mouse data " : "keyboard data ")
+                          << hex (items[i].offset) << ' ' << hex (items[i].data)
+                          << " at " << items[i].time << " #" << items[i].sequence << '\n';
+            break;
+        }
+        case trace_kind::dropped:
+            std::cout << time << "dropped " << trace_get<std::uint64_t> (r, 0) << '\n';
+            break;
+        default:
+            std::cout << time << "unknown record " << int (r.kind) << '\n';
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
+int
+main (int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <file> [-s]" << std::endl;
+        return 2;
+    }
+    bool summary = argc > 2 && !std::strcmp (argv[2], "-s");
+
+    std::FILE* f = std::fopen (argv[1], "rb");
+    if (!f)
+    {
+        std::cerr << "Unable to open " << argv[1] << std::endl;
+        return 1;
+    }
+    std::vector<trace_record> records;
+    std::uint64_t start;
+    bool complete = trace_load (f, records, start);
+    std::fclose (f);
+    if (!complete && records.empty ())
+    {
+        std::cerr << argv[1] << " is not an input trace" << std::endl;
+        return 1;
+    }
+
+    trace_record keyboard = {}, mouse = {};
+    std::map<unsigned, std::uint64_t> messages;
+    std::uint64_t states = 0, items = 0, dropped = 0;
+    for (auto const& r: records)
+    {
+        if (!summary)
+            print_record (r, keyboard, mouse);
+        if (r.kind == trace_kind::message)
+            ++messages[read_trace_message (r).msg];
+        else if (r.kind == trace_kind::keyboard || r.kind == trace_kind::mouse)
+            ++states;
+        else if (r.kind == trace_kind::device_data)
+            items += (r.size - 1u) / 16u;
+        else if (r.kind == trace_kind::dropped)
+            dropped += trace_get<std::uint64_t> (r, 0);
+    }
+
+    auto seconds = records.empty () ? 0. : records.back ().time * 1e-9;
+    std::cout << "records:                " << records.size ()
+                                            << (complete ? "" : " (cut short)") << '\n'
+              << "seconds:                " << seconds << '\n'
+              << "device states:          " << states << '\n'
+              << "device data items:      " << items << '\n'
+              << "dropped:                " << dropped << '\n';
+    for (auto const& m: messages)
+        std::cout << "  " << window_message_text (m.first) << " (" << hex (m.first) << "): "
+                  << m.second << '\n';
+    std::cout << std::flush;
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+
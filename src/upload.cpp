@@ -0,0 +1,276 @@
+/**
+ * @file upload.cpp
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Public API
+ *
+ * @details
+ * One large dynamic buffer for vertices and indices, and one for constants, shared by all plugins
+ * instead of each renaming its own small buffers with discard maps every frame. The space of each
+ * frame is fenced by an event query, polled without flushing on the next Presents. Everything here
+ * runs on the render thread. @see upload_ring.hpp
+ */
+
+#include <sse-gui/sse-gui.h>
+#include <nlohmann/json.hpp>
+
+#include <utils/winutils.hpp>
+#include "upload_ring.hpp"
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <utility>
+#include <fstream>
+#include <algorithm>
+
+#include <windows.h>
+#include <d3d11.h>
+
+//--------------------------------------------------------------------------------------------------
+
+using namespace std::string_literals;
+
+/// Opened from within skse.cpp
+extern std::ofstream& log ();
+
+/// Defined in sse-gui.cpp
+extern thread_local std::string ssegui_error;
+
+//--------------------------------------------------------------------------------------------------
+
+struct upload_buffer
+{
+    upload_ring<ID3D11Query*> ring;
+    UINT bind_flags;
+    std::size_t min_alignment;
+    bool failed;                    ///< Do not retry creating it each call
+    bool fresh;                     ///< Not mapped yet, hence discard
+    ID3D11Buffer* buffer;
+};
+
+/// All in one holder of the upload fields
+struct uploads_t
+{
+    std::atomic<DWORD> render_thread;
+    ID3D11Device* device;
+    ID3D11DeviceContext* context;
+    upload_buffer buffers[2] = {
+        { upload_ring<ID3D11Query*> (4 << 20),
+            D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_INDEX_BUFFER, 16, false, true, nullptr },
+        { upload_ring<ID3D11Query*> (1 << 20),
+            D3D11_BIND_CONSTANT_BUFFER, 256, false, true, nullptr }
+    };
+    std::vector<ID3D11Query*> queries; ///< Free for reuse
+};
+
+/// One and only one object
+static uploads_t uploads = {};
+
+//--------------------------------------------------------------------------------------------------
+
+static bool
+setup_buffer (upload_buffer& b)
+{
+    if (b.buffer)
+        return true;
+    if (b.failed)
+        return false;
+    b.failed = true;
+
+    if (b.bind_flags & D3D11_BIND_CONSTANT_BUFFER)
+    {
+        // Sub-ranges of constant buffers are a D3D11.1 feature, appending to them even more so
+        D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+        if (uploads.device->CheckFeatureSupport (D3D11_FEATURE_D3D11_OPTIONS,
+                    &options, sizeof (options)) != S_OK
+                || !options.ConstantBufferOffsetting
+                || !options.MapNoOverwriteOnDynamicConstantBuffer)
+        {
+            log () << "Constant buffer uploads are not supported." << std::endl;
+            return false;
+        }
+    }
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = UINT (b.ring.capacity ());
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = b.bind_flags;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    if (uploads.device->CreateBuffer (&desc, nullptr, &b.buffer) != S_OK)
+    {
+        log () << "Unable to create an upload buffer." << std::endl;
+        return false;
+    }
+
+    b.fresh = true;
+    b.failed = false;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Render thread, on each Present before the listeners: frees the space the GPU is done with
+
+void
+upload_frame_begin (ID3D11Device* device, ID3D11DeviceContext* context)
+{
+    uploads.render_thread.store (::GetCurrentThreadId (), std::memory_order_relaxed);
+    uploads.device = device;
+    uploads.context = context;
+
+    for (auto& b: uploads.buffers)
+        b.ring.retire ([context] (ID3D11Query* q) {
+            if (context->GetData (q, nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+                return false;
+            uploads.queries.push_back (q);
+            return true;
+        });
+}
+
+/// Render thread, after the listeners: fences what they uploaded
+
+void
+upload_frame_end ()
+{
+    for (auto& b: uploads.buffers)
+    {
+        if (!b.ring.dirty ())
+            continue;
+
+        ID3D11Query* q = nullptr;
+        if (!uploads.queries.empty ())
+        {
+            q = uploads.queries.back ();
+            uploads.queries.pop_back ();
+        }
+        else
+        {
+            D3D11_QUERY_DESC desc = { D3D11_QUERY_EVENT, 0 };
+            if (uploads.device->CreateQuery (&desc, &q) != S_OK)
+            {
+                // Without a fence, nothing can be reused safely - start anew
+                log () << "Unable to create an upload fence." << std::endl;
+                b.ring.clear ([] (ID3D11Query* q) { uploads.queries.push_back (q); });
+                std::exchange (b.buffer, nullptr)->Release ();
+                continue;
+            }
+        }
+        uploads.context->End (q);
+        b.ring.end_frame (q);
+    }
+}
+
+/// Render thread, the tracked device is replaced: nothing of the old one can be reused
+
+void
+upload_device_reset ()
+{
+    for (auto& b: uploads.buffers)
+    {
+        b.ring.clear ([] (ID3D11Query* q) { q->Release (); });
+        if (b.buffer)
+            std::exchange (b.buffer, nullptr)->Release ();
+        b.failed = false;
+    }
+    for (auto q: uploads.queries)
+        q->Release ();
+    uploads.queries.clear ();
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// @see #ssegui_upload()
+
+bool
+upload (int kind, void const* data, std::size_t size, std::size_t alignment,
+        ssegui_upload_range* out)
+{
+    ssegui_error.clear ();
+    if ((kind != SSEGUI_UPLOAD_VERTEX && kind != SSEGUI_UPLOAD_CONSTANT) || !data || !out
+            || (alignment & (alignment - 1)) || alignment > 4096)
+    {
+        ssegui_error = __func__ + " invalid argument"s;
+        return false;
+    }
+    if (::GetCurrentThreadId () != uploads.render_thread.load (std::memory_order_relaxed))
+    {
+        ssegui_error = __func__ + " not on the render thread"s;
+        return false;
+    }
+
+    auto& b = uploads.buffers[kind];
+    if (!setup_buffer (b))
+    {
+        ssegui_error = __func__ + " no upload buffer"s;
+        return false;
+    }
+
+    alignment = std::max (alignment, b.min_alignment);
+    auto reserved = kind == SSEGUI_UPLOAD_CONSTANT ? (size + 255) & ~std::size_t (255) : size;
+    std::size_t offset;
+    if (!b.ring.allocate (reserved, alignment, offset))
+    {
+        ssegui_error = __func__ + " upload ring is full"s;
+        return false;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    auto how = std::exchange (b.fresh, false) ? D3D11_MAP_WRITE_DISCARD
+                                              : D3D11_MAP_WRITE_NO_OVERWRITE;
+    HRESULT hres = uploads.context->Map (b.buffer, 0, how, 0, &mapped);
+    if (hres != S_OK)
+    {
+        ssegui_error = __func__ + " Map "s + hex_string (hres);
+        return false;
+    }
+    std::memcpy (static_cast<char*> (mapped.pData) + offset, data, size);
+    uploads.context->Unmap (b.buffer, 0);
+
+    out->buffer = b.buffer;
+    out->offset = offset;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+
+/// Ring statistics, @see ssegui_execute ("stats")
+
+void
+upload_stats (nlohmann::json& json)
+{
+    const char* names[] = { "vertex", "constant" };
+    auto& j = json["upload"];
+    for (int i = 0; i < 2; ++i)
+    {
+        auto const& r = uploads.buffers[i].ring;
+        j[names[i]] = {
+            { "allocations", r.allocations.load () },
+            { "bytes",       r.bytes.load () },
+            { "failures",    r.failures.load () },
+            { "wraps",       r.wraps.load () },
+            { "capacity",    r.capacity () }
+        };
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+
@@ -0,0 +1,156 @@
+/**
+ * @file upload_ring.hpp
+ * @brief Frame fenced sub-allocation of a dynamic GPU buffer
+ * @internal
+ *
+ * This file is part of Skyrim SE GUI mod (aka SSEGUI).
+ *
+ *   SSEGUI is free software: you can redistribute it and/or modify it
+ *   under the terms of the GNU Lesser General Public License as published
+ *   by the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   SSEGUI is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with SSEGUI. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @endinternal
+ *
+ * @ingroup Core
+ *
+ * @details
+ * Unlike #quad_ring, which discards the whole buffer on wrap around, this ring is shared by many
+ * plugins uploading at any time of the frame, so it never discards: each frame ends with a fence
+ * (an event query) and the space used by a frame is reused only after its fence has passed. The
+ * positions are monotonic byte counts, the buffer offset being the position modulo the capacity,
+ * so full and empty are never ambiguous. When the GPU lags so much that there is no room left,
+ * the allocation fails instead of waiting.
+ *
+ * The fences are of a template type, event queries in upload.cpp, while bench_upload_ring uses
+ * frame numbers, signaled late to play a lagging GPU.
+ */
+
+#ifndef SSEGUI_UPLOAD_RING_HPP
+#define SSEGUI_UPLOAD_RING_HPP
+
+#include "histogram.hpp"
+
+#include <deque>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//--------------------------------------------------------------------------------------------------
+
+/// @param Fence is whatever tells that the GPU is done with a frame, e.g. ID3D11Query*
+
+template<class Fence>
+class upload_ring
+{
+    struct frame
+    {
+        Fence fence;
+        std::uint64_t end;      ///< Position after the last allocation of the frame
+    };
+
+    std::size_t capacity_;
+    std::uint64_t head_ = 0;    ///< Next free position
+    std::uint64_t tail_ = 0;    ///< Oldest position the GPU may still read
+    std::uint64_t frame_begin_ = 0;
+    std::deque<frame> frames_;  ///< In flight, oldest first
+
+public:
+    /// Statistics, can be read from any thread
+    std::atomic<std::uint64_t> allocations { 0 }, bytes { 0 }, failures { 0 }, wraps { 0 };
+
+    explicit upload_ring (std::size_t capacity) noexcept : capacity_ (capacity) {}
+
+    std::size_t capacity () const noexcept { return capacity_; }
+    std::size_t in_flight () const noexcept { return frames_.size (); }
+    std::size_t used () const noexcept { return std::size_t (head_ - tail_); }
+
+    /// Whether anything was allocated since the last #end_frame()
+    bool dirty () const noexcept { return head_ != frame_begin_; }
+
+    /**
+     * Room for @param size bytes at a multiple of @param alignment (power of two)
+     *
+     * @param[out] offset in the buffer
+     * @returns false if there is no room until the GPU is done with older frames
+     */
+    bool
+    allocate (std::size_t size, std::size_t alignment, std::size_t& offset) noexcept
+    {
+        if (!size || size > capacity_)
+        {
+            relaxed_add (failures, 1);
+            return false;
+        }
+
+        auto pos = std::size_t (head_ % capacity_);
+        auto at = (pos + alignment - 1) & ~(alignment - 1);
+        auto start = head_ + (at - pos);
+        bool wrap = at + size > capacity_;
+        if (wrap) // The tail end of the buffer is skipped
+        {
+            start = head_ + (capacity_ - pos);
+            at = 0;
+        }
+        if (start + size - tail_ > capacity_)
+        {
+            relaxed_add (failures, 1);
+            return false;
+        }
+
+        relaxed_add (wraps, wrap);
+        relaxed_add (allocations, 1);
+        relaxed_add (bytes, size);
+        head_ = start + size;
+        offset = at;
+        return true;
+    }
+
+    /// The GPU work of all allocations so far is submitted, @param fence is signaled after it
+    void
+    end_frame (Fence fence)
+    {
+        frames_.push_back (frame { fence, head_ });
+        frame_begin_ = head_;
+    }
+
+    /**
+     * Frees the space of the frames whose fences have passed, oldest first.
+     *
+     * @param passed (Fence) is true if the GPU went past the fence, the fence is then done for
+     */
+    template<class Passed>
+    void
+    retire (Passed&& passed)
+    {
+        while (!frames_.empty () && passed (frames_.front ().fence))
+        {
+            tail_ = frames_.front ().end;
+            frames_.pop_front ();
+        }
+    }
+
+    /// All fences in flight, for instance to release them with the buffer
+    template<class Release>
+    void
+    clear (Release&& release)
+    {
+        for (auto& f: frames_)
+            release (f.fence);
+        frames_.clear ();
+        tail_ = frame_begin_ = head_;
+    }
+};
+
+//--------------------------------------------------------------------------------------------------
+
+#endif
+